@@ -8,6 +8,24 @@
 
 #include "const-c.inc"
 
+/* a send's $time may be omitted (or false) to mean now, and may carry a
+   fractional part, e.g. from Time::HiRes::time */
+static time_t
+send_time(pTHX_ LogSyslogFast* logger, SV* now)
+{
+    if (!now || !SvTRUE(now))
+        return logger->time_precision ? LSF_now(logger) : time(0);
+
+    if (logger->time_precision) {
+        NV t = SvNV(now);
+        time_t secs = (time_t) t;
+        LSF_set_usec(logger, (long) ((t - secs) * 1000000));
+        return secs;
+    }
+
+    return (time_t) SvNV(now);
+}
+
 MODULE = Log::Syslog::Fast		PACKAGE = Log::Syslog::Fast
 
 INCLUDE: const-xs.inc
@@ -47,23 +65,116 @@ CODE:
         croak("Error in close: %s", logger->err);
 
 int
-send(logger, logmsg, now = time(0))
+send(logger, logmsg, now = NULL)
     LogSyslogFast* logger
     SV* logmsg
-    time_t now
+    SV* now
 ALIAS:
     emit = 1
 INIT:
     STRLEN msglen;
     const char* msgstr;
+    /* a filtered line isn't even stringified */
+    if (LSF_filtered(logger, logger->priority & 7, 1))
+        XSRETURN_IV(0);
+    msgstr = SvPV(logmsg, msglen);
+CODE:
+    RETVAL = LSF_send(logger, msgstr, msglen, send_time(aTHX_ logger, now));
+    if (RETVAL < 0)
+        croak("Error while sending: %s", logger->err);
+OUTPUT:
+    RETVAL
+
+int
+send_prio(logger, logmsg, severity, facility_sv = NULL, now = NULL)
+    LogSyslogFast* logger
+    SV* logmsg
+    int severity
+    SV* facility_sv
+    SV* now
+INIT:
+    STRLEN msglen;
+    const char* msgstr;
+    int facility;
+CODE:
+    if (facility_sv && SvOK(facility_sv))
+        facility = SvIV(facility_sv);
+    else
+        facility = LSF_get_facility(logger);
+    if (severity < 0 || severity > 7)
+        croak("Error while sending: invalid severity");
+    if (facility < 0 || facility > 23)
+        croak("Error while sending: invalid facility");
+    if (LSF_filtered(logger, severity, 1))
+        XSRETURN_IV(0);
+    msgstr = SvPV(logmsg, msglen);
+    RETVAL = LSF_send_prio(logger, msgstr, msglen, (facility << 3) | severity, send_time(aTHX_ logger, now));
+    if (RETVAL < 0)
+        croak("Error while sending: %s", logger->err);
+OUTPUT:
+    RETVAL
+
+int
+send_key(logger, key, logmsg, now = NULL)
+    LogSyslogFast* logger
+    SV* key
+    SV* logmsg
+    SV* now
+INIT:
+    STRLEN keylen, msglen;
+    const char* keystr;
+    const char* msgstr;
+    if (LSF_filtered(logger, logger->priority & 7, 1))
+        XSRETURN_IV(0);
+    keystr = SvPV(key, keylen);
     msgstr = SvPV(logmsg, msglen);
 CODE:
-    RETVAL = LSF_send(logger, msgstr, msglen, now);
+    RETVAL = LSF_send_key(logger, keystr, keylen, msgstr, msglen, send_time(aTHX_ logger, now));
     if (RETVAL < 0)
         croak("Error while sending: %s", logger->err);
 OUTPUT:
     RETVAL
 
+int
+send_many(logger, messages, now = NULL)
+    LogSyslogFast* logger
+    AV* messages
+    SV* now
+INIT:
+    SSize_t count = av_len(messages) + 1;
+    const char** msgs;
+    int* lens;
+    SSize_t i;
+CODE:
+    if (count == 0)
+        XSRETURN_IV(0);
+    if (LSF_filtered(logger, logger->priority & 7, count))
+        XSRETURN_IV(0);
+    Newx(msgs, count, const char*);
+    Newx(lens, count, int);
+    SAVEFREEPV(msgs);
+    SAVEFREEPV(lens);
+    for (i = 0; i < count; i++) {
+        SV** svp = av_fetch(messages, i, 0);
+        STRLEN msglen = 0;
+        msgs[i] = svp ? SvPV(*svp, msglen) : "";
+        lens[i] = msglen;
+    }
+    RETVAL = LSF_send_many(logger, msgs, lens, count, send_time(aTHX_ logger, now));
+    if (RETVAL < 0)
+        croak("Error while sending: %s", logger->err);
+OUTPUT:
+    RETVAL
+
+int
+flush(logger, timeout = -1)
+    LogSyslogFast* logger
+    double timeout
+CODE:
+    RETVAL = LSF_flush(logger, timeout);
+OUTPUT:
+    RETVAL
+
 void
 set_receiver(logger, proto, hostname, port)
     LogSyslogFast* logger
@@ -79,6 +190,117 @@ CODE:
     if (ret < 0)
         croak("Error in set_receiver: %s", logger->err);
 
+void
+add_receiver(logger, proto, hostname, port, framing = LOG_FRAMING_NONE)
+    LogSyslogFast* logger
+    int proto
+    char* hostname
+    int port
+    int framing
+CODE:
+    if (!hostname)
+        croak("hostname required");
+    int ret = LSF_add_receiver(logger, proto, hostname, port, framing);
+    if (ret < 0)
+        croak("Error in add_receiver: %s", logger->err);
+
+void
+clear_receivers(logger)
+    LogSyslogFast* logger
+CODE:
+    LSF_clear_receivers(logger);
+
+SV*
+get_receivers(logger)
+    LogSyslogFast* logger
+PREINIT:
+    LSF_receiver_info info;
+    AV* list;
+    int i;
+CODE:
+    list = newAV();
+    for (i = 0; i < LSF_get_receiver_count(logger); i++) {
+        HV* hv = newHV();
+        LSF_get_receiver(logger, i, &info);
+        hv_stores(hv, "proto", newSViv(info.proto));
+        hv_stores(hv, "hostname", newSVpv(info.hostname, 0));
+        hv_stores(hv, "port", newSViv(info.port));
+        hv_stores(hv, "framing", newSViv(info.framing));
+        hv_stores(hv, "up", newSViv(info.up));
+        hv_stores(hv, "sent", newSVuv(info.sent));
+        hv_stores(hv, "bytes", newSVuv(info.bytes));
+        hv_stores(hv, "dropped", newSVuv(info.dropped));
+        hv_stores(hv, "failed", newSVuv(info.failed));
+        av_push(list, newRV_noinc((SV*) hv));
+    }
+    RETVAL = newRV_noinc((SV*) list);
+OUTPUT:
+    RETVAL
+
+void
+set_pool(logger, collectors, mode = LOG_POOL_ROUND_ROBIN, eject_time = 10)
+    LogSyslogFast* logger
+    SV* collectors
+    int mode
+    double eject_time
+PREINIT:
+    AV* list = NULL;
+    const char** hostnames;
+    int* ports;
+    SSize_t count = 0;
+    SSize_t i;
+CODE:
+    if (SvOK(collectors)) {
+        if (!SvROK(collectors) || SvTYPE(SvRV(collectors)) != SVt_PVAV)
+            croak("Error in set_pool: collectors must be an array reference");
+        list = (AV*) SvRV(collectors);
+        count = av_len(list) + 1;
+    }
+    Newx(hostnames, count + 1, const char*);
+    Newx(ports, count + 1, int);
+    SAVEFREEPV(hostnames);
+    SAVEFREEPV(ports);
+    for (i = 0; i < count; i++) {
+        SV** svp = av_fetch(list, i, 0);
+        SV** host;
+        SV** port;
+        if (!svp || !SvROK(*svp) || SvTYPE(SvRV(*svp)) != SVt_PVAV)
+            croak("Error in set_pool: each collector must be a [hostname, port] pair");
+        host = av_fetch((AV*) SvRV(*svp), 0, 0);
+        port = av_fetch((AV*) SvRV(*svp), 1, 0);
+        if (!host || !SvOK(*host))
+            croak("hostname required");
+        hostnames[i] = SvPV_nolen(*host);
+        ports[i] = port ? SvIV(*port) : 0;
+    }
+    if (LSF_set_pool(logger, hostnames, ports, count, mode, eject_time) < 0)
+        croak("Error in set_pool: %s", logger->err);
+
+SV*
+get_pool(logger)
+    LogSyslogFast* logger
+PREINIT:
+    LSF_pool_member_info info;
+    AV* list;
+    int i;
+CODE:
+    list = newAV();
+    for (i = 0; i < LSF_get_pool_size(logger); i++) {
+        HV* hv = newHV();
+        LSF_get_pool_member(logger, i, &info);
+        hv_stores(hv, "hostname", newSVpv(info.hostname, 0));
+        hv_stores(hv, "port", newSViv(info.port));
+        hv_stores(hv, "up", newSViv(info.up));
+        hv_stores(hv, "sent", newSVuv(info.sent));
+        hv_stores(hv, "bytes", newSVuv(info.bytes));
+        hv_stores(hv, "failed", newSVuv(info.failed));
+        hv_stores(hv, "ejections", newSVuv(info.ejections));
+        av_push(list, newRV_noinc((SV*) hv));
+    }
+    RETVAL = newRV_noinc((SV*) list);
+OUTPUT:
+    RETVAL
+
 void
 set_priority(logger, facility, severity)
     LogSyslogFast* logger
@@ -149,6 +371,196 @@ CODE:
     if (ret < 0)
         croak("Error in set_format: %s", logger->err);
 
+void
+set_zerocopy(logger, zerocopy)
+    LogSyslogFast* logger
+    int zerocopy
+CODE:
+    LSF_set_zerocopy(logger, zerocopy);
+
+void
+set_min_severity(logger, severity)
+    LogSyslogFast* logger
+    int severity
+CODE:
+    LSF_set_min_severity(logger, severity);
+
+void
+set_min_severity_file(logger, path)
+    LogSyslogFast* logger
+    SV* path
+CODE:
+    int ret = LSF_set_min_severity_file(logger, SvOK(path) ? SvPV_nolen(path) : NULL);
+    if (ret < 0)
+        croak("Error in set_min_severity_file: %s", logger->err);
+
+void
+set_rate_limit(logger, severity, rate, burst = 0)
+    LogSyslogFast* logger
+    SV* severity
+    double rate
+    double burst
+CODE:
+    int ret = LSF_set_rate_limit(logger, SvOK(severity) ? SvIV(severity) : -1, rate, burst);
+    if (ret < 0)
+        croak("Error in set_rate_limit: %s", logger->err);
+
+void
+set_sample(logger, severity, fraction)
+    LogSyslogFast* logger
+    SV* severity
+    double fraction
+CODE:
+    int ret = LSF_set_sample(logger, SvOK(severity) ? SvIV(severity) : -1, fraction);
+    if (ret < 0)
+        croak("Error in set_sample: %s", logger->err);
+
+void
+set_suppress_interval(logger, seconds)
+    LogSyslogFast* logger
+    int seconds
+CODE:
+    int ret = LSF_set_suppress_interval(logger, seconds);
+    if (ret < 0)
+        croak("Error in set_suppress_interval: %s", logger->err);
+
+void
+set_dedup(logger, window, slots = 8)
+    LogSyslogFast* logger
+    int window
+    int slots
+CODE:
+    int ret = LSF_set_dedup(logger, window, slots);
+    if (ret < 0)
+        croak("Error in set_dedup: %s", logger->err);
+
+void
+set_gso(logger, gso)
+    LogSyslogFast* logger
+    int gso
+CODE:
+    int ret = LSF_set_gso(logger, gso);
+    if (ret < 0)
+        croak("Error in set_gso: %s", logger->err);
+
+void
+set_framing(logger, framing)
+    LogSyslogFast* logger
+    int framing
+CODE:
+    int ret = LSF_set_framing(logger, framing);
+    if (ret < 0)
+        croak("Error in set_framing: %s", logger->err);
+
+void
+set_time_precision(logger, digits, coarse = 0)
+    LogSyslogFast* logger
+    int digits
+    int coarse
+CODE:
+    int ret = LSF_set_time_precision(logger, digits, coarse);
+    if (ret < 0)
+        croak("Error in set_time_precision: %s", logger->err);
+
+void
+set_async(logger, queue_size, drain_timeout = 1)
+    LogSyslogFast* logger
+    int queue_size
+    double drain_timeout
+CODE:
+    int ret = LSF_set_async(logger, queue_size, drain_timeout);
+    if (ret < 0)
+        croak("Error in set_async: %s", logger->err);
+
+void
+set_nonblock(logger, buffer_size, policy = LOG_OVERFLOW_DROP_NEWEST, deadline = 0.1)
+    LogSyslogFast* logger
+    int buffer_size
+    int policy
+    double deadline
+CODE:
+    int ret = LSF_set_nonblock(logger, buffer_size, policy, deadline);
+    if (ret < 0)
+        croak("Error in set_nonblock: %s", logger->err);
+
+void
+set_uring(logger, entries, sqpoll = 1)
+    LogSyslogFast* logger
+    int entries
+    int sqpoll
+CODE:
+    int ret = LSF_set_uring(logger, entries, sqpoll);
+    if (ret < 0)
+        croak("Error in set_uring: %s", logger->err);
+
+void
+set_coalesce(logger, size, max_delay = 0.05, timer = 0)
+    LogSyslogFast* logger
+    int size
+    double max_delay
+    int timer
+CODE:
+    int ret = LSF_set_coalesce(logger, size, max_delay, timer);
+    if (ret < 0)
+        croak("Error in set_coalesce: %s", logger->err);
+
+void
+set_reconnect(logger, min_delay, max_delay = 30)
+    LogSyslogFast* logger
+    double min_delay
+    double max_delay
+CODE:
+    int ret = LSF_set_reconnect(logger, min_delay, max_delay);
+    if (ret < 0)
+        croak("Error in set_reconnect: %s", logger->err);
+
+void
+set_spill(logger, path, size = 0, rate = 0)
+    LogSyslogFast* logger
+    SV* path
+    UV size
+    double rate
+CODE:
+    int ret = LSF_set_spill(logger, SvOK(path) ? SvPV_nolen(path) : NULL, size, rate);
+    if (ret < 0)
+        croak("Error in set_spill: %s", logger->err);
+
+void
+set_shared_stats(logger, path, slots = 256)
+    LogSyslogFast* logger
+    SV* path
+    int slots
+CODE:
+    int ret = LSF_set_shared_stats(logger, SvOK(path) ? SvPV_nolen(path) : NULL, slots);
+    if (ret < 0)
+        croak("Error in set_shared_stats: %s", logger->err);
+
+void
+set_dns_cache(self, ttl, timeout = 2)
+    SV* self
+    double ttl
+    double timeout
+CODE:
+    PERL_UNUSED_VAR(self);
+    if (LSF_set_dns_cache(ttl, timeout) < 0)
+        croak("Error in set_dns_cache: no getaddrinfo on this platform");
+
+void
+set_tls(self, ca_file = &PL_sv_undef, cert_file = &PL_sv_undef, key_file = &PL_sv_undef, ktls = 0)
+    SV* self
+    SV* ca_file
+    SV* cert_file
+    SV* key_file
+    int ktls
+PREINIT:
+    const char* err = NULL;
+CODE:
+    PERL_UNUSED_VAR(self);
+    if (LSF_set_tls(SvOK(ca_file) ? SvPV_nolen(ca_file) : NULL,
+                    SvOK(cert_file) ? SvPV_nolen(cert_file) : NULL,
+                    SvOK(key_file) ? SvPV_nolen(key_file) : NULL, ktls, &err) < 0)
+        croak("Error in set_tls: %s", err);
+
 int
 get_priority(logger)
     LogSyslogFast* logger
@@ -205,6 +617,187 @@ CODE:
 OUTPUT:
     RETVAL
 
+int
+get_zerocopy(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_zerocopy(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_min_severity(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_min_severity(logger);
+OUTPUT:
+    RETVAL
+
+SV*
+get_rate_limit(logger, severity = &PL_sv_undef)
+    LogSyslogFast* logger
+    SV* severity
+PREINIT:
+    LSF_limit_info info;
+    HV* hv;
+CODE:
+    if (LSF_get_rate_limit(logger, SvOK(severity) ? SvIV(severity) : -1, &info) < 0)
+        croak("Error in get_rate_limit: %s", logger->err);
+    hv = newHV();
+    hv_stores(hv, "rate", newSVnv(info.rate));
+    hv_stores(hv, "burst", newSVnv(info.burst));
+    hv_stores(hv, "tokens", newSVnv(info.tokens));
+    hv_stores(hv, "sample", newSVnv(info.sample));
+    RETVAL = newRV_noinc((SV*) hv);
+OUTPUT:
+    RETVAL
+
+int
+get_suppress_interval(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_suppress_interval(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_dedup(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_dedup(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_gso(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_gso(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_framing(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_framing(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_time_precision(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_time_precision(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_async(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_async(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_nonblock(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_nonblock(logger);
+OUTPUT:
+    RETVAL
+
+double
+get_reconnect(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_reconnect(logger);
+OUTPUT:
+    RETVAL
+
+UV
+get_spill(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_spill(logger);
+OUTPUT:
+    RETVAL
+
+int
+get_shared_stats(logger)
+    LogSyslogFast* logger
+CODE:
+    RETVAL = LSF_get_shared_stats(logger);
+OUTPUT:
+    RETVAL
+
+NV
+get_dns_cache(self)
+    SV* self
+CODE:
+    PERL_UNUSED_VAR(self);
+    RETVAL = LSF_get_dns_cache();
+OUTPUT:
+    RETVAL
+
+SV*
+get_tls(logger)
+    LogSyslogFast* logger
+PREINIT:
+    LSF_tls_info info;
+    HV* hv;
+CODE:
+    if (LSF_get_tls(logger, &info) < 0)
+        XSRETURN_UNDEF;
+    hv = newHV();
+    hv_stores(hv, "version", info.version ? newSVpv(info.version, 0) : newSV(0));
+    hv_stores(hv, "cipher", info.cipher ? newSVpv(info.cipher, 0) : newSV(0));
+    hv_stores(hv, "resumed", newSViv(info.resumed));
+    hv_stores(hv, "ktls", newSViv(info.ktls));
+    hv_stores(hv, "handshakes", newSVuv(info.handshakes));
+    hv_stores(hv, "resumptions", newSVuv(info.resumptions));
+    RETVAL = newRV_noinc((SV*) hv);
+OUTPUT:
+    RETVAL
+
+SV*
+get_uring(logger)
+    LogSyslogFast* logger
+PREINIT:
+    LSF_uring_info info;
+    HV* hv;
+CODE:
+    if (LSF_get_uring(logger, &info) < 0)
+        XSRETURN_UNDEF;
+    hv = newHV();
+    hv_stores(hv, "entries", newSViv(info.entries));
+    hv_stores(hv, "sqpoll", newSViv(info.sqpoll));
+    hv_stores(hv, "fixed", newSViv(info.fixed));
+    hv_stores(hv, "in_flight", newSViv(info.in_flight));
+    RETVAL = newRV_noinc((SV*) hv);
+OUTPUT:
+    RETVAL
+
+SV*
+get_coalesce(logger)
+    LogSyslogFast* logger
+PREINIT:
+    LSF_coalesce_info info;
+    HV* hv;
+CODE:
+    if (LSF_get_coalesce(logger, &info) < 0)
+        XSRETURN_UNDEF;
+    hv = newHV();
+    hv_stores(hv, "size", newSViv(info.size));
+    hv_stores(hv, "max_delay", newSVnv(info.max_delay));
+    hv_stores(hv, "timer", newSViv(info.timer));
+    hv_stores(hv, "lines", newSViv(info.lines));
+    hv_stores(hv, "bytes", newSViv(info.bytes));
+    RETVAL = newRV_noinc((SV*) hv);
+OUTPUT:
+    RETVAL
+
 int
 _get_sock(logger)
     LogSyslogFast* logger
@@ -212,3 +805,100 @@ CODE:
     RETVAL = LSF_get_sock(logger);
 OUTPUT:
     RETVAL
+
+SV*
+get_stats(logger)
+    LogSyslogFast* logger
+PREINIT:
+    const LSF_stats* stats;
+    HV* hv;
+CODE:
+    stats = LSF_get_stats(logger);
+    hv = newHV();
+#define STORE_STAT(field) hv_stores(hv, #field, newSVuv(stats->field))
+    STORE_STAT(sent);
+    STORE_STAT(bytes);
+    STORE_STAT(dropped);
+    STORE_STAT(failed);
+    STORE_STAT(truncated);
+    STORE_STAT(eagain);
+    STORE_STAT(enobufs);
+    STORE_STAT(econnrefused);
+    STORE_STAT(reconnects);
+    STORE_STAT(spilled);
+    STORE_STAT(replayed);
+    STORE_STAT(spill_lost);
+    STORE_STAT(prefix_rebuilds);
+    STORE_STAT(buffer_reallocs);
+    STORE_STAT(filtered);
+    STORE_STAT(suppressed);
+    STORE_STAT(deduplicated);
+#undef STORE_STAT
+    RETVAL = newRV_noinc((SV*) hv);
+OUTPUT:
+    RETVAL
+
+void
+reset_stats(logger)
+    LogSyslogFast* logger
+CODE:
+    LSF_reset_stats(logger);
+
+
+MODULE = Log::Syslog::Fast		PACKAGE = Log::Syslog::Fast::Simple
+
+int
+send(self, logmsg, now = NULL, severity = NULL, facility = NULL)
+    SV* self
+    SV* logmsg
+    SV* now
+    SV* severity
+    SV* facility
+PREINIT:
+    AV* fields;
+    SV** slot;
+    LogSyslogFast* logger;
+    STRLEN msglen;
+    const char* msgstr;
+    int sev, fac;
+CODE:
+    if (!SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVAV)
+        croak("Log::Syslog::Fast::Simple::send() -- self is not a blessed array reference");
+    fields = (AV*) SvRV(self);
+
+    /* the shared logger is connected on first use */
+    slot = av_fetch(fields, 0, 0);
+    if (!slot || !SvOK(*slot)) {
+        ENTER;
+        SAVETMPS;
+        PUSHMARK(SP);
+        XPUSHs(self);
+        PUTBACK;
+        call_method("_connect", G_DISCARD);
+        SPAGAIN;
+        FREETMPS;
+        LEAVE;
+        slot = av_fetch(fields, 0, 0);
+        if (!slot || !SvOK(*slot))
+            croak("Error while sending: not connected");
+    }
+    logger = INT2PTR(LogSyslogFast*, SvIV(SvRV(*slot)));
+
+    /* false overrides fall back to the defaults given to ->new; the
+       priority is composed the same way LSF_set_priority does it */
+    sev = severity && SvTRUE(severity) ? SvIV(severity) : LSF_get_severity(logger);
+    fac = facility && SvTRUE(facility) ? SvIV(facility) : LSF_get_facility(logger);
+
+    if (LSF_filtered(logger, sev & 7, 1))
+        XSRETURN_IV(0);
+    msgstr = SvPV(logmsg, msglen);
+    RETVAL = LSF_send_prio(logger, msgstr, msglen, (fac << 3) | sev, send_time(aTHX_ logger, now));
+
+    /* a refusal reported for an earlier datagram used to land on that
+       priority's own socket; now that they share one, clear it and retry */
+    if (RETVAL < 0 && errno == ECONNREFUSED && logger->sock_type == SOCK_DGRAM)
+        RETVAL = LSF_send_prio(logger, msgstr, msglen, (fac << 3) | sev, logger->last_time);
+    if (RETVAL < 0)
+        croak("Error while sending: %s", logger->err);
+OUTPUT:
+    RETVAL
@@ -1,39 +1,752 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for sendmmsg */
+#endif
+
 #include "LogSyslogFast.h"
 
+#include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#ifdef LSF_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#endif
+
+#ifdef LSF_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
 #define INITIAL_BUFSIZE 2048
 
+/* max messages handed to the kernel per sendmmsg/writev call in send_many;
+   each message needs up to LINE_IOV_MAX iovecs, which must stay under
+   IOV_MAX (1024) */
+#define SEND_MANY_BATCH 64
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define HAVE_SENDMMSG
+#endif
+
+/* UDP generic segmentation offload (Linux 4.18): one message carries a run
+   of equal-sized datagrams for the kernel to split up. Kernels without it
+   refuse the option, and sends go a datagram each. */
+#ifdef HAVE_SENDMMSG
+#define HAVE_GSO
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#define GSO_MAX_SEGS    64      /* UDP_MAX_SEGMENTS before 5.4 */
+#define GSO_MAX_BYTES   65507   /* largest IPv4 UDP payload */
+#endif
+
+/* an octet-counting header is at most the digits of an int plus a space */
+#define FRAME_HDR_MAX 12
+
+/* framing header, PRI, rest of prefix, message, framing trailer */
+#define LINE_IOV_MAX 5
+
+/* the async worker must never take a SIGPIPE on behalf of the perl thread */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* records in the async ring are a native-endian header of the length and
+   the pool route (see send_key) followed by the formatted line; either
+   part may wrap around the end of the ring */
+#define ASYNC_HDR_LEN   (2 * sizeof(uint32_t))
+#define ASYNC_MIN_QUEUE 4096
+#define ASYNC_BATCH     64
+
+struct LSF_async {
+    char*           ring;
+    size_t          size;           /* power of two */
+    size_t          head;           /* consumer position, advanced by worker */
+    size_t          tail;           /* producer position, advanced by send */
+    int             stop;           /* tells the worker to exit */
+    int             sleeping;       /* worker is (about to be) waiting on wakeup */
+    double          drain_timeout;  /* seconds to spend draining on shutdown */
+    pid_t           pid;            /* process that owns the worker */
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;
+    LogSyslogFast*  logger;
+};
+
+/* records in a non-blocking stream's write buffer are kept whole behind a
+   length header too, so that drop-oldest can discard complete lines */
+#define WBUF_HDR_LEN sizeof(uint32_t)
+#define WBUF_IOV_MAX 64
+
+struct LSF_wbuf {
+    char*           buf;
+    size_t          size;           /* capacity, headers included */
+    size_t          start;          /* offset of the first record's header */
+    size_t          end;            /* offset just past the last record */
+    size_t          sent;           /* bytes of the first record already written */
+    int             policy;         /* LOG_OVERFLOW_* */
+    double          deadline;       /* seconds LOG_OVERFLOW_BLOCK may wait */
+};
+
+/* a lost stream connection is re-established in the background, with a
+   jittered exponential backoff between attempts */
+struct LSF_reconnect {
+    double          min_delay;      /* seconds before the first attempt */
+    double          max_delay;      /* cap on the backoff */
+    double          delay;          /* current backoff, doubled per failure */
+    double          next_attempt;   /* monotonic time of the next connect */
+    int             down;           /* connection lost; lines are dropped */
+    int             connecting;     /* non-blocking connect in progress */
+    unsigned int    seed;           /* for rand_r jitter */
+};
+
+/* the spill file is a header page followed by a circular data area of
+   records, each a length and checksum ahead of the line as it goes on the
+   wire. Positions only ever grow; the header's tail is advanced after a
+   record is written, and its head before old records are overwritten, so
+   a crash at any point leaves [head, tail) intact. */
+#define SPILL_MAGIC     "LSFSPIL1"
+#define SPILL_HDR_SIZE  4096
+#define SPILL_REC_HDR   (2 * sizeof(uint32_t))
+#define SPILL_BATCH     64
+
+struct LSF_spill_hdr {
+    char            magic[8];
+    uint64_t        size;           /* bytes in the data area */
+    uint64_t        head;           /* position of the next line to replay */
+    uint64_t        tail;           /* position after the last whole line */
+};
+
+struct LSF_spill {
+    struct LSF_spill_hdr* hdr;      /* start of the mapping */
+    char*           data;           /* data area, SPILL_HDR_SIZE past hdr */
+    size_t          size;
+    double          rate;           /* lines replayed per second, 0 for no limit */
+    double          tokens;         /* replays allowed right now */
+    double          last_refill;    /* monotonic time tokens were last added */
+    pthread_mutex_t lock;           /* the perl thread and async worker share it */
+};
+
+static int spill_append(LogSyslogFast* logger, const struct iovec* iov, int iovcnt);
+static int spill_replay(LogSyslogFast* logger, int flags);
+static int spill_pending(LogSyslogFast* logger);
+
+/* the shared stats file is a header, a row of totals for every process
+   using it, and then one row per process. Rows are claimed by pid, so
+   workers forked from one parent each get their own. All values are
+   native-endian and only ever updated with atomic adds. */
+#define SHSTATS_MAGIC   "LSFSTAT1"
+#define SHSTATS_BUCKETS 8
+
+struct LSF_shstats_row {
+    uint64_t        pid;            /* owner, or 0 if free; unused for totals */
+    uint64_t        sent;
+    uint64_t        bytes;
+    uint64_t        dropped;
+    uint64_t        failed;
+    uint64_t        latency[SHSTATS_BUCKETS]; /* sends under 1us, 10us, ... 1s, longer */
+};
+
+struct LSF_shstats_hdr {
+    char            magic[8];
+    uint32_t        slots;          /* per-process rows after the header */
+    uint32_t        row_size;       /* sizeof(struct LSF_shstats_row) */
+    struct LSF_shstats_row total;
+};
+
+struct LSF_shstats {
+    struct LSF_shstats_hdr* hdr;    /* start of the mapping */
+    struct LSF_shstats_row* rows;
+    size_t          map_len;
+    struct LSF_shstats_row* row;    /* this process's row, or NULL if none was free */
+    unsigned long   generation;     /* fork_generation when row was claimed */
+};
+
+static void shstats_count(LogSyslogFast* logger, unsigned long sent, unsigned long bytes,
+                          unsigned long dropped, unsigned long failed);
+static void shstats_latency(LogSyslogFast* logger, double start);
+static void adopt_after_fork(LogSyslogFast* logger);
+
+/* extra receivers each line is copied to. Their sockets never block: a
+   line one can't take right now is dropped for that receiver alone, and
+   a lost connection is retried in the background, so one slow or dead
+   receiver can't hold up the others. */
+#define DEST_RETRY_DELAY 1.0
+
+struct LSF_dest {
+    int             proto;
+    char*           hostname;
+    int             port;
+    int             framing;        /* LOG_FRAMING_* if it's a stream */
+    int             sock;           /* -1 while down */
+    int             sock_type;
+    int             connecting;     /* non-blocking connect in progress */
+    double          retry_at;       /* monotonic time of the next connect */
+    struct sockaddr_storage peer_addr;
+    socklen_t       peer_len;
+    char*           pending;        /* unsent tail of a line the socket cut off */
+    size_t          pending_len;
+    unsigned long   sent;
+    unsigned long   bytes;
+    unsigned long   dropped;        /* lines skipped while full or down */
+    unsigned long   failed;         /* sends that returned an error */
+};
+
+static void dest_down(struct LSF_dest* d);
+static void dest_send(struct LSF_dest* d, const struct iovec* body, int body_cnt, size_t body_len);
+static void dest_fanout(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority);
+static void dest_after_fork(LogSyslogFast* logger);
+
+/* a pool of UDP collectors that lines are shared out among, in turn or by
+   a consistent hash of a key the caller supplies. A collector whose host
+   answers with ICMP errors is ejected for a while and its lines go to the
+   others; on the hash ring only the keys that were on it move. The ring
+   depends on nothing but the collectors' names, so every process given
+   the same list sends a key to the same place. */
+#define POOL_POINTS 160
+#define POOL_BATCH  64
+
+struct LSF_pool_member {
+    char*           hostname;
+    int             port;
+    int             sock;
+    double          ejected_until;  /* monotonic time it's readmitted, 0 if healthy */
+    unsigned long   sent;
+    unsigned long   bytes;
+    unsigned long   failed;
+    unsigned long   ejections;
+};
+
+struct LSF_pool_point {
+    uint32_t        hash;
+    int             member;
+};
+
+struct LSF_pool {
+    int             mode;           /* LOG_POOL_* */
+    double          eject_time;     /* seconds an unreachable collector sits out */
+    int             nmembers;
+    int             nejected;
+    unsigned int    next;           /* round-robin cursor */
+    struct LSF_pool_member* members;
+    struct LSF_pool_point* points;  /* hash ring, sorted by hash */
+    int             npoints;
+};
+
+static int pool_send(LogSyslogFast* logger, uint32_t route, struct iovec* iov, int iovcnt, int flags);
+static int pool_send_batch(LogSyslogFast* logger, struct iovec* iov, const int* rec_iovs,
+                           const uint32_t* routes, int n, int flags);
+
+/* the addresses tried for a receiver, in the order they're tried. Stream
+   connects race them Happy Eyeballs style (RFC 8305): a new attempt starts
+   every CONNECT_ATTEMPT_DELAY ms, or as soon as one fails, and the first
+   to connect wins. The race gives up after CONNECT_TIMEOUT ms in all. */
+#define MAX_ADDRS 8
+#define CONNECT_ATTEMPT_DELAY 250
+#define CONNECT_TIMEOUT 10000
+
+struct LSF_addr {
+    struct sockaddr_storage addr;
+    socklen_t       len;
+};
+
+/* resolved receiver addresses, shared by every logger in the process.
+   A helper thread does the lookups, so a slow or dead resolver only holds
+   up a receiver that was never resolved, and then only for the lookup
+   timeout. While a logger uses an entry it's looked up again every ttl
+   seconds; if that fails the old addresses are kept. Entries live as long
+   as the process, one per distinct receiver. */
+#define DNS_RETRY_DELAY 5.0
+
+struct LSF_dns_entry {
+    struct LSF_dns_entry* next;
+    char*           hostname;
+    int             port;
+    int             socktype;
+    int             resolved;       /* addrs holds an answer */
+    int             pending;        /* a caller is waiting for the first answer */
+    const char*     err;            /* why the last lookup failed, or NULL */
+    struct LSF_addr addrs[MAX_ADDRS];
+    int             naddrs;
+    unsigned long   gen;            /* bumped each time addrs change */
+    double          expires;        /* monotonic time of the next lookup */
+    int             users;          /* loggers connected through it */
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;         /* there may be lookups for the helper */
+    pthread_cond_t  answered;       /* a lookup finished */
+    struct LSF_dns_entry* entries;
+    double          ttl;            /* seconds between lookups, 0 if the cache is off */
+    double          timeout;        /* longest wait for a receiver's first answer */
+    pid_t           pid;            /* process the helper runs in, 0 if none */
+} dns = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          NULL, 0, 0, 0 };
+
+static void dns_start(void);
+static void dns_release(LogSyslogFast* logger);
+
+#ifdef LSF_HAVE_OPENSSL
+
+/* TLS over a LOG_TLS stream (RFC 5425). The handshake and any records
+   the server sends go through OpenSSL; lines go through SSL_write, or
+   straight to the socket once the kernel has taken over encryption
+   (kTLS). The session the server hands out is kept for the logger's
+   next connect, which then skips the full handshake. */
+#define TLS_RECORD_MAX 16384
+#define TLS_TICKET_POLLS 64
+
+struct LSF_tls {
+    SSL_CTX*        ctx;            /* the process's settings when the receiver was set */
+    SSL*            ssl;            /* NULL while not connected */
+    SSL_SESSION*    session;        /* to resume on the next connect, or NULL */
+    char*           hostname;       /* name the certificate must match */
+    int             port;
+    int             ktls;           /* the kernel encrypts what's sent on the socket */
+    int             ticket_polls;   /* sends left to look for a session ticket on */
+    unsigned long   handshakes;
+    unsigned long   resumptions;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    SSL_CTX*        ctx;            /* for new receivers; NULL until first needed */
+} tls_conf = { PTHREAD_MUTEX_INITIALIZER, NULL };
+
+#endif
+
+static void tls_drop(LogSyslogFast* logger);
+static void tls_free(LogSyslogFast* logger);
+static void tls_close(LogSyslogFast* logger);
+
+#ifdef LSF_HAVE_IO_URING
+
+/* sends queued on an io_uring instead of making a syscall each. Lines are
+   formatted into a slab registered with the kernel and handed over as
+   SEND SQEs, picked up by a kernel thread (SQPOLL) where the process may
+   have one; completions are counted on later sends. Each datagram is an
+   SQE of its own. A stream has only one SEND in flight, since a later one
+   could overtake it while the socket's buffer is full; the lines queued
+   meanwhile are gathered into the next. */
+#define URING_SLOT_SIZE     2048    /* slab bytes per ring entry */
+#define URING_SQPOLL_IDLE   50      /* ms the kernel thread spins before it sleeps */
+#define URING_PROBE         (~(uint64_t) 0)
+
+struct LSF_uring_op {
+    uint64_t        start;          /* slab position of the first line */
+    uint64_t        end;            /* slab position past the last line */
+    size_t          skip;           /* unused bytes after end, at the slab's end */
+    unsigned int    lines;
+    int             res;            /* the completion's result */
+    int             done;
+};
+
+struct LSF_uring {
+    int             fd;
+    unsigned int    entries;        /* SQ size, a power of two */
+    int             sqpoll;
+    int             fixed;          /* sends use the registered slab */
+    int             ext_arg;        /* waits can have a timeout (5.11 and later) */
+    void*           sq_ring;
+    size_t          sq_ring_len;
+    void*           cq_ring;        /* sq_ring itself with IORING_FEAT_SINGLE_MMAP */
+    size_t          cq_ring_len;
+    struct io_uring_sqe* sqes;
+    unsigned int*   sq_head;
+    unsigned int*   sq_tail;
+    unsigned int*   sq_mask;
+    unsigned int*   sq_flags;
+    unsigned int*   sq_array;
+    unsigned int*   cq_head;
+    unsigned int*   cq_tail;
+    unsigned int*   cq_mask;
+    struct io_uring_cqe* cqes;
+    char*           slab;
+    size_t          slab_size;      /* entries * URING_SLOT_SIZE */
+    uint64_t        slab_head;      /* freed up to here as ops retire */
+    uint64_t        slab_tail;      /* lines copied up to here */
+    struct LSF_uring_op* ops;       /* one per entry, by sequence number */
+    uint64_t        op_head;        /* oldest op not yet retired */
+    uint64_t        op_next;        /* oldest op not yet submitted */
+    uint64_t        op_tail;        /* next op's sequence number */
+    unsigned int    lines;          /* queued lines not yet completed */
+    int             probe_res;
+    int             probe_done;
+};
+
+#endif
+
+/* seconds queued lines get before the socket or ring is closed */
+#define URING_DRAIN_TIMEOUT 1.0
+
+static int uring_queue(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority);
+static void uring_submit(struct LSF_uring* u);
+static int uring_drain(LogSyslogFast* logger, double timeout);
+static void uring_free(LogSyslogFast* logger);
+static void uring_after_fork(LogSyslogFast* logger);
+
+/* consecutive lines to a stream gathered into one write. The buffer goes
+   out when the next line wouldn't fit, when it's full, or when a send or
+   the optional timer thread finds its oldest line max_delay old. With the
+   timer, the logger's lock is held across each send and flush, since both
+   threads write to the socket. */
+struct LSF_coalesce {
+    char*           buf;
+    size_t          size;           /* capacity, and the threshold for a write */
+    size_t          len;
+    unsigned long   lines;          /* lines in buf */
+    double          max_delay;      /* seconds the oldest line may wait, 0 for no limit */
+    double          first_at;       /* coarse monotonic time of the oldest line */
+    int             timer;          /* asked for a timer thread */
+    int             running;        /* the timer thread is up */
+    int             stop;           /* tells the timer to exit */
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;
+    struct LSF_coalesce* next_timer; /* in coalesce_timers while running */
+};
+
+/* a token bucket and a sampling rate, for one severity or for the whole
+   logger */
+struct LSF_bucket {
+    double          rate;           /* tokens added per second, 0 for no limit */
+    double          burst;          /* most tokens the bucket holds */
+    double          tokens;
+    double          last;           /* coarse monotonic time tokens were last added at */
+    double          sample;         /* fraction of lines kept, 1 for all */
+};
+
+/* buckets are refilled by the fraction of a second that has passed, read
+   from the coarse monotonic clock that never leaves the vDSO. Lines
+   dropped are tallied and the tally goes out as a line of its own once
+   interval seconds have passed since the first of them, or when the
+   logger is flushed or destroyed. */
+#define LIMIT_REPORT_INTERVAL 10
+#define LIMIT_REPORT_SEVERITY 4 /* LOG_WARNING */
+
+struct LSF_limit {
+    struct LSF_bucket sev[8];
+    struct LSF_bucket all;
+    unsigned long   suppressed;     /* lines dropped and not yet reported */
+    double          since;          /* coarse monotonic time of the first of them */
+    int             interval;       /* seconds between reports, 0 for none */
+    unsigned int    seed;           /* for rand_r sampling */
+};
+
+/* the lines seen last, by a hash of their text. A line that comes again
+   within window seconds of going out is counted instead of sent, and the
+   count goes out as one summary line when a different line follows, the
+   window closes or the slot is taken. */
+#define DEDUP_SLOTS_MAX 64
+#define DEDUP_EXCERPT   80          /* bytes of a line kept to quote in its summary */
+
+struct LSF_dedup_slot {
+    uint64_t        hash;           /* 0 for an empty slot */
+    int             len;
+    int             priority;
+    uint32_t        route;
+    time_t          since;          /* send time the line went out */
+    unsigned long   repeats;        /* times it came again since */
+    char            excerpt[DEDUP_EXCERPT];
+};
+
+struct LSF_dedup {
+    int             window;         /* seconds repeats are gathered for */
+    int             nslots;
+    int             pending;        /* slots with repeats not yet summarized */
+    struct LSF_dedup_slot* slots;
+    struct LSF_dedup_slot* last;    /* the slot of the line seen last */
+};
+
+static void limit_free(LogSyslogFast* logger, int flush);
+static void dedup_free(LogSyslogFast* logger, int flush);
+static int is_coalescing(LogSyslogFast* logger);
+static int coalesce_write(LogSyslogFast* logger, int flags);
+static void coalesce_free(LogSyslogFast* logger, int flush);
+static int coalesce_start_timer(LogSyslogFast* logger);
+static int coalesce_spawn_timer(LogSyslogFast* logger);
+static void coalesce_stop_timer(LogSyslogFast* logger);
+static void coalesce_init_wakeup(struct LSF_coalesce* c);
+
+/* bumped in every child right after a fork, so a logger can tell that it
+   was inherited without calling getpid on each send */
+static unsigned long fork_generation = 1;
+static pthread_once_t fork_hook_once = PTHREAD_ONCE_INIT;
+
+/* the coalescing loggers whose timer thread is running */
+static struct LSF_coalesce* coalesce_timers;
+static pthread_mutex_t coalesce_timers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the DNS cache's lock, and the lock of every coalescing buffer a timer
+   thread shares, are held across fork so the child gets them in a
+   consistent state. Senders may take the DNS lock while holding a
+   buffer's, so the buffers' are taken first. The parent's threads may be
+   waiting on the condition variables, which the child can't use in that
+   state, so it gets fresh ones; its own threads are started on demand. */
 static
 void
-update_prefix(LogSyslogFast* logger, time_t t)
+fork_prepare_hook(void)
 {
-    if (!logger->sender || !logger->name)
-        return; /* still initializing */
+    struct LSF_coalesce* c;
 
-    logger->last_time = t;
+    pthread_mutex_lock(&coalesce_timers_lock);
+    for (c = coalesce_timers; c; c = c->next_timer)
+        pthread_mutex_lock(&c->lock);
+    pthread_mutex_lock(&dns.lock);
+}
+
+static
+void
+fork_parent_hook(void)
+{
+    struct LSF_coalesce* c;
+
+    pthread_mutex_unlock(&dns.lock);
+    for (c = coalesce_timers; c; c = c->next_timer)
+        pthread_mutex_unlock(&c->lock);
+    pthread_mutex_unlock(&coalesce_timers_lock);
+}
+
+static
+void
+fork_child_hook(void)
+{
+    struct LSF_coalesce* c;
+
+    fork_generation++;
+    pthread_cond_init(&dns.wakeup, NULL);
+    pthread_cond_init(&dns.answered, NULL);
+    pthread_mutex_unlock(&dns.lock);
+    for (c = coalesce_timers; c; c = c->next_timer) {
+        coalesce_init_wakeup(c);
+        pthread_mutex_unlock(&c->lock);
+    }
+    coalesce_timers = NULL;
+    pthread_mutex_unlock(&coalesce_timers_lock);
+}
+
+static
+void
+install_fork_hook(void)
+{
+    pthread_atfork(fork_prepare_hook, fork_parent_hook, fork_child_hook);
+}
+
+/* with an async worker both threads may count drops and failures, so
+   those are added atomically; everything else has a single writer */
+static
+void
+count_sent(LogSyslogFast* logger, unsigned long lines, unsigned long bytes)
+{
+    logger->stats.sent += lines;
+    logger->stats.bytes += bytes;
+    if (logger->shstats)
+        shstats_count(logger, lines, bytes, 0, 0);
+}
+
+static
+void
+count_dropped(LogSyslogFast* logger, unsigned long lines)
+{
+    __atomic_add_fetch(&logger->stats.dropped, lines, __ATOMIC_RELAXED);
+    if (logger->shstats)
+        shstats_count(logger, 0, 0, lines, 0);
+}
+
+static
+void
+count_failure(LogSyslogFast* logger, int err)
+{
+    unsigned long* by_errno = NULL;
+
+    __atomic_add_fetch(&logger->stats.failed, 1, __ATOMIC_RELAXED);
+    if (err == EAGAIN || err == EWOULDBLOCK)
+        by_errno = &logger->stats.eagain;
+    else if (err == ENOBUFS)
+        by_errno = &logger->stats.enobufs;
+    else if (err == ECONNREFUSED)
+        by_errno = &logger->stats.econnrefused;
+    if (by_errno)
+        __atomic_add_fetch(by_errno, 1, __ATOMIC_RELAXED);
+    if (logger->shstats)
+        shstats_count(logger, 0, 0, 0, 1);
+}
+
+static int async_enqueue(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority,
+                         uint32_t route);
+static void async_stop(LogSyslogFast* logger, int force);
+static void gso_refresh(LogSyslogFast* logger);
+static void wbuf_free(LogSyslogFast* logger);
+static int wbuf_attach(LogSyslogFast* logger);
+static void wbuf_drop_partial(LogSyslogFast* logger);
+static int reconnect_ready(LogSyslogFast* logger);
+static int reconnect_lost(LogSyslogFast* logger);
+
+/* "<PRI>" for every facility/severity combination, filled in on first use */
+#define PRI_COUNT 192
+static char pri_str[PRI_COUNT][6];
+static int pri_len[PRI_COUNT];
+
+static
+void
+init_pri_table()
+{
+    int i;
+    if (pri_len[PRI_COUNT - 1])
+        return;
+    for (i = 0; i < PRI_COUNT; i++)
+        pri_len[i] = snprintf(pri_str[i], sizeof(pri_str[i]), "<%d>", i);
+}
+
+static const char* const month_abbrev[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static
+void
+put2(char* p, int n)
+{
+    p[0] = '0' + n / 10;
+    p[1] = '0' + n % 10;
+}
+
+/* seconds since the epoch of a broken-down time taken as if it were UTC;
+   subtracting the real time_t gives the zone's offset without tm_gmtoff */
+static
+long
+tm_as_utc(const struct tm* tm)
+{
+    long y = tm->tm_year + 1900L - (tm->tm_mon < 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long m = tm->tm_mon + 1;
+    long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + tm->tm_mday - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = era * 146097 + doe - 719468;
+    return days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
+}
+
+/* write the leading digits of a microsecond count, e.g. 3 digits for ms */
+static
+void
+put_frac(char* p, int digits, long usec)
+{
+    int i;
+    for (i = digits; i < 6; i++)
+        usec /= 10;
+    for (i = digits - 1; i >= 0; i--) {
+        p[i] = '0' + usec % 10;
+        usec /= 10;
+    }
+}
 
-    /* LOG_RFC3164 time string tops out at 15 chars, LOG_RFC5424 at 25 */
-    char timestr[26];
-    strftime(timestr, 26, logger->time_format, localtime(&t));
+/* the TIME-SECFRAC digits only exist in RFC5424 timestamps */
+static
+int
+frac_digits(LogSyslogFast* logger)
+{
+    return logger->format == LOG_RFC5424 ? logger->time_precision : 0;
+}
 
-    /* %z in strftime returns 4DIGIT, but we need 2DIGIT ":" 2DIGIT */
+/* render the timestamp for the current format into timestr, which must hold
+   33 bytes, and return the offset of the HH:MM:SS digits within it */
+static
+int
+format_timestamp(LogSyslogFast* logger, const struct tm* tm, char* timestr)
+{
     if (logger->format == LOG_RFC5424) {
-        timestr[25] = 0;
-        timestr[24] = timestr[23];
-        timestr[23] = timestr[22];
+        /* YYYY-MM-DDThh:mm:ss[.ffffff]+hh:mm */
+        long off = logger->utc_offset;
+        int year = tm->tm_year + 1900;
+        int digits = frac_digits(logger);
+        put2(timestr, year / 100);
+        put2(timestr + 2, year % 100);
+        timestr[4] = '-';
+        put2(timestr + 5, tm->tm_mon + 1);
+        timestr[7] = '-';
+        put2(timestr + 8, tm->tm_mday);
+        timestr[10] = 'T';
+        put2(timestr + 11, tm->tm_hour);
+        timestr[13] = ':';
+        put2(timestr + 14, tm->tm_min);
+        timestr[16] = ':';
+        put2(timestr + 17, tm->tm_sec);
+        if (digits) {
+            timestr[19] = '.';
+            put_frac(timestr + 20, digits, logger->usec);
+            timestr += digits + 1;
+        }
+        timestr[19] = off < 0 ? '-' : '+';
+        if (off < 0)
+            off = -off;
+        put2(timestr + 20, off / 3600);
         timestr[22] = ':';
+        put2(timestr + 23, off / 60 % 60);
+        timestr[25] = 0;
+        return 11;
+    }
+    else {
+        /* Mmm dd hh:mm:ss, with the day space-padded */
+        memcpy(timestr, month_abbrev[tm->tm_mon], 3);
+        timestr[3] = ' ';
+        put2(timestr + 4, tm->tm_mday);
+        if (timestr[4] == '0')
+            timestr[4] = ' ';
+        timestr[6] = ' ';
+        put2(timestr + 7, tm->tm_hour);
+        timestr[9] = ':';
+        put2(timestr + 10, tm->tm_min);
+        timestr[12] = ':';
+        put2(timestr + 13, tm->tm_sec);
+        timestr[15] = 0;
+        return 7;
     }
+}
+
+static
+void
+update_prefix(LogSyslogFast* logger, time_t t)
+{
+    if (!logger->sender || !logger->name)
+        return; /* still initializing */
+
+    struct tm tm;
+    localtime_r(&t, &tm);
+
+    logger->stats.prefix_rebuilds++;
+    logger->last_time = t;
+    logger->minute_start = t - tm.tm_sec;
+    logger->utc_offset = tm_as_utc(&tm) - t;
+    logger->time_day = tm.tm_year * 1000 + tm.tm_yday;
+
+    /* LOG_RFC3164 time string tops out at 15 chars, LOG_RFC5424 at 32 */
+    char timestr[33];
+    int clock_pos = format_timestamp(logger, &tm, timestr);
 
     if (logger->format == LOG_RFC3164 || logger->format == LOG_RFC5424) {
         logger->prefix_len = snprintf(
@@ -50,10 +763,64 @@ update_prefix(LogSyslogFast* logger, time_t t)
     if (logger->prefix_len > logger->bufsize - 1)
         logger->prefix_len = logger->bufsize - 1;
 
+    /* the timestamp follows "<PRI>", or "<PRI>1 " for RFC5424 */
+    logger->pri_len = snprintf(NULL, 0, "<%d>", logger->priority);
+    logger->clock_pos = logger->pri_len
+        + (logger->format == LOG_RFC5424 ? 2 : 0) + clock_pos;
+    logger->frac_pos = frac_digits(logger) ? logger->clock_pos + 9 : 0;
+
     /* cache the location in linebuf where msg should be pasted in */
     logger->msg_start = logger->linebuf + logger->prefix_len;
 }
 
+/* bring the prefix's timestamp up to t. Within the same minute only the
+   seconds digits change; within the same day and UTC offset the clock
+   digits are patched in place; anything else rebuilds the whole prefix. */
+static
+void
+update_time(LogSyslogFast* logger, time_t t)
+{
+    char* hms = logger->linebuf + logger->clock_pos;
+
+    if (t >= logger->minute_start && t < logger->minute_start + 60) {
+        put2(hms + 6, t - logger->minute_start);
+        logger->last_time = t;
+        return;
+    }
+
+    struct tm tm;
+    localtime_r(&t, &tm);
+
+    if (tm.tm_year * 1000 + tm.tm_yday != logger->time_day
+        || tm_as_utc(&tm) - t != logger->utc_offset)
+    {
+        update_prefix(logger, t);
+        return;
+    }
+
+    put2(hms, tm.tm_hour);
+    put2(hms + 3, tm.tm_min);
+    put2(hms + 6, tm.tm_sec);
+    logger->minute_start = t - tm.tm_sec;
+    logger->last_time = t;
+}
+
+/* make the prefix's timestamp match t and the pending fraction of a second */
+static
+void
+stamp_prefix(LogSyslogFast* logger, time_t t)
+{
+    if (logger->fork_gen != fork_generation)
+        adopt_after_fork(logger);
+
+    /* update the prefix if seconds have rolled over */
+    if (t != logger->last_time)
+        update_time(logger, t);
+
+    if (logger->frac_pos)
+        put_frac(logger->linebuf + logger->frac_pos, logger->time_precision, logger->usec);
+}
+
 LogSyslogFast*
 LSF_alloc()
 {
@@ -68,9 +835,14 @@ LSF_init(
     if (!logger)
         return -1;
 
+    init_pri_table();
+    pthread_once(&fork_hook_once, install_fork_hook);
+
     logger->sock = -1;
+    logger->sock_type = SOCK_DGRAM;
 
-    logger->pid = getpid();
+    logger->pid = logger->proc_pid = getpid();
+    logger->fork_gen = fork_generation;
 
     logger->linebuf = malloc(logger->bufsize = INITIAL_BUFSIZE);
     if (!logger->linebuf) {
@@ -80,6 +852,33 @@ LSF_init(
 
     logger->sender = NULL;
     logger->name = NULL;
+    logger->zerocopy = 0;
+    logger->framing = LOG_FRAMING_NONE;
+    logger->time_precision = 0;
+    logger->coarse_clock = 0;
+    logger->usec = 0;
+    logger->async = NULL;
+    logger->wbuf = NULL;
+    logger->reconnect = NULL;
+    logger->spill = NULL;
+    logger->peer_len = 0;
+    logger->send_flags = 0;
+    memset(&logger->stats, 0, sizeof(logger->stats));
+    logger->shstats = NULL;
+    logger->dests = NULL;
+    logger->ndests = 0;
+    logger->pool = NULL;
+    logger->dns = NULL;
+    logger->dns_gen = 0;
+    logger->tls = NULL;
+    logger->uring = NULL;
+    logger->coalesce = NULL;
+    logger->gso = 0;
+    logger->gso_seg = 0;
+    logger->min_severity = 7; /* LOG_DEBUG, so nothing is filtered */
+    logger->min_severity_word = NULL;
+    logger->limit = NULL;
+    logger->dedup = NULL;
     LSF_set_format(logger, LOG_RFC3164);
     LSF_set_sender(logger, sender);
     LSF_set_name(logger, name);
@@ -93,7 +892,50 @@ LSF_init(
 int
 LSF_destroy(LogSyslogFast* logger)
 {
-    int ret = close(logger->sock);
+    /* a child letting go of a logger it never used mustn't flush or touch
+       the socket's flags; the parent still owns both */
+    if (logger->fork_gen != fork_generation && logger->wbuf) {
+        free(logger->wbuf->buf);
+        free(logger->wbuf);
+        logger->wbuf = NULL;
+    }
+
+    if (logger->dedup)
+        dedup_free(logger, logger->fork_gen == fork_generation);
+    if (logger->limit)
+        limit_free(logger, logger->fork_gen == fork_generation);
+    if (logger->coalesce)
+        coalesce_free(logger, logger->fork_gen == fork_generation);
+    if (logger->async)
+        async_stop(logger, 1);
+    if (logger->wbuf)
+        wbuf_free(logger);
+    if (logger->uring) {
+        if (logger->fork_gen == fork_generation)
+            uring_drain(logger, URING_DRAIN_TIMEOUT);
+        uring_free(logger);
+    }
+    if (logger->dests)
+        LSF_clear_receivers(logger);
+    if (logger->pool)
+        LSF_set_pool(logger, NULL, NULL, 0, LOG_POOL_ROUND_ROBIN, 0);
+    dns_release(logger);
+    free(logger->reconnect);
+    if (logger->spill)
+        LSF_set_spill(logger, NULL, 0, 0);
+    if (logger->shstats)
+        LSF_set_shared_stats(logger, NULL, 0);
+    if (logger->min_severity_word)
+        LSF_set_min_severity_file(logger, NULL);
+    if (logger->tls) {
+        /* a child mustn't end the session the parent is still using */
+        if (logger->fork_gen == fork_generation)
+            tls_close(logger);
+        tls_free(logger);
+    }
+
+    /* the socket is already closed if a reconnect is pending */
+    int ret = logger->sock >= 0 ? close(logger->sock) : 0;
     if (ret)
         logger->err = strerror(errno);
     free(logger->sender);
@@ -122,6 +964,61 @@ LSF_set_severity(LogSyslogFast* logger, int severity)
     LSF_set_priority(logger, LSF_get_facility(logger), severity);
 }
 
+/* a plain store, so it's safe from a signal handler; with a control file
+   it goes to every process sharing the file */
+void
+LSF_set_min_severity(LogSyslogFast* logger, int severity)
+{
+    if (logger->min_severity_word)
+        __atomic_store_n(logger->min_severity_word, severity, __ATOMIC_RELAXED);
+    else
+        logger->min_severity = severity;
+}
+
+/* take the threshold from a native int at the start of path, which any
+   process may change. A new or empty file starts out with the current
+   threshold; a NULL path goes back to a threshold of the logger's own,
+   keeping the file's last value. */
+int
+LSF_set_min_severity_file(LogSyslogFast* logger, const char* path)
+{
+    int* word;
+    struct stat st;
+    int fd;
+
+    if (logger->min_severity_word) {
+        logger->min_severity = LSF_get_min_severity(logger);
+        munmap(logger->min_severity_word, sizeof(int));
+        logger->min_severity_word = NULL;
+    }
+    if (!path)
+        return 0;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        logger->err = strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t) sizeof(int)
+        && pwrite(fd, &logger->min_severity, sizeof(int), 0) != sizeof(int))
+    {
+        logger->err = strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    word = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (word == MAP_FAILED) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    logger->min_severity_word = word;
+    return 0;
+}
+
 int
 LSF_set_sender(LogSyslogFast* logger, const char* sender)
 {
@@ -155,6 +1052,65 @@ LSF_set_pid(LogSyslogFast* logger, int pid)
     update_prefix(logger, time(0));
 }
 
+void
+LSF_set_zerocopy(LogSyslogFast* logger, int zerocopy)
+{
+    logger->zerocopy = zerocopy ? 1 : 0;
+}
+
+int
+LSF_set_framing(LogSyslogFast* logger, int framing)
+{
+    if (framing != LOG_FRAMING_NONE && framing != LOG_FRAMING_OCTET
+        && framing != LOG_FRAMING_LF)
+    {
+        logger->err = "invalid framing constant";
+        return -1;
+    }
+    if (logger->tls && framing != LOG_FRAMING_OCTET) {
+        logger->err = "TLS receivers always use octet-counting framing";
+        return -1;
+    }
+    logger->framing = framing;
+    return 0;
+}
+
+int
+LSF_set_time_precision(LogSyslogFast* logger, int digits, int coarse)
+{
+    if (digits < 0 || digits > 6) {
+        logger->err = "time precision must be between 0 and 6 digits";
+        return -1;
+    }
+    logger->time_precision = digits;
+    logger->coarse_clock = coarse ? 1 : 0;
+    update_prefix(logger, time(0));
+    return 0;
+}
+
+void
+LSF_set_usec(LogSyslogFast* logger, long usec)
+{
+    logger->usec = usec;
+}
+
+time_t
+LSF_now(LogSyslogFast* logger)
+{
+    struct timespec ts;
+    clockid_t clock = CLOCK_REALTIME;
+
+#ifdef CLOCK_REALTIME_COARSE
+    /* tick-granular (typically 1-4ms) but never leaves the vDSO */
+    if (logger->coarse_clock)
+        clock = CLOCK_REALTIME_COARSE;
+#endif
+
+    clock_gettime(clock, &ts);
+    logger->usec = ts.tv_nsec / 1000;
+    return ts.tv_sec;
+}
+
 int
 LSF_set_format(LogSyslogFast* logger, int format)
 {
@@ -174,7 +1130,6 @@ LSF_set_format(LogSyslogFast* logger, int format)
 
             Example: "Jan  4 11:22:33"
         */
-        logger->time_format = "%h %e %H:%M:%S";
         logger->msg_format = "<%d>%s %s %s[%d]: ";
     }
     else if (logger->format == LOG_RFC5424) {
@@ -195,16 +1150,14 @@ LSF_set_format(LogSyslogFast* logger, int format)
             TIME-OFFSET     = "Z" / TIME-NUMOFFSET
             TIME-NUMOFFSET  = ("+" / "-") TIME-HOUR ":" TIME-MINUTE
 
-            Example: "2012-01-04T11:22:33-0800"
+            Example: "2012-01-04T11:22:33-08:00"
         */
-        logger->time_format = "%Y-%m-%dT%H:%M:%S%z";
 
         /* STRUCTURED-DATA and MSGID fields are omitted */
         logger->msg_format = "<%d>1 %s %s %s %d - - ";
     }
     else if (logger->format == LOG_RFC3164_LOCAL) {
         /* Same as LOG_RFC3164 but without HOSTNAME */
-        logger->time_format = "%h %e %H:%M:%S";
         logger->msg_format = "<%d>%s %s[%d]: ";
     }
     else {
@@ -215,125 +1168,546 @@ LSF_set_format(LogSyslogFast* logger, int format)
     return 0;
 }
 
-#ifdef AF_INET6
-#define clean_return(x) if (results) freeaddrinfo(results); return x;
-#else
-#define clean_return(x) return x;
-#endif
-
 /* must match constants in LogSyslogFast.pm */
 #define LOG_UDP  0
 #define LOG_TCP  1
 #define LOG_UNIX 2
+#define LOG_TLS  3
+
+static double monotonic_now();
 
-int
-LSF_set_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port)
-{
-    const struct sockaddr* p_address;
-    int address_len;
 #ifdef AF_INET6
-    struct addrinfo* results = NULL;
+
+/* For NetBSD: http://www.mail-archive.com/bug-gnulib@gnu.org/msg17067.html */
+#ifndef AI_ADDRCONFIG
+#define AI_ADDRCONFIG 0
 #endif
 
-    if (logger->sock >= 0) {
-        int ret = close(logger->sock);
-        if (ret) {
-            logger->err = strerror(errno);
-            return -1;
+/* For MacOS: http://mailman.videolan.org/pipermail/vlc-devel/2008-May/044005.html */
+#ifndef AI_NUMERICSERV
+#define AI_NUMERICSERV 0
+#endif
+
+/* the addresses getaddrinfo gives for a receiver, at most MAX_ADDRS of
+   them, reordered so the address families take turns (RFC 8305, section
+   4) starting with whichever family the resolver put first */
+static
+int
+resolve_addrs(const char* hostname, int port, int socktype, struct LSF_addr* addrs,
+              const char** err)
+{
+    struct addrinfo hints;
+    struct addrinfo* results = NULL;
+    struct addrinfo* rp;
+    struct addrinfo* first[MAX_ADDRS];
+    struct addrinfo* other[MAX_ADDRS];
+    char portstr[32];
+    int nfirst = 0, nother = 0;
+    int i, n = 0;
+    int r;
+
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+
+    r = getaddrinfo(hostname, portstr, &hints, &results);
+    if (r != 0) {
+        *err = gai_strerror(r);
+        return -1;
+    }
+    if (!results) {
+        *err = "no results from getaddrinfo";
+        return -1;
+    }
+
+    for (rp = results; rp; rp = rp->ai_next) {
+        if (rp->ai_addrlen > sizeof(struct sockaddr_storage))
+            continue;
+        if (rp->ai_family == results->ai_family) {
+            if (nfirst < MAX_ADDRS)
+                first[nfirst++] = rp;
+        }
+        else if (nother < MAX_ADDRS) {
+            other[nother++] = rp;
         }
     }
 
-    /* set up a socket, letting kernel assign local port */
-    if (proto == LOG_UDP || proto == LOG_TCP) {
+    for (i = 0; n < MAX_ADDRS && (i < nfirst || i < nother); i++) {
+        if (i < nfirst) {
+            memset(&addrs[n], 0, sizeof(struct LSF_addr));
+            memcpy(&addrs[n].addr, first[i]->ai_addr, first[i]->ai_addrlen);
+            addrs[n++].len = first[i]->ai_addrlen;
+        }
+        if (i < nother && n < MAX_ADDRS) {
+            memset(&addrs[n], 0, sizeof(struct LSF_addr));
+            memcpy(&addrs[n].addr, other[i]->ai_addr, other[i]->ai_addrlen);
+            addrs[n++].len = other[i]->ai_addrlen;
+        }
+    }
+    freeaddrinfo(results);
 
-#ifdef AF_INET6
+    if (n == 0) {
+        *err = "no usable results from getaddrinfo";
+        return -1;
+    }
+    return n;
+}
 
-/* For NetBSD: http://www.mail-archive.com/bug-gnulib@gnu.org/msg17067.html */
-#ifndef AI_ADDRCONFIG
-#define AI_ADDRCONFIG 0
+/* look up receivers that are waiting for a first answer or due for a
+   refresh, one at a time, sleeping until the next is due */
+static
+void*
+dns_worker(void* arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&dns.lock);
+    for (;;) {
+        struct LSF_dns_entry* e;
+        struct LSF_dns_entry* due = NULL;
+        struct LSF_addr addrs[MAX_ADDRS];
+        const char* err = NULL;
+        double now = monotonic_now();
+        double next = 0;
+        int ret;
+
+        for (e = dns.entries; e; e = e->next) {
+            if (!e->pending && (!e->users || dns.ttl <= 0))
+                continue;
+            if (e->pending || e->expires <= now) {
+                due = e;
+                break;
+            }
+            if (!next || e->expires < next)
+                next = e->expires;
+        }
+
+        if (!due) {
+            if (next) {
+                struct timespec until;
+                double wait = next - now;
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_sec += (time_t) wait;
+                until.tv_nsec += (long) ((wait - (time_t) wait) * 1e9);
+                if (until.tv_nsec >= 1000000000) {
+                    until.tv_sec++;
+                    until.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&dns.wakeup, &dns.lock, &until);
+            }
+            else {
+                pthread_cond_wait(&dns.wakeup, &dns.lock);
+            }
+            continue;
+        }
+
+        /* entries are never freed, so due stays valid while unlocked */
+        pthread_mutex_unlock(&dns.lock);
+        ret = resolve_addrs(due->hostname, due->port, due->socktype, addrs, &err);
+        pthread_mutex_lock(&dns.lock);
+
+        now = monotonic_now();
+        if (ret > 0) {
+            if (!due->resolved || ret != due->naddrs
+                || memcmp(addrs, due->addrs, ret * sizeof(struct LSF_addr)) != 0)
+            {
+                memcpy(due->addrs, addrs, ret * sizeof(struct LSF_addr));
+                due->naddrs = ret;
+                __atomic_add_fetch(&due->gen, 1, __ATOMIC_RELEASE);
+            }
+            due->resolved = 1;
+            due->err = NULL;
+            due->expires = now + dns.ttl;
+        }
+        else {
+            due->err = err;
+            due->expires = now + (dns.ttl < DNS_RETRY_DELAY ? dns.ttl : DNS_RETRY_DELAY);
+        }
+        due->pending = 0;
+        pthread_cond_broadcast(&dns.answered);
+    }
+
+    return NULL;
+}
+
+/* start the helper thread in this process if it isn't running; the caller
+   holds dns.lock */
+static
+void
+dns_start(void)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t all, old;
+
+    if (dns.pid == getpid())
+        return;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (pthread_create(&thread, &attr, dns_worker, NULL) == 0)
+        dns.pid = getpid();
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+/* the cache entry for a receiver, made if need be; the caller holds dns.lock */
+static
+struct LSF_dns_entry*
+dns_entry(const char* hostname, int port, int socktype)
+{
+    struct LSF_dns_entry* e;
+
+    for (e = dns.entries; e; e = e->next)
+        if (e->port == port && e->socktype == socktype && strcmp(e->hostname, hostname) == 0)
+            return e;
+
+    e = calloc(1, sizeof(struct LSF_dns_entry));
+    if (!e)
+        return NULL;
+    e->hostname = strdup(hostname);
+    if (!e->hostname) {
+        free(e);
+        return NULL;
+    }
+    e->port = port;
+    e->socktype = socktype;
+    e->next = dns.entries;
+    dns.entries = e;
+    return e;
+}
+
+/* a receiver's addresses from the cache. They're handed back right away
+   even if they're due for a refresh; only a receiver with no answer yet
+   waits, for at most the cache's timeout. */
+static
+int
+dns_lookup(const char* hostname, int port, int socktype, struct LSF_addr* addrs,
+           const char** err)
+{
+    struct LSF_dns_entry* e;
+    int ret = 0;
+
+    pthread_mutex_lock(&dns.lock);
+    e = dns_entry(hostname, port, socktype);
+    if (!e) {
+        pthread_mutex_unlock(&dns.lock);
+        *err = strerror(errno);
+        return -1;
+    }
+
+    if (!e->resolved) {
+        struct timespec until;
+        double wait = dns.timeout;
+
+        e->pending = 1;
+        dns_start();
+        pthread_cond_signal(&dns.wakeup);
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += (time_t) wait;
+        until.tv_nsec += (long) ((wait - (time_t) wait) * 1e9);
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        while (e->pending)
+            if (pthread_cond_timedwait(&dns.answered, &dns.lock, &until) == ETIMEDOUT)
+                break;
+    }
+
+    if (e->resolved) {
+        memcpy(addrs, e->addrs, e->naddrs * sizeof(struct LSF_addr));
+        ret = e->naddrs;
+    }
+    else {
+        *err = e->pending ? "lookup timed out" : e->err;
+        ret = -1;
+    }
+    pthread_mutex_unlock(&dns.lock);
+    return ret;
+}
+
+#endif /* AF_INET6 */
+
+int
+LSF_set_dns_cache(double ttl, double timeout)
+{
+#ifdef AF_INET6
+    pthread_mutex_lock(&dns.lock);
+    dns.ttl = ttl > 0 ? ttl : 0;
+    dns.timeout = timeout > 0 ? timeout : 0;
+    /* the helper picks up a new ttl on its next pass */
+    pthread_cond_signal(&dns.wakeup);
+    pthread_mutex_unlock(&dns.lock);
+    return 0;
+#else
+    return ttl > 0 ? -1 : 0;
 #endif
+}
 
-/* For MacOS: http://mailman.videolan.org/pipermail/vlc-devel/2008-May/044005.html */
-#ifndef AI_NUMERICSERV
-#define AI_NUMERICSERV 0
+double
+LSF_get_dns_cache(void)
+{
+    return dns.ttl;
+}
+
+/* take or give up a logger's claim on its receiver's cache entry, which
+   keeps the entry being refreshed */
+static
+void
+dns_hold(LogSyslogFast* logger, int proto, const char* hostname, int port)
+{
+#ifdef AF_INET6
+    if (dns.ttl <= 0 || (proto != LOG_UDP && proto != LOG_TCP))
+        return;
+
+    pthread_mutex_lock(&dns.lock);
+    logger->dns = dns_entry(hostname, port, logger->sock_type);
+    if (logger->dns) {
+        logger->dns->users++;
+        logger->dns_gen = logger->dns->gen;
+        pthread_cond_signal(&dns.wakeup);
+    }
+    pthread_mutex_unlock(&dns.lock);
 #endif
+}
 
-        struct addrinfo *rp;
-        struct addrinfo hints;
-        char portstr[32];
-        int r;
+static
+void
+dns_release(LogSyslogFast* logger)
+{
+    if (!logger->dns)
+        return;
+    pthread_mutex_lock(&dns.lock);
+    logger->dns->users--;
+    pthread_mutex_unlock(&dns.lock);
+    logger->dns = NULL;
+}
 
-        snprintf(portstr, sizeof(portstr), "%d", port);
-        memset(&hints, 0, sizeof(hints));
-        hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
-        hints.ai_family = AF_UNSPEC;
-        if (proto == LOG_TCP) {
-            hints.ai_socktype = SOCK_STREAM;
-        } else {
-            hints.ai_socktype = SOCK_DGRAM;
-        }
-        hints.ai_protocol = 0;
-        hints.ai_addrlen = 0;
-        hints.ai_addr = NULL;
-        hints.ai_canonname = NULL;
-        hints.ai_next = NULL;
+/* has the receiver's address changed since the logger last looked? */
+static
+int
+dns_moved(LogSyslogFast* logger)
+{
+    return logger->dns && __atomic_load_n(&logger->dns->gen, __ATOMIC_ACQUIRE) != logger->dns_gen;
+}
 
-        r = getaddrinfo(hostname, portstr, &hints, &results);
-        if (r < 0) {
-            logger->err = gai_strerror(r);
-            return -1;
+/* take on the receiver's new address. A datagram socket is pointed at it
+   right away, keeping its descriptor; a stream moves over when it next
+   connects. */
+static
+void
+dns_follow(LogSyslogFast* logger)
+{
+    struct LSF_dns_entry* e = logger->dns;
+    int family = logger->peer_addr.ss_family;
+
+    pthread_mutex_lock(&dns.lock);
+    logger->dns_gen = e->gen;
+    memcpy(&logger->peer_addr, &e->addrs[0].addr, e->addrs[0].len);
+    logger->peer_len = e->addrs[0].len;
+    pthread_mutex_unlock(&dns.lock);
+
+    if (logger->sock_type != SOCK_DGRAM || logger->sock < 0)
+        return;
+
+    if (logger->peer_addr.ss_family != family) {
+        int sock = socket(logger->peer_addr.ss_family, SOCK_DGRAM, 0);
+        if (sock < 0)
+            return;
+        dup2(sock, logger->sock);
+        close(sock);
+        fcntl(logger->sock, F_SETFD, FD_CLOEXEC);
+    }
+    connect(logger->sock, (struct sockaddr*) &logger->peer_addr, logger->peer_len);
+    gso_refresh(logger);
+}
+
+#ifdef AF_INET6
+
+/* connect a socket to the first of addrs that will take it. A datagram
+   socket connects without waiting, so the first address that gets a socket
+   wins; stream connects are raced, staggered CONNECT_ATTEMPT_DELAY ms apart
+   and started early when one fails, keeping the first to connect, and fail
+   with ETIMEDOUT if none has by the deadline. */
+static
+int
+connect_addrs(int socktype, const struct LSF_addr* addrs, int n, int* which, const char** err)
+{
+    struct pollfd pfd[MAX_ADDRS];
+    int tried[MAX_ADDRS];
+    double deadline = monotonic_now() + CONNECT_TIMEOUT / 1000.0;
+    int npending = 0;
+    int next = 0;
+    int sock = -1;
+    int last_err = 0;
+    int i;
+
+    while (sock < 0) {
+        if (next < n) {
+            int s = socket(addrs[next].addr.ss_family, socktype, 0);
+            if (s < 0) {
+                last_err = errno;
+                next++;
+                continue;
+            }
+            fcntl(s, F_SETFD, FD_CLOEXEC);
+
+            if (socktype == SOCK_STREAM)
+                fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+            if (connect(s, (const struct sockaddr*) &addrs[next].addr, addrs[next].len) == 0) {
+                sock = s;
+                *which = next;
+                break;
+            }
+            if (errno == EINPROGRESS) {
+                pfd[npending].fd = s;
+                pfd[npending].events = POLLOUT;
+                tried[npending++] = next++;
+            }
+            else {
+                last_err = errno;
+                close(s);
+                next++;
+                continue;
+            }
         }
-        else if (!results) {
-            logger->err = "no results from getaddrinfo";
-            return -1;
+        if (npending == 0)
+            break;
+
+        /* wait for an attempt to finish, or until the next is due, but
+           not past the deadline */
+        int wait = (int) ((deadline - monotonic_now()) * 1000);
+        if (wait <= 0) {
+            last_err = ETIMEDOUT;
+            break;
         }
-        for (rp = results; rp != NULL; rp = rp->ai_next) {
-            logger->sock = socket(rp->ai_family, rp->ai_socktype, 0);
-            if (logger->sock == -1) {
-                r = errno;
+        if (next < n && wait > CONNECT_ATTEMPT_DELAY)
+            wait = CONNECT_ATTEMPT_DELAY;
+        int ret = poll(pfd, npending, wait);
+        if (ret < 0) {
+            if (errno == EINTR)
                 continue;
-            }
-            p_address = rp->ai_addr;
-            address_len = rp->ai_addrlen;
+            last_err = errno;
             break;
         }
-        if (logger->sock == -1) {
-            logger->err = "socket failure";
-            clean_return(-1);
+
+        for (i = 0; i < npending && ret > 0; i++) {
+            int so_err = 0;
+            socklen_t so_len = sizeof(so_err);
+
+            if (!pfd[i].revents)
+                continue;
+            ret--;
+            if (getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &so_err, &so_len) < 0)
+                so_err = errno;
+            if (so_err == 0) {
+                sock = pfd[i].fd;
+                *which = tried[i];
+                pfd[i] = pfd[--npending];
+                tried[i] = tried[npending];
+                break;
+            }
+            last_err = so_err;
+            close(pfd[i].fd);
+            pfd[i] = pfd[--npending];
+            tried[i] = tried[npending];
+            i--;
         }
+    }
+
+    /* the losers */
+    for (i = 0; i < npending; i++)
+        close(pfd[i].fd);
+
+    if (sock < 0) {
+        *err = last_err ? strerror(last_err) : "socket failure";
+        return -1;
+    }
+    if (socktype == SOCK_STREAM)
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    return sock;
+}
+
+#endif /* AF_INET6 */
+
+/* resolve hostname and connect a socket to it, handing back the socket,
+   its type and the address it's connected to */
+static
+int
+open_receiver(int proto, const char* hostname, int port, int* sock, int* sock_type,
+              struct sockaddr_storage* peer_addr, socklen_t* peer_len, const char** err)
+{
+    struct sockaddr_storage address; /* outlives the branch that fills it in */
+    const struct sockaddr* p_address = (const struct sockaddr*) &address;
+    int address_len;
+
+    /* set up a socket, letting kernel assign local port */
+    if (proto == LOG_UDP || proto == LOG_TCP) {
+
+#ifdef AF_INET6
+
+        struct LSF_addr addrs[MAX_ADDRS];
+        int socktype = proto == LOG_TCP ? SOCK_STREAM : SOCK_DGRAM;
+        int naddrs, which;
+
+        /* the cache answers without asking the resolver, unless this
+           receiver has never been resolved */
+        if (dns.ttl > 0)
+            naddrs = dns_lookup(hostname, port, socktype, addrs, err);
+        else
+            naddrs = resolve_addrs(hostname, port, socktype, addrs, err);
+        if (naddrs < 0)
+            return -1;
+
+        *sock = connect_addrs(socktype, addrs, naddrs, &which, err);
+        if (*sock < 0)
+            return -1;
+        *sock_type = socktype;
+
+        /* reconnects go straight to the address that answered */
+        memcpy(peer_addr, &addrs[which].addr, addrs[which].len);
+        *peer_len = addrs[which].len;
+        return 0;
 
 #else /* !AF_INET6 */
 
         /* resolve the remote host */
         struct hostent* host = gethostbyname(hostname);
         if (!host || !host->h_addr_list || !host->h_addr_list[0]) {
-            logger->err = "resolve failure";
+            *err = "resolve failure";
             return -1;
         }
 
         /* create the remote host's address */
-        struct sockaddr_in raddress;
-        raddress.sin_family = AF_INET;
-        memcpy(&raddress.sin_addr, host->h_addr_list[0], sizeof(raddress.sin_addr));
-        raddress.sin_port = htons(port);
-        p_address = (const struct sockaddr*) &raddress;
-        address_len = sizeof(raddress);
+        struct sockaddr_in* raddress = (struct sockaddr_in*) &address;
+        memset(raddress, 0, sizeof(*raddress));
+        raddress->sin_family = AF_INET;
+        memcpy(&raddress->sin_addr, host->h_addr_list[0], sizeof(raddress->sin_addr));
+        raddress->sin_port = htons(port);
+        address_len = sizeof(*raddress);
 
         /* construct socket */
         if (proto == LOG_UDP) {
-            logger->sock = socket(AF_INET, SOCK_DGRAM, 0);
+            *sock = socket(AF_INET, SOCK_DGRAM, 0);
+            *sock_type = SOCK_DGRAM;
 
             /* make the socket non-blocking */
-            int flags = fcntl(logger->sock, F_GETFL, 0);
-            fcntl(logger->sock, F_SETFL, flags | O_NONBLOCK);
-            flags = fcntl(logger->sock, F_GETFL, 0);
+            int flags = fcntl(*sock, F_GETFL, 0);
+            fcntl(*sock, F_SETFL, flags | O_NONBLOCK);
+            flags = fcntl(*sock, F_GETFL, 0);
             if (!(flags & O_NONBLOCK)) {
-                logger->err = "nonblock failure";
+                *err = "nonblock failure";
                 return -1;
             }
         }
         else if (proto == LOG_TCP) {
-            logger->sock = socket(AF_INET, SOCK_STREAM, 0);
+            *sock = socket(AF_INET, SOCK_STREAM, 0);
+            *sock_type = SOCK_STREAM;
         }
 
 #endif /* AF_INET6 */
@@ -341,139 +1715,5212 @@ LSF_set_receiver(LogSyslogFast* logger, int proto, const char* hostname, int por
     else if (proto == LOG_UNIX) {
 
         /* create the log device's address */
-        struct sockaddr_un raddress;
-        raddress.sun_family = AF_UNIX;
-        strncpy(raddress.sun_path, hostname, sizeof(raddress.sun_path) - 1);
-        p_address = (const struct sockaddr*) &raddress;
-        address_len = sizeof(raddress);
+        struct sockaddr_un* raddress = (struct sockaddr_un*) &address;
+        memset(raddress, 0, sizeof(*raddress));
+        raddress->sun_family = AF_UNIX;
+        strncpy(raddress->sun_path, hostname, sizeof(raddress->sun_path) - 1);
+        address_len = sizeof(*raddress);
 
         /* construct socket */
-        logger->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        *sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        *sock_type = SOCK_STREAM;
     }
     else {
-        logger->err = "bad protocol";
+        *err = "bad protocol";
         return -1;
     }
 
-    if (logger->sock < 0) {
-        logger->err = strerror(errno);
-        clean_return(-1);
+    if (*sock < 0) {
+        *err = strerror(errno);
+        return -1;
     }
 
     /* close the socket after exec to match normal Perl behavior for sockets */
-    fcntl(logger->sock, F_SETFD, FD_CLOEXEC);
+    fcntl(*sock, F_SETFD, FD_CLOEXEC);
 
     /* connect the socket */
-    if (connect(logger->sock, p_address, address_len) != 0) {
+    if (connect(*sock, p_address, address_len) != 0) {
         /* some servers (rsyslog) may use SOCK_DGRAM for unix domain sockets */
         if (proto == LOG_UNIX && errno == EPROTOTYPE) {
             /* clean up existing bad socket */
-            close(logger->sock);
-            if (logger->sock < 0) {
-                logger->err = strerror(errno);
-                clean_return(-1);
+            close(*sock);
+            if (*sock < 0) {
+                *err = strerror(errno);
+                return -1;
             }
 
-            logger->sock = socket(AF_UNIX, SOCK_DGRAM, 0);
-            if (connect(logger->sock, p_address, address_len) != 0) {
-                logger->err = strerror(errno);
-                clean_return(-1);
+            *sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+            *sock_type = SOCK_DGRAM;
+            if (connect(*sock, p_address, address_len) != 0) {
+                *err = strerror(errno);
+                return -1;
             }
         }
         else {
-            logger->err = strerror(errno);
-            clean_return(-1);
+            *err = strerror(errno);
+            return -1;
         }
     }
 
-    clean_return(0);
+    /* reconnects go straight to the address, without another lookup */
+    memcpy(peer_addr, p_address, address_len);
+    *peer_len = address_len;
+
+    return 0;
+}
+
+#ifdef LSF_HAVE_OPENSSL
+
+/* the most specific thing OpenSSL can say about what just failed */
+static
+const char*
+tls_error(const char* fallback)
+{
+    unsigned long e = ERR_peek_last_error();
+    const char* reason = e ? ERR_reason_error_string(e) : NULL;
+
+    ERR_clear_error();
+    if (reason)
+        return reason;
+    return errno ? strerror(errno) : fallback;
 }
 
+/* keep the session a server hands out, at the end of the handshake in
+   TLS 1.2 or in a ticket after it in TLS 1.3 */
+static
 int
-LSF_send(LogSyslogFast* logger, const char* msg_str, int msg_len, time_t t)
+tls_new_session(SSL* ssl, SSL_SESSION* session)
 {
-    /* update the prefix if seconds have rolled over */
-    if (t != logger->last_time)
-        update_prefix(logger, t);
+    struct LSF_tls* t = SSL_get_app_data(ssl);
 
-    int line_len = logger->prefix_len + msg_len;
-    /* ensure there's space in the buffer for total length including a trailing NULL */
-    if (logger->bufsize < line_len + 1) {
-        /* try to increase buffer */
-        int new_bufsize = 2 * logger->bufsize;
-        while (new_bufsize < line_len + 1)
-            new_bufsize *= 2;
-        if (new_bufsize < 0) {
-            /* overflow */
-            logger->err = "message too large";
-            return -1;
-        }
+    if (t->session)
+        SSL_SESSION_free(t->session);
+    t->session = session;
+    return 1;
+}
 
-        char* new_buf = realloc(logger->linebuf, new_bufsize);
-        if (!new_buf) {
-            logger->err = strerror(errno);
-            return -1;
-        }
+static
+SSL_CTX*
+tls_new_ctx(const char* ca_file, const char* cert_file, const char* key_file, int ktls,
+            const char** err)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
 
-        logger->linebuf = new_buf;
-        logger->bufsize = new_bufsize;
-        logger->msg_start = logger->linebuf + logger->prefix_len;
+    if (!ctx) {
+        *err = tls_error("can't make a TLS context");
+        return NULL;
     }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, tls_new_session);
+#ifdef SSL_OP_ENABLE_KTLS
+    if (ktls)
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
 
-    /* paste the message into linebuf just past where the prefix was placed */
-    memcpy(logger->msg_start, msg_str, msg_len + 1); /* include perl-added null */
-
-    int ret = send(logger->sock, logger->linebuf, line_len, 0);
+    if (ca_file ? !SSL_CTX_load_verify_locations(ctx, ca_file, NULL)
+                : !SSL_CTX_set_default_verify_paths(ctx))
+        goto fail;
+    if (cert_file && !SSL_CTX_use_certificate_chain_file(ctx, cert_file))
+        goto fail;
+    if (key_file && !SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM))
+        goto fail;
+    return ctx;
 
-    if (ret < 0)
-        logger->err = strerror(errno);
-    return ret;
+fail:
+    *err = tls_error("can't load TLS certificates");
+    SSL_CTX_free(ctx);
+    return NULL;
 }
 
 int
-LSF_get_priority(LogSyslogFast* logger)
+LSF_set_tls(const char* ca_file, const char* cert_file, const char* key_file, int ktls,
+            const char** err)
 {
-    return logger->priority;
-}
+    SSL_CTX* ctx = tls_new_ctx(ca_file, cert_file, key_file, ktls, err);
+    SSL_CTX* old;
 
-int
-LSF_get_facility(LogSyslogFast* logger)
-{
-    return logger->priority >> 3;
-}
+    if (!ctx)
+        return -1;
 
-int
-LSF_get_severity(LogSyslogFast* logger)
-{
-    return logger->priority & 7;
+    /* loggers already connected hold their own reference to the old one */
+    pthread_mutex_lock(&tls_conf.lock);
+    old = tls_conf.ctx;
+    tls_conf.ctx = ctx;
+    pthread_mutex_unlock(&tls_conf.lock);
+    if (old)
+        SSL_CTX_free(old);
+    return 0;
 }
 
-const char*
-LSF_get_sender(LogSyslogFast* logger)
+/* a reference to the process's current settings, made from the defaults
+   if LSF_set_tls was never called */
+static
+SSL_CTX*
+tls_context(const char** err)
 {
-    return logger->sender;
+    SSL_CTX* ctx;
+
+    pthread_mutex_lock(&tls_conf.lock);
+    if (!tls_conf.ctx)
+        tls_conf.ctx = tls_new_ctx(NULL, NULL, NULL, 0, err);
+    ctx = tls_conf.ctx;
+    if (ctx)
+        SSL_CTX_up_ref(ctx);
+    pthread_mutex_unlock(&tls_conf.lock);
+    return ctx;
 }
 
-const char*
-LSF_get_name(LogSyslogFast* logger)
+/* SSL writes with write(2), which has no MSG_NOSIGNAL, so a logger that
+   asked for it gets SIGPIPE blocked around them instead and any it
+   raised discarded */
+static
+void
+tls_hold_sigpipe(int flags, sigset_t* old)
 {
-    return logger->name;
+    sigset_t pipe;
+
+    if (!(flags & MSG_NOSIGNAL))
+        return;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, old);
 }
 
-int
-LSF_get_pid(LogSyslogFast* logger)
+static
+void
+tls_release_sigpipe(int flags, sigset_t* old)
 {
-    return logger->pid;
+    sigset_t pending;
+
+    if (!(flags & MSG_NOSIGNAL))
+        return;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGPIPE) && !sigismember(old, SIGPIPE)) {
+        struct timespec zero = { 0, 0 };
+        sigset_t pipe;
+        int saved = errno;
+
+        sigemptyset(&pipe);
+        sigaddset(&pipe, SIGPIPE);
+        sigtimedwait(&pipe, NULL, &zero);
+        errno = saved;
+    }
+    pthread_sigmask(SIG_SETMASK, old, NULL);
 }
 
+/* start or carry on the handshake over sock. Returns 1 once it's done, 0
+   if a non-blocking sock has to wait for the server, -1 on failure. */
+static
 int
-LSF_get_sock(LogSyslogFast* logger)
+tls_handshake(LogSyslogFast* logger, int sock)
 {
-    return logger->sock;
-}
+    struct LSF_tls* t = logger->tls;
+    struct in6_addr ip;
+    sigset_t old;
+    int ret;
+
+    if (!t->ssl) {
+        t->ssl = SSL_new(t->ctx);
+        if (!t->ssl || !SSL_set_fd(t->ssl, sock)) {
+            logger->err = tls_error("can't start TLS");
+            tls_drop(logger);
+            return -1;
+        }
+        SSL_set_app_data(t->ssl, t);
+
+        /* RFC 6066 keeps address literals out of SNI */
+        if (inet_pton(AF_INET, t->hostname, &ip) == 1 || inet_pton(AF_INET6, t->hostname, &ip) == 1) {
+            X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(t->ssl), t->hostname);
+        }
+        else {
+            SSL_set_tlsext_host_name(t->ssl, t->hostname);
+            SSL_set1_host(t->ssl, t->hostname);
+        }
+        if (t->session)
+            SSL_set_session(t->ssl, t->session);
+        t->ktls = 0;
+    }
+
+    tls_hold_sigpipe(logger->send_flags, &old);
+    errno = 0;
+    ret = SSL_connect(t->ssl);
+    tls_release_sigpipe(logger->send_flags, &old);
+
+    if (ret == 1) {
+        t->handshakes++;
+        if (SSL_session_reused(t->ssl))
+            t->resumptions++;
+        t->ktls = BIO_get_ktls_send(SSL_get_wbio(t->ssl));
+        t->ticket_polls = TLS_TICKET_POLLS;
+        return 1;
+    }
+
+    ret = SSL_get_error(t->ssl, ret);
+    if (ret == SSL_ERROR_WANT_READ || ret == SSL_ERROR_WANT_WRITE)
+        return 0;
+    logger->err = tls_error("TLS handshake failed");
+    tls_drop(logger);
+    return -1;
+}
+
+/* connect TLS over the freshly connected logger->sock. The session is
+   carried over only to the server it came from. */
+static
+int
+tls_open(LogSyslogFast* logger, const char* hostname, int port)
+{
+    struct LSF_tls* t = logger->tls;
+
+    if (t && (t->port != port || strcmp(t->hostname, hostname) != 0)) {
+        tls_free(logger);
+        t = NULL;
+    }
+    if (!t) {
+        t = calloc(1, sizeof(struct LSF_tls));
+        if (!t || !(t->hostname = strdup(hostname))) {
+            free(t);
+            logger->err = strerror(errno);
+            return -1;
+        }
+        t->port = port;
+        t->ctx = tls_context(&logger->err);
+        logger->tls = t;
+        if (!t->ctx) {
+            tls_free(logger);
+            return -1;
+        }
+    }
+
+    /* RFC 5425 section 4.3 */
+    logger->framing = LOG_FRAMING_OCTET;
+
+    tls_drop(logger);
+    if (tls_handshake(logger, logger->sock) < 0) {
+        close(logger->sock);
+        logger->sock = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/* in TLS 1.3 the server sends its session ticket after the handshake.
+   Nothing is ever read from a syslog stream otherwise, so peek whether
+   there's a record waiting and let OpenSSL take it in without blocking */
+static
+void
+tls_read_tickets(LogSyslogFast* logger)
+{
+    struct LSF_tls* t = logger->tls;
+    struct pollfd pfd;
+    char buf[256];
+    int flags;
+
+    if (t->session || !t->ssl || !SSL_is_init_finished(t->ssl))
+        return;
+
+    pfd.fd = logger->sock;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 0) <= 0)
+        return;
+
+    flags = fcntl(logger->sock, F_GETFL, 0);
+    fcntl(logger->sock, F_SETFL, flags | O_NONBLOCK);
+    while (SSL_read(t->ssl, buf, sizeof(buf)) > 0)
+        ;
+    ERR_clear_error();
+    fcntl(logger->sock, F_SETFL, flags);
+}
+
+/* look for a ticket on the first few sends after a handshake */
+static
+void
+tls_check_tickets(LogSyslogFast* logger)
+{
+    struct LSF_tls* t = logger->tls;
+
+    if (!t->session && t->ticket_polls > 0) {
+        t->ticket_polls--;
+        tls_read_tickets(logger);
+    }
+}
+
+/* write all of iov through SSL, a record's worth at a time. Like
+   sendv_all, leaves iov showing what wasn't written if it fails, with
+   errno saying why. */
+static
+int
+tls_sendv(LogSyslogFast* logger, struct iovec* iov, int iovcnt, int flags)
+{
+    struct LSF_tls* t = logger->tls;
+    char record[TLS_RECORD_MAX];
+    sigset_t old;
+    int ret = 0;
+
+    if (!t->ssl) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    tls_check_tickets(logger);
+
+    tls_hold_sigpipe(flags, &old);
+    while (iovcnt > 0) {
+        struct iovec* v = iov;
+        int vcnt = iovcnt;
+        size_t len = 0;
+
+        /* gather lines into one record; a long line goes out on its own */
+        if (iov->iov_len >= TLS_RECORD_MAX) {
+            errno = 0;
+            ret = SSL_write(t->ssl, iov->iov_base, iov->iov_len > INT_MAX ? INT_MAX : iov->iov_len);
+            if (ret <= 0)
+                break;
+            iov->iov_base = (char*) iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+        else {
+            while (vcnt > 0 && len + v->iov_len <= TLS_RECORD_MAX) {
+                memcpy(record + len, v->iov_base, v->iov_len);
+                len += v->iov_len;
+                v++;
+                vcnt--;
+            }
+            errno = 0;
+            ret = SSL_write(t->ssl, record, len);
+            if (ret <= 0)
+                break;
+            while (iov != v) {
+                iov->iov_len = 0;
+                iov++;
+                iovcnt--;
+            }
+        }
+        while (iovcnt > 0 && iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+        }
+    }
+    tls_release_sigpipe(flags, &old);
+
+    if (ret <= 0) {
+        /* report a closed or broken session the way a stream reports a
+           lost connection, so reconnects kick in */
+        int e = SSL_get_error(t->ssl, ret);
+        ERR_clear_error();
+        if (e != SSL_ERROR_SYSCALL || !errno)
+            errno = e == SSL_ERROR_WANT_WRITE ? EAGAIN : ECONNRESET;
+        return -1;
+    }
+    return 0;
+}
+
+int
+LSF_get_tls(LogSyslogFast* logger, LSF_tls_info* info)
+{
+    struct LSF_tls* t = logger->tls;
+
+    if (!t)
+        return -1;
+    info->version = t->ssl ? SSL_get_version(t->ssl) : NULL;
+    info->cipher = t->ssl ? SSL_get_cipher_name(t->ssl) : NULL;
+    info->resumed = t->ssl ? SSL_session_reused(t->ssl) : 0;
+    info->ktls = t->ssl ? t->ktls : 0;
+    info->handshakes = t->handshakes;
+    info->resumptions = t->resumptions;
+    return 0;
+}
+
+/* has a handshake been started (or finished) on the current socket? */
+static
+int
+tls_started(LogSyslogFast* logger)
+{
+    return logger->tls && logger->tls->ssl;
+}
+
+/* does the kernel encrypt what's written to the socket? */
+static
+int
+tls_offloaded(LogSyslogFast* logger)
+{
+    return logger->tls->ssl && logger->tls->ktls;
+}
+
+/* let go of the connection's TLS state, leaving the socket alone */
+static
+void
+tls_drop(LogSyslogFast* logger)
+{
+    if (!logger->tls || !logger->tls->ssl)
+        return;
+    SSL_free(logger->tls->ssl);
+    logger->tls->ssl = NULL;
+    logger->tls->ktls = 0;
+}
+
+static
+void
+tls_free(LogSyslogFast* logger)
+{
+    struct LSF_tls* t = logger->tls;
+
+    if (!t)
+        return;
+    tls_drop(logger);
+    if (t->session)
+        SSL_SESSION_free(t->session);
+    if (t->ctx)
+        SSL_CTX_free(t->ctx);
+    free(t->hostname);
+    free(t);
+    logger->tls = NULL;
+}
+
+/* tell the server the stream is ending on purpose (close_notify), if that
+   can be done without waiting */
+static
+void
+tls_close(LogSyslogFast* logger)
+{
+    sigset_t old;
+
+    if (!logger->tls || !logger->tls->ssl || logger->sock < 0)
+        return;
+    /* a ticket that came in since the last send is still good for the
+       next connect */
+    tls_read_tickets(logger);
+    if (!logger->tls->ktls)
+        fcntl(logger->sock, F_SETFL, fcntl(logger->sock, F_GETFL, 0) | O_NONBLOCK);
+    tls_hold_sigpipe(MSG_NOSIGNAL, &old);
+    SSL_shutdown(logger->tls->ssl);
+    tls_release_sigpipe(MSG_NOSIGNAL, &old);
+    ERR_clear_error();
+}
+
+#else /* !LSF_HAVE_OPENSSL */
+
+/* built without OpenSSL: LOG_TLS receivers can't be set, so a logger
+   never has TLS state and the rest are never reached */
+int
+LSF_set_tls(const char* ca_file, const char* cert_file, const char* key_file, int ktls,
+            const char** err)
+{
+    *err = "built without TLS support";
+    return -1;
+}
+
+static
+int
+tls_open(LogSyslogFast* logger, const char* hostname, int port)
+{
+    close(logger->sock);
+    logger->sock = -1;
+    logger->err = "built without TLS support";
+    return -1;
+}
+
+static int tls_handshake(LogSyslogFast* logger, int sock) { return -1; }
+static void tls_read_tickets(LogSyslogFast* logger) { }
+static void tls_check_tickets(LogSyslogFast* logger) { }
+static int tls_started(LogSyslogFast* logger) { return 0; }
+static int tls_offloaded(LogSyslogFast* logger) { return 0; }
+static int tls_sendv(LogSyslogFast* logger, struct iovec* iov, int iovcnt, int flags) { return -1; }
+static void tls_drop(LogSyslogFast* logger) { }
+static void tls_free(LogSyslogFast* logger) { }
+static void tls_close(LogSyslogFast* logger) { }
+
+int
+LSF_get_tls(LogSyslogFast* logger, LSF_tls_info* info)
+{
+    return -1;
+}
+
+#endif /* LSF_HAVE_OPENSSL */
+
+static
+int
+connect_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port)
+{
+    int transport = proto == LOG_TLS ? LOG_TCP : proto;
+
+    if (logger->sock >= 0) {
+        int ret;
+        tls_close(logger);
+        tls_drop(logger);
+        ret = close(logger->sock);
+        if (ret) {
+            logger->err = strerror(errno);
+            return -1;
+        }
+    }
+    if (proto != LOG_TLS)
+        tls_free(logger);
+
+    dns_release(logger);
+    if (open_receiver(transport, hostname, port, &logger->sock, &logger->sock_type,
+                      &logger->peer_addr, &logger->peer_len, &logger->err) < 0)
+        return -1;
+    dns_hold(logger, transport, hostname, port);
+    gso_refresh(logger);
+    if (proto == LOG_TLS)
+        return tls_open(logger, hostname, port);
+    return 0;
+}
+
+/* write all of iov to the logger's stream, resuming after partial writes */
+static
+int
+sendv_all(LogSyslogFast* logger, struct iovec* iov, int iovcnt, int flags)
+{
+    struct msghdr msg;
+
+    if (logger->tls) {
+        if (!tls_offloaded(logger))
+            return tls_sendv(logger, iov, iovcnt, flags);
+        tls_check_tickets(logger);
+    }
+
+    while (iovcnt > 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t ret = sendmsg(logger->sock, &msg, flags);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        /* skip past the fully-written iovecs and trim the partial one;
+           both are left showing only what's unsent, in case of failure */
+        while (iovcnt > 0 && (size_t) ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov->iov_len = 0;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*) iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+static
+double
+monotonic_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* monotonic_now to within a clock tick, cheap enough for every send */
+static
+double
+monotonic_coarse()
+{
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* framing only means something on stream sockets, which a pool never uses */
+static
+int
+is_framed(LogSyslogFast* logger)
+{
+    return logger->framing != LOG_FRAMING_NONE && logger->sock_type == SOCK_STREAM
+        && !logger->pool;
+}
+
+/* RFC6587 3.4.1: MSG-LEN SP SYSLOG-MSG. The length is already known, so
+   the digits are rendered right to left into the end of hdr without a
+   pass over the message */
+static
+void
+octet_header(char* hdr, unsigned int len, struct iovec* iov)
+{
+    char* p = hdr + FRAME_HDR_MAX;
+    *--p = ' ';
+    do {
+        *--p = '0' + len % 10;
+        len /= 10;
+    } while (len);
+    iov->iov_base = p;
+    iov->iov_len = hdr + FRAME_HDR_MAX - p;
+}
+
+/* describe one record as it goes on the wire: framing header, PRI, rest
+   of the cached prefix, caller's message and framing trailer, skipping
+   unused parts. A priority other than the logger's own is swapped in from
+   the precomputed PRI table. hdr must have room for FRAME_HDR_MAX bytes. */
+static
+int
+framed_line_iov(LogSyslogFast* logger, int framing, char* hdr, const char* msg_str, int msg_len,
+                int priority, struct iovec* iov)
+{
+    int own_pri = priority == logger->priority;
+    int n = 0;
+
+    if (framing == LOG_FRAMING_OCTET) {
+        unsigned int len = logger->prefix_len + msg_len;
+        if (!own_pri)
+            len += pri_len[priority] - logger->pri_len;
+        octet_header(hdr, len, &iov[n++]);
+    }
+
+    if (own_pri) {
+        iov[n].iov_base = logger->linebuf;
+        iov[n++].iov_len = logger->prefix_len;
+    }
+    else {
+        iov[n].iov_base = pri_str[priority];
+        iov[n++].iov_len = pri_len[priority];
+        iov[n].iov_base = logger->linebuf + logger->pri_len;
+        iov[n++].iov_len = logger->prefix_len - logger->pri_len;
+    }
+    iov[n].iov_base = (void*) msg_str;
+    iov[n++].iov_len = msg_len;
+
+    if (framing == LOG_FRAMING_LF) {
+        /* RFC6587 3.4.2: non-transparent framing with an LF trailer */
+        iov[n].iov_base = (void*) "\n";
+        iov[n++].iov_len = 1;
+    }
+
+    return n;
+}
+
+static
+int
+line_iov(LogSyslogFast* logger, char* hdr, const char* msg_str, int msg_len, int priority, struct iovec* iov)
+{
+    int framing = is_framed(logger) ? logger->framing : LOG_FRAMING_NONE;
+    return framed_line_iov(logger, framing, hdr, msg_str, msg_len, priority, iov);
+}
+
+int
+LSF_set_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port)
+{
+    if (proto == LOG_TLS && logger->wbuf) {
+        logger->err = "non-blocking mode can't be combined with TLS";
+        return -1;
+    }
+    if (proto == LOG_TLS && logger->uring) {
+        logger->err = "io_uring can't be combined with TLS";
+        return -1;
+    }
+
+    /* a child's inherited timer is restarted when it first sends */
+    if (logger->coalesce && logger->coalesce->running && logger->fork_gen == fork_generation) {
+        /* the timer writes to the current socket, so park it meanwhile */
+        int ret;
+        coalesce_stop_timer(logger);
+        ret = LSF_set_receiver(logger, proto, hostname, port);
+        if (coalesce_start_timer(logger) < 0)
+            return -1;
+        return ret;
+    }
+
+    /* queued lines go to the receiver they were sent to; any still stuck
+       on a stalled stream are failed by shutting it down */
+    if (is_coalescing(logger))
+        coalesce_write(logger, logger->send_flags | MSG_NOSIGNAL);
+    if (logger->uring && !uring_drain(logger, URING_DRAIN_TIMEOUT) && logger->sock >= 0)
+        shutdown(logger->sock, SHUT_RDWR);
+
+    if (logger->async) {
+        /* the worker sends on the current socket, so park it while the
+           socket is replaced and then start it back up */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        async_stop(logger, 1);
+
+        if (connect_receiver(logger, proto, hostname, port) < 0)
+            return -1;
+        return LSF_set_async(logger, queue_size, drain_timeout);
+    }
+
+    if (logger->reconnect) {
+        /* a pending reconnect is abandoned for the new receiver */
+        logger->reconnect->down = 0;
+        logger->reconnect->connecting = 0;
+        logger->reconnect->delay = logger->reconnect->min_delay;
+    }
+
+    if (logger->wbuf) {
+        /* buffered lines carry over to the new receiver */
+        wbuf_drop_partial(logger);
+        if (connect_receiver(logger, proto, hostname, port) < 0)
+            return -1;
+        return wbuf_attach(logger);
+    }
+
+    return connect_receiver(logger, proto, hostname, port);
+}
+
+/* is the logger writing through a userspace buffer? */
+static
+int
+is_nonblocking(LogSyslogFast* logger)
+{
+    return logger->wbuf && logger->sock_type == SOCK_STREAM;
+}
+
+/* bytes of the first record still to be written, and where they start */
+static
+size_t
+wbuf_first(struct LSF_wbuf* w, char** data)
+{
+    uint32_t len;
+    memcpy(&len, w->buf + w->start, WBUF_HDR_LEN);
+    *data = w->buf + w->start + WBUF_HDR_LEN + w->sent;
+    return len - w->sent;
+}
+
+/* write as much of the buffer as the socket takes without blocking.
+   Returns -1 on a socket error, otherwise 0 even if lines remain. */
+static
+int
+wbuf_flush(LogSyslogFast* logger)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+
+    while (w->start < w->end) {
+        struct iovec iov[WBUF_IOV_MAX];
+        struct msghdr msg;
+        size_t pos = w->start;
+        size_t skip = w->sent;
+        ssize_t ret;
+        int n = 0;
+
+        while (pos < w->end && n < WBUF_IOV_MAX) {
+            uint32_t len;
+            memcpy(&len, w->buf + pos, WBUF_HDR_LEN);
+            iov[n].iov_base = w->buf + pos + WBUF_HDR_LEN + skip;
+            iov[n++].iov_len = len - skip;
+            pos += WBUF_HDR_LEN + len;
+            skip = 0;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ret = sendmsg(logger->sock, &msg, logger->send_flags);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            logger->err = strerror(errno);
+            return -1;
+        }
+
+        /* retire the records that went out in full */
+        while (ret > 0) {
+            char* data;
+            size_t left = wbuf_first(w, &data);
+            if ((size_t) ret < left) {
+                w->sent += ret;
+                break;
+            }
+            ret -= left;
+            w->start = data + left - w->buf;
+            w->sent = 0;
+        }
+    }
+
+    w->start = w->end = 0;
+    return 0;
+}
+
+/* is there room to append a record of need bytes, header included? */
+static
+int
+wbuf_fits(struct LSF_wbuf* w, size_t need)
+{
+    return need <= w->size - (w->end - w->start);
+}
+
+/* discard whole records from the front, sparing one that is partly
+   written, until need bytes would fit */
+static
+void
+wbuf_drop_oldest(LogSyslogFast* logger, size_t need)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+    size_t keep = w->start;
+    size_t pos;
+
+    if (w->sent) {
+        uint32_t len;
+        memcpy(&len, w->buf + keep, WBUF_HDR_LEN);
+        keep += WBUF_HDR_LEN + len;
+    }
+
+    for (pos = keep; pos < w->end && need > w->size - (w->end - w->start) + (pos - keep); ) {
+        struct iovec iov;
+        uint32_t len;
+        memcpy(&len, w->buf + pos, WBUF_HDR_LEN);
+        iov.iov_base = w->buf + pos + WBUF_HDR_LEN;
+        iov.iov_len = len;
+        if (!spill_append(logger, &iov, 1))
+            count_dropped(logger, 1);
+        pos += WBUF_HDR_LEN + len;
+    }
+
+    memmove(w->buf + keep, w->buf + pos, w->end - pos);
+    w->end -= pos - keep;
+}
+
+/* wait for the socket to drain the buffer enough to fit need bytes; gives
+   up once deadline (on the monotonic clock) has passed */
+static
+int
+wbuf_wait(LogSyslogFast* logger, size_t need, double deadline)
+{
+    for (;;) {
+        struct pollfd pfd;
+        double left;
+
+        if (wbuf_flush(logger) < 0)
+            return -1;
+        if (wbuf_fits(logger->wbuf, need))
+            return 0;
+
+        left = deadline - monotonic_now();
+        if (left <= 0)
+            return 0;
+
+        pfd.fd = logger->sock;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, (int) (left * 1000) + 1);
+    }
+}
+
+/* send one record on a non-blocking stream, first writing out whatever
+   is buffered. If the socket won't take all of it, the rest is buffered.
+   Returns the line length if it was sent or buffered, 0 if the overflow
+   policy dropped it, and -1 on error. */
+static
+int
+wbuf_send(LogSyslogFast* logger, struct iovec* iov, int iovcnt)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+    uint32_t line_len = 0;
+    size_t need;
+    ssize_t ret = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+        line_len += iov[i].iov_len;
+    need = WBUF_HDR_LEN + line_len;
+
+    if (w->start < w->end && wbuf_flush(logger) < 0)
+        return -1;
+
+    if (!wbuf_fits(w, need)) {
+        switch (w->policy) {
+        case LOG_OVERFLOW_DROP_OLDEST:
+            wbuf_drop_oldest(logger, need);
+            break;
+        case LOG_OVERFLOW_BLOCK:
+            if (need <= w->size
+                && wbuf_wait(logger, need, monotonic_now() + w->deadline) < 0)
+                return -1;
+            break;
+        case LOG_OVERFLOW_ERROR:
+            logger->err = "write buffer full";
+            return -1;
+        }
+        if (!wbuf_fits(w, need)) {
+            if (spill_append(logger, iov, iovcnt))
+                return line_len;
+            count_dropped(logger, 1);
+            return 0;
+        }
+    }
+
+    if (w->start == w->end) {
+        /* nothing queued ahead of it, so try the socket directly */
+        struct msghdr msg;
+
+        w->start = w->end = 0;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        do {
+            ret = sendmsg(logger->sock, &msg, logger->send_flags);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret == (ssize_t) line_len)
+            return line_len;
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logger->err = strerror(errno);
+                return -1;
+            }
+            ret = 0;
+        }
+    }
+
+    if (w->size - w->end < need) {
+        memmove(w->buf, w->buf + w->start, w->end - w->start);
+        w->end -= w->start;
+        w->start = 0;
+    }
+
+    /* queue the whole line; any part the socket already took is marked
+       as sent so the line is never dropped halfway */
+    memcpy(w->buf + w->end, &line_len, WBUF_HDR_LEN);
+    w->end += WBUF_HDR_LEN;
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(w->buf + w->end, iov[i].iov_base, iov[i].iov_len);
+        w->end += iov[i].iov_len;
+    }
+    if (ret > 0)
+        w->sent = ret;
+
+    return line_len;
+}
+
+/* a line cut off partway would garble a new connection's stream */
+static
+void
+wbuf_drop_partial(LogSyslogFast* logger)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+    uint32_t len;
+
+    if (!w || !w->sent)
+        return;
+    memcpy(&len, w->buf + w->start, WBUF_HDR_LEN);
+    w->start += WBUF_HDR_LEN + len;
+    w->sent = 0;
+    count_dropped(logger, 1);
+}
+
+/* put a freshly connected socket into the mode the write buffer needs */
+static
+int
+wbuf_attach(LogSyslogFast* logger)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+    int flags;
+
+    if (logger->sock_type != SOCK_STREAM) {
+        /* datagram sockets are written directly; nothing carries over */
+        w->start = w->end = w->sent = 0;
+        return 0;
+    }
+
+    flags = fcntl(logger->sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(logger->sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    return 0;
+}
+
+/* leave non-blocking mode, first giving the buffer up to the deadline
+   to drain */
+static
+void
+wbuf_free(LogSyslogFast* logger)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+
+    if (w->start < w->end)
+        LSF_flush(logger, w->deadline);
+
+    if (logger->sock_type == SOCK_STREAM && logger->sock >= 0) {
+        int flags = fcntl(logger->sock, F_GETFL, 0);
+        if (flags >= 0)
+            fcntl(logger->sock, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
+    free(w->buf);
+    free(w);
+    logger->wbuf = NULL;
+}
+
+int
+LSF_set_nonblock(LogSyslogFast* logger, int buffer_size, int policy, double deadline)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+
+    if (policy < LOG_OVERFLOW_DROP_NEWEST || policy > LOG_OVERFLOW_ERROR) {
+        logger->err = "invalid overflow policy";
+        return -1;
+    }
+    if (buffer_size > 0 && logger->async) {
+        logger->err = "non-blocking mode can't be combined with async mode";
+        return -1;
+    }
+    if (buffer_size > 0 && logger->pool) {
+        logger->err = "non-blocking mode can't be combined with a pool";
+        return -1;
+    }
+    if (buffer_size > 0 && logger->tls) {
+        logger->err = "non-blocking mode can't be combined with TLS";
+        return -1;
+    }
+    if (buffer_size > 0 && logger->uring) {
+        logger->err = "non-blocking mode can't be combined with io_uring";
+        return -1;
+    }
+    if (logger->coalesce) {
+        logger->err = "non-blocking mode can't be combined with coalescing";
+        return -1;
+    }
+
+    if (buffer_size <= 0) {
+        if (w)
+            wbuf_free(logger);
+        return 0;
+    }
+
+    if (!w) {
+        w = calloc(1, sizeof(struct LSF_wbuf));
+        if (!w) {
+            logger->err = strerror(errno);
+            return -1;
+        }
+    }
+    else if (w->end - w->start > (size_t) buffer_size) {
+        logger->err = "buffered lines don't fit in the new size";
+        return -1;
+    }
+    else {
+        memmove(w->buf, w->buf + w->start, w->end - w->start);
+        w->end -= w->start;
+        w->start = 0;
+    }
+
+    char* buf = realloc(w->buf, buffer_size);
+    if (!buf) {
+        logger->err = strerror(errno);
+        if (!logger->wbuf)
+            free(w);
+        return -1;
+    }
+    w->buf = buf;
+    w->size = buffer_size;
+    w->policy = policy;
+    w->deadline = deadline;
+
+    if (!logger->wbuf) {
+        logger->wbuf = w;
+        if (wbuf_attach(logger) < 0) {
+            free(w->buf);
+            free(w);
+            logger->wbuf = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef LSF_HAVE_IO_URING
+
+static
+int
+uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags,
+            const void* arg, size_t arg_size)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+/* put a SEND of len bytes at off in the slab on the SQ; it isn't seen by
+   the kernel until uring_submit */
+static
+void
+uring_push(struct LSF_uring* u, int fd, size_t off, unsigned int len, int msg_flags,
+           uint64_t user_data)
+{
+    unsigned int tail = *u->sq_tail;
+    unsigned int idx = tail & *u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) (u->slab + off);
+    sqe->len = len;
+    sqe->msg_flags = msg_flags;
+    sqe->user_data = user_data;
+#ifdef IORING_RECVSEND_FIXED_BUF
+    if (u->fixed) {
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = 0;
+    }
+#endif
+    u->sq_array[idx] = idx;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* hand the kernel what's been pushed. A polling thread finds it on its
+   own and only needs waking if it went to sleep; otherwise it takes a
+   syscall, which covers every line queued since the last one. SQEs the
+   kernel doesn't take now stay queued for the next call. */
+static
+void
+uring_submit(struct LSF_uring* u)
+{
+    unsigned int pending;
+
+    if (u->sqpoll) {
+        /* the tail store must be visible before the sleep flag is read */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(u->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+            uring_enter(u->fd, 0, 0, IORING_ENTER_SQ_WAKEUP, NULL, 0);
+        return;
+    }
+
+    pending = *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    while (pending && uring_enter(u->fd, pending, 0, 0, NULL, 0) < 0 && errno == EINTR)
+        ;
+}
+
+/* submit anything pending and wait until a completion arrives or wait_ms
+   runs out. The wait is done in io_uring_enter, where the kernel also
+   retries sends that were waiting for socket space; poll on the ring
+   would leave those to whenever the process next entered it. */
+static
+void
+uring_wait(struct LSF_uring* u, int wait_ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    struct pollfd pfd;
+
+    uring_submit(u);
+    if (__atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) != *u->cq_head)
+        return;
+
+    if (wait_ms < 0) {
+        uring_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        return;
+    }
+    if (u->ext_arg) {
+        memset(&arg, 0, sizeof(arg));
+        ts.tv_sec = wait_ms / 1000;
+        ts.tv_nsec = (wait_ms % 1000) * 1000000L;
+        arg.ts = (uintptr_t) &ts;
+#ifdef IORING_FEAT_EXT_ARG
+        uring_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+#endif
+        return;
+    }
+
+    /* before 5.11 there's no timeout on the wait; a short poll and the
+       caller's next try have to do */
+    pfd.fd = u->fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, wait_ms < 10 ? wait_ms : 10);
+    uring_enter(u->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+/* note the results of whatever has completed */
+static
+void
+uring_collect(struct LSF_uring* u)
+{
+    unsigned int head = *u->cq_head;
+    unsigned int tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &u->cqes[head & *u->cq_mask];
+        if (cqe->user_data == URING_PROBE) {
+            u->probe_res = cqe->res;
+            u->probe_done = 1;
+        }
+        else {
+            struct LSF_uring_op* op = &u->ops[cqe->user_data & (u->entries - 1)];
+            op->res = cqe->res;
+            op->done = 1;
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* put the oldest unsubmitted op on the SQ, if it may go now */
+static
+void
+uring_start(LogSyslogFast* logger)
+{
+    struct LSF_uring* u = logger->uring;
+    struct LSF_uring_op* op;
+
+    if (u->op_next == u->op_tail)
+        return;
+    if (logger->sock_type == SOCK_STREAM && u->op_next != u->op_head)
+        return;
+
+    op = &u->ops[u->op_next & (u->entries - 1)];
+    if (logger->sock_type == SOCK_STREAM)
+        uring_push(u, logger->sock, op->start & (u->slab_size - 1), op->end - op->start,
+                   MSG_NOSIGNAL | MSG_WAITALL, u->op_next);
+    else
+        uring_push(u, logger->sock, op->start & (u->slab_size - 1), op->end - op->start,
+                   MSG_NOSIGNAL, u->op_next);
+    u->op_next++;
+}
+
+/* count completed lines and free their slab space; ops retire in the order
+   they were queued, so the slab is freed from its start. A stream's next
+   op is started once the one before has retired. */
+static
+void
+uring_reap(LogSyslogFast* logger)
+{
+    struct LSF_uring* u = logger->uring;
+
+    uring_collect(u);
+    while (u->op_head != u->op_next) {
+        struct LSF_uring_op* op = &u->ops[u->op_head & (u->entries - 1)];
+        unsigned int i;
+
+        if (!op->done)
+            break;
+        if (op->res >= 0) {
+            count_sent(logger, op->lines, op->res);
+            if ((uint64_t) op->res < op->end - op->start)
+                logger->stats.truncated++;
+        }
+        else {
+            logger->err = strerror(-op->res);
+            for (i = 0; i < op->lines; i++)
+                count_failure(logger, -op->res);
+        }
+        u->lines -= op->lines;
+        u->slab_head = op->end + op->skip;
+        u->op_head++;
+    }
+    uring_start(logger);
+}
+
+/* format a line into the slab and queue it, waiting for completions if
+   the ring is full. Returns the line's length, or 0 if the caller should
+   send it directly; the ring is empty then, so nothing gets reordered. */
+static
+int
+uring_queue(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority)
+{
+    struct LSF_uring* u = logger->uring;
+    struct iovec iov[LINE_IOV_MAX];
+    char hdr[FRAME_HDR_MAX];
+    int iovcnt = line_iov(logger, hdr, msg_str, msg_len, priority, iov);
+    struct LSF_uring_op* op = NULL;
+    size_t len = 0, off, pad;
+    int i;
+
+    /* sends parked on a full unix datagram receiver aren't reliably woken
+       when it catches up, so those go out directly too */
+    if (logger->sock_type == SOCK_DGRAM && logger->peer_addr.ss_family == AF_UNIX) {
+        if (u->lines)
+            uring_drain(logger, -1);
+        return 0;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+    if (len > u->slab_size) {
+        uring_drain(logger, -1);
+        return 0;
+    }
+
+    uring_reap(logger);
+    for (;;) {
+        /* a line is never split at the end of the slab; it skips ahead to
+           the start, and the gap is freed along with the op before it */
+        off = u->slab_tail & (u->slab_size - 1);
+        pad = off + len > u->slab_size ? u->slab_size - off : 0;
+        if (pad && u->slab_head == u->slab_tail) {
+            u->slab_head = u->slab_tail += pad;
+            continue;
+        }
+
+        /* a stream line joins the op still waiting to go out, if any */
+        op = NULL;
+        if (logger->sock_type == SOCK_STREAM && !pad && u->op_next != u->op_tail)
+            op = &u->ops[(u->op_tail - 1) & (u->entries - 1)];
+
+        if ((op || u->op_tail - u->op_head < u->entries)
+            && u->slab_size - (u->slab_tail - u->slab_head) >= pad + len)
+            break;
+        uring_wait(u, -1);
+        uring_reap(logger);
+    }
+
+    if (pad) {
+        u->ops[(u->op_tail - 1) & (u->entries - 1)].skip = pad;
+        u->slab_tail += pad;
+    }
+    off = u->slab_tail & (u->slab_size - 1);
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(u->slab + off, iov[i].iov_base, iov[i].iov_len);
+        off += iov[i].iov_len;
+    }
+
+    if (!op) {
+        op = &u->ops[u->op_tail++ & (u->entries - 1)];
+        op->start = u->slab_tail;
+        op->skip = 0;
+        op->lines = 0;
+        op->done = 0;
+    }
+    u->slab_tail += len;
+    op->end = u->slab_tail;
+    op->lines++;
+    u->lines++;
+    uring_start(logger);
+    return len;
+}
+
+/* wait up to timeout (forever if negative) for every queued line to
+   complete; returns 1 if they all did */
+static
+int
+uring_drain(LogSyslogFast* logger, double timeout)
+{
+    struct LSF_uring* u = logger->uring;
+    double deadline = monotonic_now() + timeout;
+
+    uring_reap(logger);
+    while (u->op_head != u->op_tail) {
+        int wait_ms = -1;
+        if (timeout >= 0) {
+            double left = deadline - monotonic_now();
+            if (left <= 0)
+                return 0;
+            wait_ms = (int) (left * 1000) + 1;
+        }
+        uring_wait(u, wait_ms);
+        uring_reap(logger);
+    }
+    return 1;
+}
+
+/* unmap and close the ring without touching it; in a child the mappings
+   are still the parent's, and closing the ring in the parent cancels
+   whatever didn't complete */
+static
+void
+uring_free(LogSyslogFast* logger)
+{
+    struct LSF_uring* u = logger->uring;
+
+    if (u->fd >= 0)
+        close(u->fd);
+    if (u->sqes)
+        munmap(u->sqes, u->entries * sizeof(struct io_uring_sqe));
+    if (u->cq_ring && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_len);
+    if (u->sq_ring)
+        munmap(u->sq_ring, u->sq_ring_len);
+    if (u->slab)
+        munmap(u->slab, u->slab_size);
+    free(u->ops);
+    free(u);
+    logger->uring = NULL;
+}
+
+/* send a byte over a socketpair to find out whether this kernel can send
+   from registered buffers, or on sockets at all (5.6 and later) */
+static
+int
+uring_probe(struct LSF_uring* u)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) < 0)
+        return -1;
+    u->slab[0] = '\n';
+    for (;;) {
+        u->probe_done = 0;
+        uring_push(u, sv[0], 0, 1, MSG_NOSIGNAL | MSG_DONTWAIT, URING_PROBE);
+        while (!u->probe_done) {
+            uring_wait(u, -1);
+            uring_collect(u);
+        }
+        if (u->probe_res == 1 || !u->fixed)
+            break;
+        u->fixed = 0;
+        syscall(__NR_io_uring_register, u->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    }
+    close(sv[0]);
+    close(sv[1]);
+    if (u->probe_res != 1) {
+        errno = u->probe_res < 0 ? -u->probe_res : EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static
+int
+uring_create(LogSyslogFast* logger, unsigned int entries, int sqpoll)
+{
+    struct io_uring_params p;
+    struct LSF_uring* u;
+    struct iovec slab;
+    char* sq;
+    char* cq;
+
+    u = calloc(1, sizeof(struct LSF_uring));
+    if (!u) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    logger->uring = u;
+
+    memset(&p, 0, sizeof(p));
+    if (sqpoll) {
+        p.flags = IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = URING_SQPOLL_IDLE;
+    }
+    u->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0 && sqpoll) {
+        /* before 5.11 only privileged processes could have a polling thread */
+        memset(&p, 0, sizeof(p));
+        u->fd = syscall(__NR_io_uring_setup, entries, &p);
+    }
+    if (u->fd < 0)
+        goto fail;
+    fcntl(u->fd, F_SETFD, FD_CLOEXEC);
+    u->entries = p.sq_entries;
+    u->sqpoll = (p.flags & IORING_SETUP_SQPOLL) != 0;
+#ifdef IORING_FEAT_EXT_ARG
+    u->ext_arg = (p.features & IORING_FEAT_EXT_ARG) != 0;
+#endif
+
+    u->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    u->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_len > u->sq_ring_len)
+            u->sq_ring_len = u->cq_ring_len;
+        u->cq_ring_len = u->sq_ring_len;
+    }
+    sq = mmap(NULL, u->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              u->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        goto fail;
+    u->sq_ring = sq;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        cq = sq;
+    else {
+        cq = mmap(NULL, u->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  u->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            goto fail;
+    }
+    u->cq_ring = cq;
+    u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto fail;
+    }
+
+    u->sq_head = (unsigned int*) (sq + p.sq_off.head);
+    u->sq_tail = (unsigned int*) (sq + p.sq_off.tail);
+    u->sq_mask = (unsigned int*) (sq + p.sq_off.ring_mask);
+    u->sq_flags = (unsigned int*) (sq + p.sq_off.flags);
+    u->sq_array = (unsigned int*) (sq + p.sq_off.array);
+    u->cq_head = (unsigned int*) (cq + p.cq_off.head);
+    u->cq_tail = (unsigned int*) (cq + p.cq_off.tail);
+    u->cq_mask = (unsigned int*) (cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+
+    /* at most one op per SQ entry is in flight, so the CQ (twice the size)
+       can't overflow */
+    u->ops = calloc(u->entries, sizeof(struct LSF_uring_op));
+    if (!u->ops)
+        goto fail;
+    u->slab_size = (size_t) u->entries * URING_SLOT_SIZE;
+    u->slab = mmap(NULL, u->slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->slab == MAP_FAILED) {
+        u->slab = NULL;
+        goto fail;
+    }
+
+    /* registering pins the slab, which RLIMIT_MEMLOCK may not allow; plain
+       sends from it still work then */
+#ifdef IORING_RECVSEND_FIXED_BUF
+    slab.iov_base = u->slab;
+    slab.iov_len = u->slab_size;
+    u->fixed = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_BUFFERS, &slab, 1) == 0;
+#else
+    (void) slab;
+#endif
+    if (uring_probe(u) < 0)
+        goto fail;
+    return 0;
+
+fail:
+    logger->err = strerror(errno);
+    uring_free(logger);
+    return -1;
+}
+
+/* the ring and its polling thread belong to the parent; a child starts
+   one of its own */
+static
+void
+uring_after_fork(LogSyslogFast* logger)
+{
+    unsigned int entries = logger->uring->entries;
+    int sqpoll = logger->uring->sqpoll;
+
+    uring_free(logger);
+    uring_create(logger, entries, sqpoll);
+}
+
+int
+LSF_set_uring(LogSyslogFast* logger, int entries, int sqpoll)
+{
+    if (entries > 0 && (logger->async || logger->wbuf || logger->reconnect || logger->pool
+                        || logger->tls || logger->coalesce))
+    {
+        logger->err = "io_uring can't be combined with async or non-blocking mode, reconnects, a pool, TLS or coalescing";
+        return -1;
+    }
+
+    if (logger->uring) {
+        uring_drain(logger, URING_DRAIN_TIMEOUT);
+        uring_free(logger);
+    }
+    if (entries <= 0)
+        return 0;
+    return uring_create(logger, entries, sqpoll);
+}
+
+int
+LSF_get_uring(LogSyslogFast* logger, LSF_uring_info* info)
+{
+    struct LSF_uring* u = logger->uring;
+
+    if (!u)
+        return -1;
+    uring_reap(logger);
+    info->entries = u->entries;
+    info->sqpoll = u->sqpoll;
+    info->fixed = u->fixed;
+    info->in_flight = u->lines;
+    return 0;
+}
+
+#else
+
+int
+LSF_set_uring(LogSyslogFast* logger, int entries, int sqpoll)
+{
+    if (entries <= 0)
+        return 0;
+    logger->err = "built without io_uring support";
+    return -1;
+}
+
+int
+LSF_get_uring(LogSyslogFast* logger, LSF_uring_info* info)
+{
+    return -1;
+}
+
+static int uring_queue(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority) { return 0; }
+static void uring_submit(struct LSF_uring* u) { }
+static int uring_drain(LogSyslogFast* logger, double timeout) { return 1; }
+static void uring_free(LogSyslogFast* logger) { }
+static void uring_after_fork(LogSyslogFast* logger) { }
+
+#endif /* LSF_HAVE_IO_URING */
+
+static
+int
+write_line(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority, uint32_t route)
+{
+    if (logger->zerocopy || is_framed(logger) || priority != logger->priority
+        || is_nonblocking(logger) || logger->pool)
+    {
+        /* hand the kernel the cached prefix and the caller's buffer as-is */
+        struct iovec iov[LINE_IOV_MAX];
+        struct msghdr msg;
+        char hdr[FRAME_HDR_MAX];
+        int iovcnt = line_iov(logger, hdr, msg_str, msg_len, priority, iov);
+        int ret;
+
+        if (is_nonblocking(logger))
+            return wbuf_send(logger, iov, iovcnt);
+        if (logger->pool)
+            return pool_send(logger, route, iov, iovcnt, logger->send_flags);
+
+        int line_len = 0;
+        int i;
+        for (i = 0; i < iovcnt; i++)
+            line_len += iov[i].iov_len;
+
+        if (is_framed(logger)) {
+            /* a partial write would desync the receiver's framing */
+            ret = line_len;
+            if (sendv_all(logger, iov, iovcnt, logger->send_flags) < 0)
+                ret = -1;
+        }
+        else {
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            ret = sendmsg(logger->sock, &msg, logger->send_flags);
+            if (ret >= 0 && ret < line_len)
+                logger->stats.truncated++;
+        }
+
+        if (ret < 0)
+            logger->err = strerror(errno);
+        return ret;
+    }
+
+    int line_len = logger->prefix_len + msg_len;
+    /* ensure there's space in the buffer for total length including a trailing NULL */
+    if (logger->bufsize < line_len + 1) {
+        /* try to increase buffer */
+        int new_bufsize = 2 * logger->bufsize;
+        while (new_bufsize < line_len + 1)
+            new_bufsize *= 2;
+        if (new_bufsize < 0) {
+            /* overflow */
+            logger->err = "message too large";
+            return -1;
+        }
+
+        char* new_buf = realloc(logger->linebuf, new_bufsize);
+        if (!new_buf) {
+            logger->err = strerror(errno);
+            return -1;
+        }
+
+        logger->linebuf = new_buf;
+        logger->bufsize = new_bufsize;
+        logger->stats.buffer_reallocs++;
+        logger->msg_start = logger->linebuf + logger->prefix_len;
+    }
+
+    /* paste the message into linebuf just past where the prefix was placed */
+    memcpy(logger->msg_start, msg_str, msg_len + 1); /* include perl-added null */
+
+    int ret = send(logger->sock, logger->linebuf, line_len, logger->send_flags);
+
+    if (ret < 0)
+        logger->err = strerror(errno);
+    else if (ret < line_len)
+        logger->stats.truncated++;
+    return ret;
+}
+
+/* keep a line that can't be sent now in the spill file, or count it as
+   dropped; returns the line's length if it was kept */
+static
+int
+spill_line(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority)
+{
+    struct iovec iov[LINE_IOV_MAX];
+    char hdr[FRAME_HDR_MAX];
+    int ret;
+
+    if (logger->spill) {
+        int iovcnt = line_iov(logger, hdr, msg_str, msg_len, priority, iov);
+        if ((ret = spill_append(logger, iov, iovcnt)))
+            return ret;
+    }
+    count_dropped(logger, 1);
+    return 0;
+}
+
+/* coalescing only means something on stream sockets */
+static
+int
+is_coalescing(LogSyslogFast* logger)
+{
+    return logger->coalesce && logger->sock_type == SOCK_STREAM;
+}
+
+/* write out the coalescing buffer in one go. On failure every line in it
+   is counted as failed and the buffer is emptied anyway, since part of it
+   may have reached the receiver; the caller decides about reconnecting. */
+static
+int
+coalesce_write(LogSyslogFast* logger, int flags)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+    struct iovec iov;
+    unsigned long lines = c->lines;
+    size_t len = c->len;
+
+    if (!lines)
+        return 0;
+
+    iov.iov_base = c->buf;
+    iov.iov_len = len;
+    c->len = c->lines = 0;
+
+    if (sendv_all(logger, &iov, 1, flags) < 0) {
+        int err = errno;
+        logger->err = strerror(err);
+        while (lines--)
+            count_failure(logger, err);
+        errno = err;
+        return -1;
+    }
+    count_sent(logger, lines, len);
+    return 0;
+}
+
+/* add a line to the coalescing buffer, writing the buffer out first if the
+   line won't fit, and afterwards if it's full or its oldest line is due.
+   A line bigger than the whole buffer goes straight out behind it. Lines
+   are counted as sent once they're written. */
+static
+int
+coalesce_line(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+    struct iovec iov[LINE_IOV_MAX];
+    char hdr[FRAME_HDR_MAX];
+    int iovcnt = line_iov(logger, hdr, msg_str, msg_len, priority, iov);
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+
+    /* the buffered lines are counted as failed; this one never went out */
+    if (c->len + len > c->size && coalesce_write(logger, logger->send_flags) < 0) {
+        if (reconnect_lost(logger))
+            return spill_line(logger, msg_str, msg_len, priority);
+        count_dropped(logger, 1);
+        return -1;
+    }
+
+    if (len > c->size) {
+        if (sendv_all(logger, iov, iovcnt, logger->send_flags) < 0) {
+            logger->err = strerror(errno);
+            count_failure(logger, errno);
+            if (reconnect_lost(logger))
+                return spill_line(logger, msg_str, msg_len, priority);
+            return -1;
+        }
+        count_sent(logger, 1, len);
+        return len;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(c->buf + c->len, iov[i].iov_base, iov[i].iov_len);
+        c->len += iov[i].iov_len;
+    }
+
+    if (!c->lines++) {
+        c->first_at = monotonic_coarse();
+        if (c->running)
+            pthread_cond_signal(&c->wakeup);
+        if (c->len < c->size)
+            return len;
+    }
+    else if (c->len < c->size
+             && (c->max_delay <= 0 || monotonic_coarse() - c->first_at < c->max_delay))
+        return len;
+
+    /* this line was buffered, so a failure now has already counted it */
+    if (coalesce_write(logger, logger->send_flags) < 0) {
+        reconnect_lost(logger);
+        return -1;
+    }
+    return len;
+}
+
+static
+void*
+coalesce_timer(void* arg)
+{
+    LogSyslogFast* logger = arg;
+    struct LSF_coalesce* c = logger->coalesce;
+
+    pthread_mutex_lock(&c->lock);
+    while (!c->stop) {
+        double left;
+
+        if (!c->lines) {
+            pthread_cond_wait(&c->wakeup, &c->lock);
+            continue;
+        }
+
+        left = c->first_at + c->max_delay - monotonic_coarse();
+        if (left > 0) {
+            struct timespec until;
+            clock_gettime(CLOCK_MONOTONIC, &until);
+            until.tv_sec += (time_t) left;
+            until.tv_nsec += (long) ((left - (time_t) left) * 1e9);
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&c->wakeup, &c->lock, &until);
+            continue;
+        }
+
+        if (is_coalescing(logger)
+            && coalesce_write(logger, logger->send_flags | MSG_NOSIGNAL) < 0)
+            reconnect_lost(logger);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+static
+void
+coalesce_init_wakeup(struct LSF_coalesce* c)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&c->wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* start the timer thread on a lock and condition variable that are ready,
+   and register it for the fork hooks */
+static
+int
+coalesce_spawn_timer(LogSyslogFast* logger)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+    sigset_t all, old;
+    int ret;
+
+    c->stop = 0;
+
+    /* keep perl's signal handling on the perl thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&c->thread, NULL, coalesce_timer, logger);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        logger->err = strerror(ret);
+        return -1;
+    }
+    c->running = 1;
+
+    pthread_mutex_lock(&coalesce_timers_lock);
+    c->next_timer = coalesce_timers;
+    coalesce_timers = c;
+    pthread_mutex_unlock(&coalesce_timers_lock);
+    return 0;
+}
+
+/* start the timer thread if one was asked for and lines can be due */
+static
+int
+coalesce_start_timer(LogSyslogFast* logger)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+
+    if (!c->timer || c->max_delay <= 0)
+        return 0;
+
+    pthread_mutex_init(&c->lock, NULL);
+    coalesce_init_wakeup(c);
+    if (coalesce_spawn_timer(logger) < 0) {
+        pthread_cond_destroy(&c->wakeup);
+        pthread_mutex_destroy(&c->lock);
+        return -1;
+    }
+    return 0;
+}
+
+static
+void
+coalesce_stop_timer(LogSyslogFast* logger)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+    struct LSF_coalesce** p;
+
+    if (!c->running)
+        return;
+
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_signal(&c->wakeup);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+
+    pthread_mutex_lock(&coalesce_timers_lock);
+    for (p = &coalesce_timers; *p; p = &(*p)->next_timer)
+        if (*p == c) {
+            *p = c->next_timer;
+            break;
+        }
+    pthread_mutex_unlock(&coalesce_timers_lock);
+
+    pthread_cond_destroy(&c->wakeup);
+    pthread_mutex_destroy(&c->lock);
+    c->running = 0;
+}
+
+/* with flush, buffered lines are written first; a child that inherited
+   the logger but never used it leaves them, and the timer, to the parent */
+static
+void
+coalesce_free(LogSyslogFast* logger, int flush)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+
+    if (flush) {
+        coalesce_stop_timer(logger);
+        if (is_coalescing(logger) && coalesce_write(logger, logger->send_flags | MSG_NOSIGNAL) < 0)
+            reconnect_lost(logger);
+    }
+    free(c->buf);
+    free(c);
+    logger->coalesce = NULL;
+}
+
+int
+LSF_set_coalesce(LogSyslogFast* logger, int size, double max_delay, int timer)
+{
+    struct LSF_coalesce* c;
+
+    if (size > 0 && (logger->async || logger->wbuf || logger->uring)) {
+        logger->err = "coalescing can't be combined with async or non-blocking mode or io_uring";
+        return -1;
+    }
+
+    if (logger->coalesce)
+        coalesce_free(logger, logger->fork_gen == fork_generation);
+
+    if (size <= 0)
+        return 0;
+
+    c = calloc(1, sizeof(struct LSF_coalesce));
+    if (!c) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    c->buf = malloc(size);
+    if (!c->buf) {
+        logger->err = strerror(errno);
+        free(c);
+        return -1;
+    }
+    c->size = size;
+    c->max_delay = max_delay;
+    c->timer = timer;
+    logger->coalesce = c;
+
+    if (coalesce_start_timer(logger) < 0) {
+        coalesce_free(logger, 0);
+        return -1;
+    }
+    return 0;
+}
+
+int
+LSF_get_coalesce(LogSyslogFast* logger, LSF_coalesce_info* info)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+
+    if (!c)
+        return -1;
+    info->size = c->size;
+    info->max_delay = c->max_delay;
+    info->timer = c->running;
+    info->lines = c->lines;
+    info->bytes = c->len;
+    return 0;
+}
+
+static
+int
+send_one(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority, uint32_t route,
+         time_t t)
+{
+    double start;
+    int ret;
+
+    stamp_prefix(logger, t);
+
+    if (logger->async)
+        return async_enqueue(logger, msg_str, msg_len, priority, route);
+
+    /* extra receivers get the line whatever becomes of it below */
+    if (logger->ndests)
+        dest_fanout(logger, msg_str, msg_len, priority);
+
+    if (dns_moved(logger))
+        dns_follow(logger);
+
+    /* while a lost connection is being re-established, lines are spilled
+       to disk if there's a spill file and dropped otherwise */
+    if (logger->reconnect && !reconnect_ready(logger))
+        return spill_line(logger, msg_str, msg_len, priority);
+
+    /* the backlog goes first; if that finds the connection gone, this
+       line joins it */
+    if (logger->spill && spill_pending(logger)
+        && spill_replay(logger, logger->send_flags) < 0 && logger->reconnect)
+        return spill_line(logger, msg_str, msg_len, priority);
+
+    /* a queued line is counted when it completes */
+    if (logger->uring && (ret = uring_queue(logger, msg_str, msg_len, priority))) {
+        uring_submit(logger->uring);
+        return ret;
+    }
+
+    if (is_coalescing(logger))
+        return coalesce_line(logger, msg_str, msg_len, priority);
+
+    start = logger->shstats ? monotonic_now() : 0;
+    ret = write_line(logger, msg_str, msg_len, priority, route);
+    if (logger->shstats)
+        shstats_latency(logger, start);
+    if (ret > 0)
+        count_sent(logger, 1, ret);
+    else if (ret < 0) {
+        count_failure(logger, errno);
+        if (reconnect_lost(logger))
+            return spill_line(logger, msg_str, msg_len, priority);
+    }
+    return ret;
+}
+
+static
+struct LSF_bucket*
+limit_bucket(LogSyslogFast* logger, int severity)
+{
+    struct LSF_limit* l = logger->limit;
+    int i;
+
+    if (severity < -1 || severity > 7) {
+        logger->err = "invalid severity";
+        return NULL;
+    }
+    if (!l) {
+        l = calloc(1, sizeof(*l));
+        if (!l) {
+            logger->err = strerror(errno);
+            return NULL;
+        }
+        for (i = 0; i < 8; i++)
+            l->sev[i].sample = 1;
+        l->all.sample = 1;
+        l->interval = LIMIT_REPORT_INTERVAL;
+        l->seed = (unsigned int) time(0) ^ (unsigned int) getpid();
+        logger->limit = l;
+    }
+    return severity < 0 ? &l->all : &l->sev[severity];
+}
+
+/* tokens in the bucket at monotonic time now */
+static
+double
+bucket_level(struct LSF_bucket* b, double now)
+{
+    if (now > b->last) {
+        b->tokens += (now - b->last) * b->rate;
+        if (b->tokens > b->burst)
+            b->tokens = b->burst;
+    }
+    b->last = now;
+    return b->tokens;
+}
+
+static
+int
+sampled_out(struct LSF_limit* l, const struct LSF_bucket* b)
+{
+    return b->sample < 1 && rand_r(&l->seed) >= b->sample * ((double) RAND_MAX + 1);
+}
+
+/* may a line at this severity go out at monotonic time now? If not it's
+   tallied as suppressed */
+static
+int
+limit_allow(LogSyslogFast* logger, int severity, double now)
+{
+    struct LSF_limit* l = logger->limit;
+    struct LSF_bucket* b = &l->sev[severity];
+
+    if (!sampled_out(l, b) && !sampled_out(l, &l->all)
+        && (!b->rate || bucket_level(b, now) >= 1)
+        && (!l->all.rate || bucket_level(&l->all, now) >= 1)) {
+        if (b->rate)
+            b->tokens--;
+        if (l->all.rate)
+            l->all.tokens--;
+        return 1;
+    }
+
+    if (!l->suppressed)
+        l->since = now;
+    l->suppressed++;
+    logger->stats.suppressed++;
+    return 0;
+}
+
+/* send the tally of suppressed lines if it's due at monotonic time now, or
+   whatever it is with force; it goes out at warning severity with send
+   time t and isn't itself limited */
+static
+void
+limit_report(LogSyslogFast* logger, time_t t, double now, int force)
+{
+    struct LSF_limit* l = logger->limit;
+    char msg[64];
+    int len;
+
+    if (!l->suppressed || !l->interval || (!force && now - l->since < l->interval))
+        return;
+    len = snprintf(msg, sizeof(msg), "%lu messages suppressed", l->suppressed);
+    l->suppressed = 0;
+    send_one(logger, msg, len, (logger->priority & ~7) | LIMIT_REPORT_SEVERITY, 0, t);
+}
+
+/* with flush, anything still tallied is reported first */
+static
+void
+limit_free(LogSyslogFast* logger, int flush)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+
+    if (flush && logger->limit->suppressed) {
+        if (c && c->running)
+            pthread_mutex_lock(&c->lock);
+        limit_report(logger, time(0), 0, 1);
+        if (c && c->running)
+            pthread_mutex_unlock(&c->lock);
+    }
+    free(logger->limit);
+    logger->limit = NULL;
+}
+
+/* a word at a time, finished with murmur3's 64-bit mixer; never 0, which
+   marks an empty slot */
+static
+uint64_t
+line_hash(const char* s, size_t len)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+    uint64_t w;
+
+    for (; len >= 8; s += 8, len -= 8) {
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h ? h : 1;
+}
+
+/* send the count of a slot's repeats and empty it */
+static
+void
+dedup_summarize(LogSyslogFast* logger, struct LSF_dedup_slot* s, time_t t)
+{
+    char msg[DEDUP_EXCERPT + 64];
+    int shown = s->len < DEDUP_EXCERPT ? s->len : DEDUP_EXCERPT;
+    int len;
+
+    len = snprintf(msg, sizeof(msg), "message repeated %lu times: [%.*s%s]", s->repeats,
+                   shown, s->excerpt, shown < s->len ? "..." : "");
+    logger->dedup->pending--;
+    s->hash = 0;
+    s->repeats = 0;
+    send_one(logger, msg, len, s->priority, s->route, t);
+}
+
+/* summarize the slots whose window has closed by t, or all of them with force */
+static
+void
+dedup_expire(LogSyslogFast* logger, time_t t, int force)
+{
+    struct LSF_dedup* d = logger->dedup;
+    int i;
+
+    for (i = 0; i < d->nslots && d->pending; i++) {
+        struct LSF_dedup_slot* s = &d->slots[i];
+        if (s->repeats && (force || t - s->since >= d->window))
+            dedup_summarize(logger, s, t);
+    }
+}
+
+/* is the line a repeat to be counted rather than sent? A different line
+   ends the run of repeats before it, which is summarized first. A line
+   that isn't a repeat takes a slot, the empty or oldest one, summarizing
+   what that held */
+static
+int
+dedup_repeat(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority,
+             uint32_t route, time_t t)
+{
+    struct LSF_dedup* d = logger->dedup;
+    struct LSF_dedup_slot* s;
+    struct LSF_dedup_slot* victim = NULL;
+    uint64_t hash;
+    int i;
+
+    if (d->pending)
+        dedup_expire(logger, t, 0);
+
+    hash = line_hash(msg_str, msg_len);
+    for (i = 0; i < d->nslots; i++) {
+        s = &d->slots[i];
+        if (s->hash == hash && s->len == msg_len && s->priority == priority
+            && !memcmp(s->excerpt, msg_str, msg_len < DEDUP_EXCERPT ? msg_len : DEDUP_EXCERPT)) {
+            if (d->last != s && d->last->repeats)
+                dedup_summarize(logger, d->last, t);
+            d->last = s;
+            if (t - s->since < d->window) {
+                if (!s->repeats++)
+                    d->pending++;
+                logger->stats.deduplicated++;
+                return 1;
+            }
+            s->since = t;
+            return 0;
+        }
+        if (!victim || !s->hash || (victim->hash && s->since < victim->since))
+            victim = s;
+    }
+
+    if (d->last && d->last->repeats)
+        dedup_summarize(logger, d->last, t);
+    if (victim->repeats)
+        dedup_summarize(logger, victim, t);
+    d->last = victim;
+    victim->hash = hash;
+    victim->len = msg_len;
+    victim->priority = priority;
+    victim->route = route;
+    victim->since = t;
+    victim->repeats = 0;
+    memcpy(victim->excerpt, msg_str, msg_len < DEDUP_EXCERPT ? msg_len : DEDUP_EXCERPT);
+    return 0;
+}
+
+/* with flush, repeats not yet summarized are summarized first */
+static
+void
+dedup_free(LogSyslogFast* logger, int flush)
+{
+    struct LSF_coalesce* c = logger->coalesce;
+
+    if (flush && logger->dedup->pending) {
+        if (c && c->running)
+            pthread_mutex_lock(&c->lock);
+        dedup_expire(logger, time(0), 1);
+        if (c && c->running)
+            pthread_mutex_unlock(&c->lock);
+    }
+    free(logger->dedup->slots);
+    free(logger->dedup);
+    logger->dedup = NULL;
+}
+
+/* a window of 0 turns it off, summarizing any repeats first */
+int
+LSF_set_dedup(LogSyslogFast* logger, int window, int slots)
+{
+    struct LSF_dedup* d;
+
+    if (window < 0) {
+        logger->err = "invalid window";
+        return -1;
+    }
+    if (window && (slots < 1 || slots > DEDUP_SLOTS_MAX)) {
+        logger->err = "invalid slot count";
+        return -1;
+    }
+    if (logger->dedup)
+        dedup_free(logger, 1);
+    if (!window)
+        return 0;
+
+    d = calloc(1, sizeof(*d));
+    if (d)
+        d->slots = calloc(slots, sizeof(*d->slots));
+    if (!d || !d->slots) {
+        free(d);
+        logger->err = strerror(errno);
+        return -1;
+    }
+    d->window = window;
+    d->nslots = slots;
+    logger->dedup = d;
+    return 0;
+}
+
+int
+LSF_get_dedup(LogSyslogFast* logger)
+{
+    return logger->dedup ? logger->dedup->window : 0;
+}
+
+/* send_one behind duplicate suppression and the rate limits */
+static
+int
+send_limited(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority,
+             uint32_t route, time_t t)
+{
+    if (logger->dedup && dedup_repeat(logger, msg_str, msg_len, priority, route, t))
+        return 0;
+    if (logger->limit) {
+        double now = monotonic_coarse();
+        int allowed = limit_allow(logger, priority & 7, now);
+        limit_report(logger, t, now, 0);
+        if (!allowed)
+            return 0;
+    }
+    return send_one(logger, msg_str, msg_len, priority, route, t);
+}
+
+int
+LSF_set_rate_limit(LogSyslogFast* logger, int severity, double rate, double burst)
+{
+    struct LSF_bucket* b;
+
+    if (rate < 0 || (burst && burst < 1)) {
+        logger->err = "invalid rate limit";
+        return -1;
+    }
+    if (!(b = limit_bucket(logger, severity)))
+        return -1;
+    b->rate = rate;
+    b->burst = burst ? burst : rate > 1 ? rate : 1;
+    b->tokens = b->burst;
+    b->last = 0;
+    return 0;
+}
+
+int
+LSF_set_sample(LogSyslogFast* logger, int severity, double fraction)
+{
+    struct LSF_bucket* b;
+
+    if (!(fraction >= 0 && fraction <= 1)) {
+        logger->err = "invalid sampling fraction";
+        return -1;
+    }
+    if (!(b = limit_bucket(logger, severity)))
+        return -1;
+    b->sample = fraction;
+    return 0;
+}
+
+int
+LSF_set_suppress_interval(LogSyslogFast* logger, int seconds)
+{
+    if (seconds < 0) {
+        logger->err = "invalid interval";
+        return -1;
+    }
+    if (!limit_bucket(logger, -1))
+        return -1;
+    logger->limit->interval = seconds;
+    return 0;
+}
+
+int
+LSF_get_rate_limit(LogSyslogFast* logger, int severity, LSF_limit_info* info)
+{
+    struct LSF_limit* l = logger->limit;
+    const struct LSF_bucket* b;
+
+    if (severity < -1 || severity > 7) {
+        logger->err = "invalid severity";
+        return -1;
+    }
+    if (!l) {
+        info->rate = info->burst = info->tokens = 0;
+        info->sample = 1;
+        return 0;
+    }
+    b = severity < 0 ? &l->all : &l->sev[severity];
+    info->rate = b->rate;
+    info->burst = b->burst;
+    info->tokens = b->tokens;
+    info->sample = b->sample;
+    return 0;
+}
+
+int
+LSF_get_suppress_interval(LogSyslogFast* logger)
+{
+    return logger->limit ? logger->limit->interval : LIMIT_REPORT_INTERVAL;
+}
+
+static
+int
+send_line(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority, uint32_t route,
+          time_t t)
+{
+    struct LSF_coalesce* c;
+    int ret;
+
+    if (LSF_filtered(logger, priority & 7, 1))
+        return 0;
+
+    if (logger->fork_gen != fork_generation)
+        adopt_after_fork(logger);
+
+    c = logger->coalesce;
+    if (!c || !c->running)
+        return send_limited(logger, msg_str, msg_len, priority, route, t);
+
+    pthread_mutex_lock(&c->lock);
+    ret = send_limited(logger, msg_str, msg_len, priority, route, t);
+    pthread_mutex_unlock(&c->lock);
+    return ret;
+}
+
+int
+LSF_send(LogSyslogFast* logger, const char* msg_str, int msg_len, time_t t)
+{
+    return send_line(logger, msg_str, msg_len, logger->priority, 0, t);
+}
+
+int
+LSF_send_prio(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority, time_t t)
+{
+    if (priority < 0 || priority >= PRI_COUNT) {
+        logger->err = "invalid priority";
+        return -1;
+    }
+    return send_line(logger, msg_str, msg_len, priority, 0, t);
+}
+
+#ifdef HAVE_GSO
+
+/* the largest segment the socket takes with UDP_SEGMENT that fits in the
+   path's MTU, or 0 if it takes none */
+static
+int
+gso_probe_seg(LogSyslogFast* logger)
+{
+    int family = logger->peer_addr.ss_family;
+    int zero = 0;
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+    int ret = -1;
+
+    if (logger->sock_type != SOCK_DGRAM || logger->sock < 0)
+        return 0;
+    if (family != AF_INET
+#ifdef AF_INET6
+        && family != AF_INET6
+#endif
+        )
+        return 0;
+    if (setsockopt(logger->sock, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) < 0)
+        return 0;
+
+    if (family == AF_INET) {
+        ret = getsockopt(logger->sock, IPPROTO_IP, IP_MTU, &mtu, &len);
+        mtu -= 28;
+    }
+#ifdef AF_INET6
+    else {
+        ret = getsockopt(logger->sock, IPPROTO_IPV6, IPV6_MTU, &mtu, &len);
+        mtu -= 48;
+    }
+#endif
+    if (ret < 0 || mtu <= 0)
+        return 0;
+    return mtu < GSO_MAX_BYTES ? mtu : GSO_MAX_BYTES;
+}
+
+/* probe the socket whenever it changes, on the thread that sends on it.
+   LSF_get_gso reads the result from the perl thread while an async worker
+   may be probing, so it's stored atomically. */
+static
+void
+gso_refresh(LogSyslogFast* logger)
+{
+    if (logger->gso)
+        __atomic_store_n(&logger->gso_seg, gso_probe_seg(logger), __ATOMIC_RELAXED);
+}
+
+/* errors that mean GSO doesn't work on this path after all, e.g. EIO
+   without checksum offload */
+static
+int
+is_gso_refused(int err)
+{
+    return err == EIO || err == EINVAL || err == ENOPROTOOPT || err == EOPNOTSUPP;
+}
+
+/* send up to SEND_MANY_BATCH datagrams on the logger's socket in one
+   sendmmsg. Each run of lines of one length, which a shorter line may
+   end, is a single message that the kernel splits into segments of that
+   length; lines longer than the MTU allows go on their own. Lines are
+   counted as they go; returns how many were sent, or -1 if none were, with
+   the number of lines in the message that failed in failed. */
+static
+int
+gso_send_batch(LogSyslogFast* logger, struct iovec* iov, const int* rec_iovs, int n, int flags,
+               int* failed)
+{
+    struct mmsghdr msgvec[SEND_MANY_BATCH];
+    char cbuf[SEND_MANY_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+    int first[SEND_MANY_BATCH + 1];
+    size_t len[SEND_MANY_BATCH];
+    int nmsgs = 0;
+    int sent = 0;
+    int ret;
+    int i, j, k;
+
+    for (i = 0, k = 0; i < n; i++) {
+        len[i] = 0;
+        for (j = 0; j < rec_iovs[i]; j++)
+            len[i] += iov[k++].iov_len;
+    }
+
+    for (i = 0, k = 0; i < n; nmsgs++) {
+        struct msghdr* msg = &msgvec[nmsgs].msg_hdr;
+        size_t seg = len[i];
+        size_t total = seg;
+
+        j = i + 1;
+        if (seg <= (size_t) logger->gso_seg) {
+            while (j < n && j - i < GSO_MAX_SEGS && len[j] <= seg
+                   && total + len[j] <= GSO_MAX_BYTES)
+            {
+                total += len[j];
+                if (len[j++] < seg)
+                    break;
+            }
+        }
+
+        memset(&msgvec[nmsgs], 0, sizeof(struct mmsghdr));
+        msg->msg_iov = &iov[k];
+        first[nmsgs] = i;
+        for (; i < j; i++) {
+            msg->msg_iovlen += rec_iovs[i];
+            k += rec_iovs[i];
+        }
+
+        if (j - first[nmsgs] > 1) {
+            struct cmsghdr* cm;
+            uint16_t gso_size = seg;
+            msg->msg_control = cbuf[nmsgs];
+            msg->msg_controllen = sizeof(cbuf[nmsgs]);
+            cm = CMSG_FIRSTHDR(msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        }
+    }
+    first[nmsgs] = n;
+
+    do {
+        ret = sendmmsg(logger->sock, msgvec, nmsgs, flags);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        int err = errno;
+        /* the rest of the logger's life is spent a datagram at a time */
+        if (msgvec[0].msg_hdr.msg_controllen && is_gso_refused(err)) {
+            __atomic_store_n(&logger->gso_seg, 0, __ATOMIC_RELAXED);
+            return gso_send_batch(logger, iov, rec_iovs, n, flags, failed);
+        }
+        logger->err = strerror(err);
+        *failed = first[1] - first[0];
+        errno = err;
+        return -1;
+    }
+
+    for (i = 0; i < ret; i++) {
+        count_sent(logger, first[i + 1] - first[i], msgvec[i].msg_len);
+        sent += first[i + 1] - first[i];
+    }
+    return sent;
+}
+
+#else
+
+static void gso_refresh(LogSyslogFast* logger) { }
+
+#endif /* HAVE_GSO */
+
+int
+LSF_set_gso(LogSyslogFast* logger, int gso)
+{
+    /* the worker sends by the setting, so park it while it changes; an
+       inherited logger's worker is restarted when it first sends */
+    if (logger->async && logger->fork_gen == fork_generation) {
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        async_stop(logger, 1);
+        LSF_set_gso(logger, gso);
+        return LSF_set_async(logger, queue_size, drain_timeout);
+    }
+
+    logger->gso = gso;
+    logger->gso_seg = 0;
+    gso_refresh(logger);
+    return 0;
+}
+
+int
+LSF_get_min_severity(LogSyslogFast* logger)
+{
+    if (logger->min_severity_word)
+        return __atomic_load_n(logger->min_severity_word, __ATOMIC_RELAXED);
+    return logger->min_severity;
+}
+
+int
+LSF_get_gso(LogSyslogFast* logger)
+{
+    if (!logger->gso)
+        return 0;
+    return __atomic_load_n(&logger->gso_seg, __ATOMIC_RELAXED);
+}
+
+/* spill_line for the rest of a send_many batch; returns how many were kept */
+static
+int
+spill_rest(LogSyslogFast* logger, const char** msgs, const int* lens, int count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+        if (!spill_line(logger, msgs[i], lens[i], logger->priority))
+            break;
+    if (i < count)
+        count_dropped(logger, count - i - 1);
+    return i;
+}
+
+static
+int
+send_many(LogSyslogFast* logger, const char** msgs, const int* lens, int count, time_t t)
+{
+    struct iovec iov[LINE_IOV_MAX * SEND_MANY_BATCH];
+    int msg_iovs[SEND_MANY_BATCH];
+    char hdrs[SEND_MANY_BATCH][FRAME_HDR_MAX];
+    int sent = 0;
+
+    stamp_prefix(logger, t);
+
+    if (logger->async) {
+        for (sent = 0; sent < count; sent++) {
+            if (async_enqueue(logger, msgs[sent], lens[sent], logger->priority, 0) <= 0)
+                break;
+        }
+        return sent;
+    }
+
+    if (logger->ndests) {
+        int i;
+        for (i = 0; i < count; i++)
+            dest_fanout(logger, msgs[i], lens[i], logger->priority);
+    }
+
+    if (dns_moved(logger))
+        dns_follow(logger);
+
+    if (logger->reconnect && !reconnect_ready(logger))
+        return spill_rest(logger, msgs, lens, count);
+
+    if (logger->spill && spill_pending(logger)
+        && spill_replay(logger, logger->send_flags) < 0 && logger->reconnect)
+        return spill_rest(logger, msgs, lens, count);
+
+    if (is_coalescing(logger)) {
+        for (sent = 0; sent < count; sent++) {
+            if (logger->reconnect && !reconnect_ready(logger))
+                return sent + spill_rest(logger, msgs + sent, lens + sent, count - sent);
+            if (coalesce_line(logger, msgs[sent], lens[sent], logger->priority) < 0)
+                return sent ? sent : -1;
+        }
+        return sent;
+    }
+
+    if (logger->uring) {
+        /* the whole batch is queued and then submitted at once */
+        for (sent = 0; sent < count; sent++) {
+            if (uring_queue(logger, msgs[sent], lens[sent], logger->priority))
+                continue;
+            int ret = write_line(logger, msgs[sent], lens[sent], logger->priority, 0);
+            if (ret < 0) {
+                count_failure(logger, errno);
+                uring_submit(logger->uring);
+                return sent ? sent : -1;
+            }
+            count_sent(logger, 1, ret);
+        }
+        uring_submit(logger->uring);
+        return sent;
+    }
+
+    if (is_nonblocking(logger)) {
+        /* each line goes through the overflow policy on its own */
+        for (sent = 0; sent < count; sent++) {
+            char hdr[FRAME_HDR_MAX];
+            int iovcnt = line_iov(logger, hdr, msgs[sent], lens[sent], logger->priority, iov);
+            int ret = wbuf_send(logger, iov, iovcnt);
+            if (ret < 0) {
+                count_failure(logger, errno);
+                if (reconnect_lost(logger))
+                    return sent + spill_rest(logger, msgs + sent, lens + sent, count - sent);
+                return sent ? sent : -1;
+            }
+            if (ret == 0)
+                break;
+            count_sent(logger, 1, ret);
+        }
+        return sent;
+    }
+
+    while (sent < count) {
+        int n = count - sent;
+        int iovcnt = 0;
+        size_t bytes = 0;
+        int i;
+        if (n > SEND_MANY_BATCH)
+            n = SEND_MANY_BATCH;
+
+        /* every message shares the cached prefix, so nothing is copied */
+        for (i = 0; i < n; i++) {
+            msg_iovs[i] = line_iov(logger, hdrs[i], msgs[sent + i], lens[sent + i],
+                                   logger->priority, &iov[iovcnt]);
+            iovcnt += msg_iovs[i];
+        }
+
+        if (logger->pool) {
+            int ret = pool_send_batch(logger, iov, msg_iovs, NULL, n, logger->send_flags);
+            sent += ret;
+            if (ret < n)
+                return sent ? sent : -1;
+        }
+        else if (logger->sock_type == SOCK_STREAM) {
+            /* a stream has no record boundaries, so one writev carries the
+               whole batch; partial writes are resumed to keep lines intact */
+            for (i = 0; i < iovcnt; i++)
+                bytes += iov[i].iov_len;
+            if (sendv_all(logger, iov, iovcnt, logger->send_flags) < 0) {
+                logger->err = strerror(errno);
+                count_failure(logger, errno);
+                if (reconnect_lost(logger))
+                    return sent + spill_rest(logger, msgs + sent, lens + sent, count - sent);
+                return sent ? sent : -1;
+            }
+            count_sent(logger, n, bytes);
+            sent += n;
+        }
+#ifdef HAVE_GSO
+        else if (logger->gso) {
+            int failed;
+            int ret = gso_send_batch(logger, iov, msg_iovs, n, logger->send_flags, &failed);
+            if (ret < 0) {
+                count_failure(logger, errno);
+                return sent ? sent : -1;
+            }
+            sent += ret;
+            if (ret < n)
+                return sent;
+        }
+#endif
+        else {
+#ifdef HAVE_SENDMMSG
+            struct mmsghdr msgvec[SEND_MANY_BATCH];
+            int ret;
+
+            memset(msgvec, 0, n * sizeof(struct mmsghdr));
+            for (i = 0, iovcnt = 0; i < n; iovcnt += msg_iovs[i++]) {
+                msgvec[i].msg_hdr.msg_iov = &iov[iovcnt];
+                msgvec[i].msg_hdr.msg_iovlen = msg_iovs[i];
+            }
+
+            ret = sendmmsg(logger->sock, msgvec, n, logger->send_flags);
+            if (ret < 0) {
+                logger->err = strerror(errno);
+                count_failure(logger, errno);
+                return sent ? sent : -1;
+            }
+            for (i = 0; i < ret; i++)
+                bytes += msgvec[i].msg_len;
+            count_sent(logger, ret, bytes);
+            sent += ret;
+
+            /* the kernel stopped early, e.g. buffer space ran out */
+            if (ret < n)
+                return sent;
+#else
+            for (i = 0, iovcnt = 0; i < n; iovcnt += msg_iovs[i++]) {
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = &iov[iovcnt];
+                msg.msg_iovlen = msg_iovs[i];
+                ssize_t ret = sendmsg(logger->sock, &msg, logger->send_flags);
+                if (ret < 0) {
+                    logger->err = strerror(errno);
+                    count_failure(logger, errno);
+                    return sent ? sent : -1;
+                }
+                count_sent(logger, 1, ret);
+                sent++;
+            }
+#endif
+        }
+    }
+
+    return sent;
+}
+
+/* each line is put to duplicate suppression and the rate limits, and the
+   ones they let through go out as a batch */
+static
+int
+send_many_checked(LogSyslogFast* logger, const char** msgs, const int* lens, int count, time_t t)
+{
+    const char** kept_msgs;
+    int* kept_lens;
+    double now = 0;
+    int kept = 0, sent = 0;
+    int i, ret;
+
+    if (!logger->dedup && !logger->limit)
+        return send_many(logger, msgs, lens, count, t);
+
+    kept_msgs = malloc(count * sizeof(*kept_msgs));
+    kept_lens = malloc(count * sizeof(*kept_lens));
+    if (!kept_msgs || !kept_lens) {
+        free(kept_msgs);
+        free(kept_lens);
+        logger->err = strerror(errno);
+        return -1;
+    }
+    if (logger->limit)
+        now = monotonic_coarse();
+    for (i = 0; i < count; i++) {
+        /* a summary goes out after the lines kept ahead of it */
+        if (logger->dedup && logger->dedup->pending && kept) {
+            ret = send_many(logger, kept_msgs, kept_lens, kept, t);
+            if (ret < 0)
+                goto done;
+            sent += ret;
+            kept = 0;
+        }
+        if (logger->dedup && dedup_repeat(logger, msgs[i], lens[i], logger->priority, 0, t))
+            continue;
+        if (logger->limit && !limit_allow(logger, logger->priority & 7, now))
+            continue;
+        kept_msgs[kept] = msgs[i];
+        kept_lens[kept++] = lens[i];
+    }
+    if (logger->limit)
+        limit_report(logger, t, now, 0);
+
+    ret = kept ? send_many(logger, kept_msgs, kept_lens, kept, t) : 0;
+    if (ret >= 0)
+        ret += sent;
+done:
+    free(kept_msgs);
+    free(kept_lens);
+    return ret;
+}
+
+int
+LSF_send_many(LogSyslogFast* logger, const char** msgs, const int* lens, int count, time_t t)
+{
+    double start = logger->shstats && !logger->async ? monotonic_now() : 0;
+    struct LSF_coalesce* c;
+    int ret;
+
+    if (LSF_filtered(logger, logger->priority & 7, count))
+        return 0;
+
+    if (logger->fork_gen != fork_generation)
+        adopt_after_fork(logger);
+
+    c = logger->coalesce;
+    if (c && c->running) {
+        pthread_mutex_lock(&c->lock);
+        ret = send_many_checked(logger, msgs, lens, count, t);
+        pthread_mutex_unlock(&c->lock);
+    }
+    else
+        ret = send_many_checked(logger, msgs, lens, count, t);
+    if (start)
+        shstats_latency(logger, start);
+    return ret;
+}
+
+static
+void
+ring_put(struct LSF_async* a, size_t pos, const void* src, size_t len)
+{
+    size_t off = pos & (a->size - 1);
+    size_t first = a->size - off;
+    if (first > len)
+        first = len;
+    memcpy(a->ring + off, src, first);
+    memcpy(a->ring, (const char*) src + first, len - first);
+}
+
+static
+void
+ring_get(struct LSF_async* a, size_t pos, void* dst, size_t len)
+{
+    size_t off = pos & (a->size - 1);
+    size_t first = a->size - off;
+    if (first > len)
+        first = len;
+    memcpy(dst, a->ring + off, first);
+    memcpy((char*) dst + first, a->ring, len - first);
+}
+
+/* point up to two iovecs at len bytes of the ring starting at pos */
+static
+int
+ring_iov(struct LSF_async* a, size_t pos, size_t len, struct iovec* iov)
+{
+    size_t off = pos & (a->size - 1);
+    size_t first = a->size - off;
+    if (first >= len) {
+        iov[0].iov_base = a->ring + off;
+        iov[0].iov_len = len;
+        return 1;
+    }
+    iov[0].iov_base = a->ring + off;
+    iov[0].iov_len = first;
+    iov[1].iov_base = a->ring;
+    iov[1].iov_len = len - first;
+    return 2;
+}
+
+/* called on the perl thread: copy the formatted line into the ring and
+   nudge the worker if it's asleep; never blocks on the socket */
+static
+int
+async_enqueue(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority,
+              uint32_t route)
+{
+    struct LSF_async* a = logger->async;
+    struct iovec iov[LINE_IOV_MAX];
+    char hdr[FRAME_HDR_MAX];
+    int iovcnt = line_iov(logger, hdr, msg_str, msg_len, priority, iov);
+    uint32_t rec[2];
+    uint32_t line_len = 0;
+    size_t tail = a->tail;
+    size_t head = __atomic_load_n(&a->head, __ATOMIC_ACQUIRE);
+    size_t pos;
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+        line_len += iov[i].iov_len;
+
+    if (ASYNC_HDR_LEN + line_len > a->size - (tail - head)) {
+        if (logger->spill && spill_append(logger, iov, iovcnt))
+            return line_len;
+        count_dropped(logger, 1);
+        return 0;
+    }
+
+    rec[0] = line_len;
+    rec[1] = route;
+    ring_put(a, tail, rec, ASYNC_HDR_LEN);
+    for (i = 0, pos = tail + ASYNC_HDR_LEN; i < iovcnt; pos += iov[i++].iov_len)
+        ring_put(a, pos, iov[i].iov_base, iov[i].iov_len);
+
+    /* seq_cst pairs with the worker setting sleeping before rechecking tail,
+       so either it sees this record or we see it sleeping */
+    __atomic_store_n(&a->tail, pos, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&a->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->wakeup);
+        pthread_mutex_unlock(&a->lock);
+    }
+
+    return line_len;
+}
+
+/* a batch that can't be sent while the connection is down goes to the
+   spill file if there is one. After a failed sendv_all the iovecs show
+   what is still unsent: lines already sent are skipped, and one cut off
+   partway can't be replayed whole, so it counts as dropped. */
+static
+void
+async_spill_batch(struct LSF_async* a, struct iovec* iov, int* rec_iovs, uint32_t* rec_len, int n)
+{
+    int i, j;
+    for (i = 0; i < n; iov += rec_iovs[i++]) {
+        size_t left = 0;
+        for (j = 0; j < rec_iovs[i]; j++)
+            left += iov[j].iov_len;
+        if (left == 0)
+            continue;
+        if (left != rec_len[i] || !a->logger->spill
+            || !spill_append(a->logger, iov, rec_iovs[i]))
+            count_dropped(a->logger, 1);
+    }
+}
+
+/* copy a record in the ring to the extra receivers, less the main
+   receiver's framing */
+static
+void
+async_fanout(struct LSF_async* a, size_t pos, uint32_t len)
+{
+    LogSyslogFast* logger = a->logger;
+    struct iovec body[2];
+    size_t skip = 0;
+    size_t trail = 0;
+    int body_cnt;
+    int i;
+
+    if (logger->framing == LOG_FRAMING_OCTET && is_framed(logger)) {
+        char hdr[FRAME_HDR_MAX];
+        size_t n = len < FRAME_HDR_MAX ? len : FRAME_HDR_MAX;
+        ring_get(a, pos, hdr, n);
+        while (skip < n && hdr[skip] != ' ')
+            skip++;
+        skip++;
+    }
+    else if (logger->framing == LOG_FRAMING_LF && is_framed(logger)) {
+        trail = 1;
+    }
+
+    body_cnt = ring_iov(a, pos + skip, len - skip - trail, body);
+    for (i = 0; i < logger->ndests; i++)
+        dest_send(&logger->dests[i], body, body_cnt, len - skip - trail);
+}
+
+/* send up to ASYNC_BATCH records from [head, tail) straight out of the
+   ring, returning the new head */
+static
+size_t
+async_send_batch(struct LSF_async* a, size_t head, size_t tail)
+{
+    struct iovec iov[2 * ASYNC_BATCH];
+    int rec_iovs[ASYNC_BATCH];
+    size_t rec_end[ASYNC_BATCH];
+    uint32_t rec_len[ASYNC_BATCH];
+    uint32_t routes[ASYNC_BATCH];
+    int sock;
+    int iovcnt = 0;
+    size_t bytes = 0;
+    int n = 0;
+    int i;
+
+    while (head != tail && n < ASYNC_BATCH) {
+        uint32_t rec[2];
+        uint32_t len;
+        ring_get(a, head, rec, ASYNC_HDR_LEN);
+        len = rec[0];
+        rec_iovs[n] = ring_iov(a, head + ASYNC_HDR_LEN, len, &iov[iovcnt]);
+        rec_len[n] = len;
+        routes[n] = rec[1];
+        bytes += len;
+        if (a->logger->ndests)
+            async_fanout(a, head + ASYNC_HDR_LEN, len);
+        iovcnt += rec_iovs[n];
+        head += ASYNC_HDR_LEN + len;
+        rec_end[n++] = head;
+    }
+
+    /* the worker owns the socket, so it also follows the receiver */
+    if (dns_moved(a->logger))
+        dns_follow(a->logger);
+
+    if (a->logger->pool) {
+        count_dropped(a->logger, n - pool_send_batch(a->logger, iov, rec_iovs, routes, n,
+                                                     MSG_NOSIGNAL));
+        return head;
+    }
+
+    if (a->logger->sock_type == SOCK_STREAM) {
+        /* the worker owns the socket, so it also runs any reconnect */
+        if (a->logger->reconnect && !reconnect_ready(a->logger)) {
+            async_spill_batch(a, iov, rec_iovs, rec_len, n);
+            return head;
+        }
+        if (a->logger->spill && spill_pending(a->logger)
+            && spill_replay(a->logger, MSG_NOSIGNAL) < 0 && a->logger->reconnect)
+        {
+            async_spill_batch(a, iov, rec_iovs, rec_len, n);
+            return head;
+        }
+        if (sendv_all(a->logger, iov, iovcnt, MSG_NOSIGNAL) < 0) {
+            count_failure(a->logger, errno);
+            if (reconnect_lost(a->logger))
+                async_spill_batch(a, iov, rec_iovs, rec_len, n);
+            else
+                count_dropped(a->logger, n);
+        }
+        else
+            count_sent(a->logger, n, bytes);
+        return head;
+    }
+
+    sock = a->logger->sock;
+
+#ifdef HAVE_GSO
+    if (a->logger->gso) {
+        int done = 0;
+
+        iovcnt = 0;
+        while (done < n) {
+            int failed;
+            int ret = gso_send_batch(a->logger, &iov[iovcnt], rec_iovs + done, n - done,
+                                     MSG_NOSIGNAL, &failed);
+            if (ret < 0) {
+                /* drop the message that failed, every line of a run sent
+                   as one, and carry on with the rest */
+                int err = errno;
+                for (i = 0; i < failed; i++)
+                    count_failure(a->logger, err);
+                count_dropped(a->logger, failed);
+                ret = failed;
+            }
+            for (i = done; i < done + ret; i++)
+                iovcnt += rec_iovs[i];
+            done += ret;
+        }
+        return head;
+    }
+#endif
+
+#ifdef HAVE_SENDMMSG
+    {
+        struct mmsghdr msgvec[ASYNC_BATCH];
+        int done = 0;
+
+        memset(msgvec, 0, n * sizeof(struct mmsghdr));
+        for (i = 0, iovcnt = 0; i < n; iovcnt += rec_iovs[i++]) {
+            msgvec[i].msg_hdr.msg_iov = &iov[iovcnt];
+            msgvec[i].msg_hdr.msg_iovlen = rec_iovs[i];
+        }
+
+        while (done < n) {
+            int ret = sendmmsg(sock, msgvec + done, n - done, MSG_NOSIGNAL);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                /* drop the datagram that failed and carry on with the rest */
+                count_failure(a->logger, errno);
+                count_dropped(a->logger, 1);
+                done++;
+                continue;
+            }
+            for (i = done; i < done + ret; i++)
+                count_sent(a->logger, 1, msgvec[i].msg_len);
+            done += ret;
+        }
+    }
+#else
+    for (i = 0, iovcnt = 0; i < n; iovcnt += rec_iovs[i++]) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[iovcnt];
+        msg.msg_iovlen = rec_iovs[i];
+        ssize_t ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (ret < 0) {
+            count_failure(a->logger, errno);
+            count_dropped(a->logger, 1);
+        }
+        else
+            count_sent(a->logger, 1, ret);
+    }
+#endif
+
+    return rec_end[n - 1];
+}
+
+static
+void*
+async_worker(void* arg)
+{
+    struct LSF_async* a = arg;
+    size_t head = a->head;
+
+    for (;;) {
+        size_t tail = __atomic_load_n(&a->tail, __ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&a->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        if (head == tail) {
+            /* with a spill backlog, wake up now and then to replay it */
+            int backlog = a->logger->spill && spill_pending(a->logger);
+            if (backlog && (!a->logger->reconnect || reconnect_ready(a->logger)))
+                spill_replay(a->logger, MSG_NOSIGNAL);
+
+            pthread_mutex_lock(&a->lock);
+            __atomic_store_n(&a->sleeping, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&a->tail, __ATOMIC_SEQ_CST) == head && !a->stop) {
+                if (backlog) {
+                    struct timespec until;
+                    clock_gettime(CLOCK_REALTIME, &until);
+                    until.tv_nsec += 10000000; /* 10ms */
+                    if (until.tv_nsec >= 1000000000) {
+                        until.tv_sec++;
+                        until.tv_nsec -= 1000000000;
+                    }
+                    pthread_cond_timedwait(&a->wakeup, &a->lock, &until);
+                }
+                else {
+                    pthread_cond_wait(&a->wakeup, &a->lock);
+                }
+            }
+            __atomic_store_n(&a->sleeping, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&a->lock);
+            continue;
+        }
+
+        if (a->logger->shstats) {
+            double start = monotonic_now();
+            head = async_send_batch(a, head, tail);
+            shstats_latency(a->logger, start);
+        }
+        else
+            head = async_send_batch(a, head, tail);
+        __atomic_store_n(&a->head, head, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/* stop the worker, first giving it drain_timeout seconds to empty the ring.
+   With force, a worker stuck in a send to a stalled peer is knocked loose by
+   shutting the socket down; the caller must be about to close it anyway. */
+static
+void
+async_stop(LogSyslogFast* logger, int force)
+{
+    struct LSF_async* a = logger->async;
+
+    /* a worker thread doesn't survive fork, so a child only frees memory */
+    if (a->pid == getpid()) {
+        if (!LSF_flush(logger, a->drain_timeout) && force)
+            shutdown(logger->sock, SHUT_RDWR);
+
+        pthread_mutex_lock(&a->lock);
+        a->stop = 1;
+        pthread_cond_signal(&a->wakeup);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->thread, NULL);
+
+        pthread_cond_destroy(&a->wakeup);
+        pthread_mutex_destroy(&a->lock);
+    }
+
+    free(a->ring);
+    free(a);
+    logger->async = NULL;
+}
+
+int
+LSF_set_async(LogSyslogFast* logger, int queue_size, double drain_timeout)
+{
+    struct LSF_async* a;
+    sigset_t all, old;
+    size_t size;
+    int ret;
+
+    if (logger->async)
+        async_stop(logger, 0);
+
+    if (queue_size <= 0)
+        return 0;
+
+    if (logger->wbuf) {
+        logger->err = "async mode can't be combined with non-blocking mode";
+        return -1;
+    }
+    if (logger->uring) {
+        logger->err = "async mode can't be combined with io_uring";
+        return -1;
+    }
+    if (logger->coalesce) {
+        logger->err = "async mode can't be combined with coalescing";
+        return -1;
+    }
+
+    for (size = ASYNC_MIN_QUEUE; size < (size_t) queue_size; size *= 2)
+        ;
+
+    a = calloc(1, sizeof(struct LSF_async));
+    if (!a) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    a->ring = malloc(size);
+    if (!a->ring) {
+        logger->err = strerror(errno);
+        free(a);
+        return -1;
+    }
+    a->size = size;
+    a->drain_timeout = drain_timeout;
+    a->pid = getpid();
+    a->logger = logger;
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->wakeup, NULL);
+
+    /* keep perl's signal handling on the perl thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&a->thread, NULL, async_worker, a);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        logger->err = strerror(ret);
+        pthread_cond_destroy(&a->wakeup);
+        pthread_mutex_destroy(&a->lock);
+        free(a->ring);
+        free(a);
+        return -1;
+    }
+
+    logger->async = a;
+    return 0;
+}
+
+/* block in poll until the write buffer is empty or timeout runs out */
+static
+int
+wbuf_drain(LogSyslogFast* logger, double timeout)
+{
+    struct LSF_wbuf* w = logger->wbuf;
+    double deadline = monotonic_now() + timeout;
+
+    for (;;) {
+        struct pollfd pfd;
+        int wait_ms = -1;
+
+        if (wbuf_flush(logger) < 0)
+            return 0;
+        if (w->start == w->end)
+            return 1;
+
+        if (timeout >= 0) {
+            double left = deadline - monotonic_now();
+            if (left <= 0)
+                return 0;
+            wait_ms = (int) (left * 1000) + 1;
+        }
+
+        pfd.fd = logger->sock;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, wait_ms);
+    }
+}
+
+static
+int
+flush_all(LogSyslogFast* logger, double timeout)
+{
+    struct LSF_async* a = logger->async;
+    struct timespec pause = { 0, 1000000 }; /* 1ms */
+    double deadline;
+
+    if (logger->fork_gen != fork_generation) {
+        adopt_after_fork(logger);
+        a = logger->async;
+    }
+
+    /* a tally or repeats waiting for a later send go out ahead of the flush */
+    if (logger->limit)
+        limit_report(logger, time(0), 0, 1);
+    if (logger->dedup && logger->dedup->pending)
+        dedup_expire(logger, time(0), 1);
+
+    deadline = monotonic_now() + timeout;
+
+    if (logger->spill && !a) {
+        while (spill_pending(logger)) {
+            if ((!logger->reconnect || reconnect_ready(logger))
+                && spill_replay(logger, logger->send_flags) < 0 && !logger->reconnect)
+                return 0;
+            if (!spill_pending(logger))
+                break;
+            if (timeout >= 0 && monotonic_now() >= deadline)
+                return 0;
+            nanosleep(&pause, NULL);
+        }
+        if (timeout >= 0) {
+            timeout = deadline - monotonic_now();
+            if (timeout < 0)
+                timeout = 0;
+        }
+    }
+
+    if (is_coalescing(logger)) {
+        if (coalesce_write(logger, logger->send_flags) < 0) {
+            reconnect_lost(logger);
+            return 0;
+        }
+        return 1;
+    }
+    if (logger->wbuf)
+        return wbuf_drain(logger, timeout);
+    if (logger->uring)
+        return uring_drain(logger, timeout);
+
+    if (!a)
+        return 1;
+
+    while (__atomic_load_n(&a->head, __ATOMIC_ACQUIRE) != a->tail) {
+        if (timeout >= 0 && monotonic_now() >= deadline)
+            return 0;
+        nanosleep(&pause, NULL);
+    }
+    return 1;
+}
+
+int
+LSF_flush(LogSyslogFast* logger, double timeout)
+{
+    struct LSF_coalesce* c;
+    int ret;
+
+    if (logger->fork_gen != fork_generation)
+        adopt_after_fork(logger);
+
+    c = logger->coalesce;
+    if (!c || !c->running)
+        return flush_all(logger, timeout);
+
+    pthread_mutex_lock(&c->lock);
+    ret = flush_all(logger, timeout);
+    pthread_mutex_unlock(&c->lock);
+    return ret;
+}
+
+/* errors that mean the receiver's end of a stream went away */
+static
+int
+is_conn_lost(int err)
+{
+    return err == EPIPE || err == ECONNRESET || err == ENOTCONN
+        || err == ECONNREFUSED || err == ECONNABORTED || err == ETIMEDOUT
+        || err == EHOSTUNREACH || err == ENETUNREACH;
+}
+
+/* pick the time of the next attempt and back off for the one after it.
+   Half the delay is fixed and half random, so that many clients cut off
+   by the same restart don't all reconnect in lockstep. */
+static
+void
+reconnect_schedule(LogSyslogFast* logger)
+{
+    struct LSF_reconnect* r = logger->reconnect;
+    double jitter = (double) rand_r(&r->seed) / RAND_MAX;
+
+    if (logger->tls) {
+        tls_read_tickets(logger);
+        tls_drop(logger);
+    }
+    if (logger->sock >= 0)
+        close(logger->sock);
+    logger->sock = -1;
+    r->connecting = 0;
+
+    r->next_attempt = monotonic_now() + r->delay / 2 * (1 + jitter);
+    r->delay *= 2;
+    if (r->delay > r->max_delay)
+        r->delay = r->max_delay;
+}
+
+/* after a failed send: if the connection is gone, close it and schedule
+   a reconnect. Returns 1 if the failure was handled that way. */
+static
+int
+reconnect_lost(LogSyslogFast* logger)
+{
+    struct LSF_reconnect* r = logger->reconnect;
+
+    if (!r || logger->sock_type != SOCK_STREAM || !is_conn_lost(errno))
+        return 0;
+
+    r->down = 1;
+    r->delay = r->min_delay;
+    reconnect_schedule(logger);
+    if (logger->wbuf)
+        wbuf_drop_partial(logger);
+    return 1;
+}
+
+static
+int
+reconnect_done(LogSyslogFast* logger)
+{
+    struct LSF_reconnect* r = logger->reconnect;
+
+    r->down = 0;
+    r->connecting = 0;
+    r->delay = r->min_delay;
+    logger->stats.reconnects++;
+
+    /* the write buffer wants the socket non-blocking; otherwise restore
+       the usual blocking sends */
+    if (!logger->wbuf) {
+        int flags = fcntl(logger->sock, F_GETFL, 0);
+        fcntl(logger->sock, F_SETFL, flags & ~O_NONBLOCK);
+    }
+    return 1;
+}
+
+/* the new stream is connected; carry on with its TLS handshake if it
+   has one, without waiting for the server */
+static
+int
+reconnect_connected(LogSyslogFast* logger)
+{
+    if (logger->tls) {
+        int ret = tls_handshake(logger, logger->sock);
+        if (ret < 0) {
+            reconnect_schedule(logger);
+            return 0;
+        }
+        if (ret == 0) {
+            logger->reconnect->connecting = 1;
+            return 0;
+        }
+    }
+    return reconnect_done(logger);
+}
+
+/* move a pending reconnect along without ever waiting: start a
+   non-blocking connect once the backoff has passed, then check on it on
+   later calls. Returns 1 when the socket is usable. */
+static
+int
+reconnect_ready(LogSyslogFast* logger)
+{
+    struct LSF_reconnect* r = logger->reconnect;
+    struct pollfd pfd;
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+
+    if (!r->down)
+        return 1;
+
+    if (!r->connecting) {
+        if (monotonic_now() < r->next_attempt)
+            return 0;
+
+        if (dns_moved(logger))
+            dns_follow(logger);
+        logger->sock = socket(logger->peer_addr.ss_family, SOCK_STREAM, 0);
+        if (logger->sock < 0) {
+            reconnect_schedule(logger);
+            return 0;
+        }
+        fcntl(logger->sock, F_SETFD, FD_CLOEXEC);
+        fcntl(logger->sock, F_SETFL, fcntl(logger->sock, F_GETFL, 0) | O_NONBLOCK);
+
+        if (connect(logger->sock, (struct sockaddr*) &logger->peer_addr, logger->peer_len) == 0)
+            return reconnect_connected(logger);
+        if (errno != EINPROGRESS) {
+            reconnect_schedule(logger);
+            return 0;
+        }
+        r->connecting = 1;
+    }
+
+    /* once the handshake has started, the connect is long done */
+    if (!tls_started(logger)) {
+        pfd.fd = logger->sock;
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, 0) <= 0)
+            return 0;
+
+        if (getsockopt(logger->sock, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0 || err) {
+            reconnect_schedule(logger);
+            return 0;
+        }
+    }
+    return reconnect_connected(logger);
+}
+
+/* open a new blocking stream connection to the saved peer address;
+   returns the socket, or -1 with err set. A TLS logger's old session
+   state is let go either way, and the new one handshaken. */
+static
+int
+connect_peer(LogSyslogFast* logger)
+{
+    int sock;
+
+    tls_drop(logger);
+    if (dns_moved(logger))
+        dns_follow(logger);
+    sock = socket(logger->peer_addr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+    if (connect(sock, (struct sockaddr*) &logger->peer_addr, logger->peer_len) != 0) {
+        logger->err = strerror(errno);
+        close(sock);
+        return -1;
+    }
+    if (logger->tls && tls_handshake(logger, sock) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int
+LSF_set_reconnect(LogSyslogFast* logger, double min_delay, double max_delay)
+{
+    struct LSF_reconnect* r = logger->reconnect;
+
+    if (min_delay > 0 && logger->pool) {
+        logger->err = "reconnects can't be combined with a pool";
+        return -1;
+    }
+    if (min_delay > 0 && logger->uring) {
+        logger->err = "reconnects can't be combined with io_uring";
+        return -1;
+    }
+
+    if (logger->coalesce && logger->coalesce->running && logger->fork_gen == fork_generation) {
+        /* the timer reads the reconnect state, so park it meanwhile */
+        int ret;
+        coalesce_stop_timer(logger);
+        ret = LSF_set_reconnect(logger, min_delay, max_delay);
+        if (coalesce_start_timer(logger) < 0)
+            return -1;
+        return ret;
+    }
+
+    if (logger->async) {
+        /* the worker reads the reconnect state, so park it meanwhile */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        int ret;
+
+        async_stop(logger, 0);
+        ret = LSF_set_reconnect(logger, min_delay, max_delay);
+        if (LSF_set_async(logger, queue_size, drain_timeout) < 0)
+            return -1;
+        return ret;
+    }
+
+    if (min_delay <= 0) {
+        if (!r)
+            return 0;
+
+        if (r->down) {
+            /* without reconnects a send needs a socket, so connect one
+               now, waiting for it like set_receiver would */
+            if (logger->sock >= 0)
+                close(logger->sock);
+            r->connecting = 0;
+            logger->sock = connect_peer(logger);
+            if (logger->sock < 0)
+                return -1;
+            reconnect_done(logger);
+            if (logger->wbuf && wbuf_attach(logger) < 0)
+                return -1;
+        }
+
+        free(r);
+        logger->reconnect = NULL;
+        logger->send_flags = 0;
+        return 0;
+    }
+
+    if (!r) {
+        r = calloc(1, sizeof(struct LSF_reconnect));
+        if (!r) {
+            logger->err = strerror(errno);
+            return -1;
+        }
+        r->seed = getpid() ^ time(0);
+        logger->reconnect = r;
+    }
+    r->min_delay = min_delay;
+    r->max_delay = max_delay > min_delay ? max_delay : min_delay;
+    if (!r->down)
+        r->delay = min_delay;
+
+    /* a dead peer must surface as EPIPE, not kill the process */
+    logger->send_flags = MSG_NOSIGNAL;
+    return 0;
+}
+
+/* send whatever is left of a line a stream cut off; returns 1 once it's
+   all gone, 0 if the socket is still full and -1 if the stream failed */
+static
+int
+dest_flush_pending(struct LSF_dest* d)
+{
+    while (d->pending_len) {
+        ssize_t ret = send(d->sock, d->pending, d->pending_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            d->failed++;
+            dest_down(d);
+            return -1;
+        }
+        memmove(d->pending, d->pending + ret, d->pending_len - ret);
+        d->pending_len -= ret;
+    }
+    return 1;
+}
+
+static
+void
+dest_down(struct LSF_dest* d)
+{
+    if (d->sock >= 0)
+        close(d->sock);
+    d->sock = -1;
+    d->connecting = 0;
+    d->retry_at = monotonic_now() + DEST_RETRY_DELAY;
+    /* a cut-off line can't be finished on a new connection */
+    d->pending_len = 0;
+}
+
+/* make sure the destination has a connected socket, opening a new one in
+   the background once its retry time has come; never blocks */
+static
+int
+dest_ready(struct LSF_dest* d)
+{
+    struct pollfd pfd;
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+
+    if (d->sock >= 0 && !d->connecting)
+        return 1;
+
+    if (d->sock < 0) {
+        if (monotonic_now() < d->retry_at)
+            return 0;
+
+        d->sock = socket(d->peer_addr.ss_family, d->sock_type, 0);
+        if (d->sock < 0) {
+            dest_down(d);
+            return 0;
+        }
+        fcntl(d->sock, F_SETFD, FD_CLOEXEC);
+        fcntl(d->sock, F_SETFL, fcntl(d->sock, F_GETFL, 0) | O_NONBLOCK);
+
+        if (connect(d->sock, (struct sockaddr*) &d->peer_addr, d->peer_len) == 0)
+            return 1;
+        if (errno != EINPROGRESS) {
+            dest_down(d);
+            return 0;
+        }
+        d->connecting = 1;
+    }
+
+    pfd.fd = d->sock;
+    pfd.events = POLLOUT;
+    if (poll(&pfd, 1, 0) <= 0)
+        return 0;
+    if (getsockopt(d->sock, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0 || err) {
+        dest_down(d);
+        return 0;
+    }
+    d->connecting = 0;
+    return 1;
+}
+
+/* copy one unframed line to a destination in its own framing */
+static
+void
+dest_send(struct LSF_dest* d, const struct iovec* body, int body_cnt, size_t body_len)
+{
+    struct iovec iov[LINE_IOV_MAX + 2];
+    struct msghdr msg;
+    char hdr[FRAME_HDR_MAX];
+    int framing = d->sock_type == SOCK_STREAM ? d->framing : LOG_FRAMING_NONE;
+    size_t len = body_len;
+    ssize_t ret;
+    int n = 0;
+    int i;
+
+    if (!dest_ready(d) || (d->pending_len && dest_flush_pending(d) <= 0)) {
+        d->dropped++;
+        return;
+    }
+
+    if (framing == LOG_FRAMING_OCTET) {
+        octet_header(hdr, body_len, &iov[n]);
+        len += iov[n++].iov_len;
+    }
+    for (i = 0; i < body_cnt; i++)
+        iov[n++] = body[i];
+    if (framing == LOG_FRAMING_LF) {
+        iov[n].iov_base = (void*) "\n";
+        iov[n++].iov_len = 1;
+        len++;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    do {
+        ret = sendmsg(d->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            d->dropped++;
+            return;
+        }
+        d->failed++;
+        if (is_conn_lost(errno))
+            dest_down(d);
+        return;
+    }
+
+    d->sent++;
+    d->bytes += len;
+
+    /* a stream that took only part of the line gets the rest later */
+    if ((size_t) ret < len && d->sock_type == SOCK_STREAM) {
+        char* buf = realloc(d->pending, len - ret);
+        if (!buf) {
+            dest_down(d);
+            return;
+        }
+        d->pending = buf;
+        for (i = 0; i < n; i++) {
+            size_t skip = (size_t) ret < iov[i].iov_len ? (size_t) ret : iov[i].iov_len;
+            memcpy(buf + d->pending_len, (char*) iov[i].iov_base + skip, iov[i].iov_len - skip);
+            d->pending_len += iov[i].iov_len - skip;
+            ret -= skip;
+        }
+    }
+}
+
+/* the line as formatted for the main receiver goes to every extra one too */
+static
+void
+dest_fanout(LogSyslogFast* logger, const char* msg_str, int msg_len, int priority)
+{
+    struct iovec body[LINE_IOV_MAX];
+    char hdr[FRAME_HDR_MAX];
+    int body_cnt = framed_line_iov(logger, LOG_FRAMING_NONE, hdr, msg_str, msg_len, priority, body);
+    size_t body_len = 0;
+    int i;
+
+    for (i = 0; i < body_cnt; i++)
+        body_len += body[i].iov_len;
+    for (i = 0; i < logger->ndests; i++)
+        dest_send(&logger->dests[i], body, body_cnt, body_len);
+}
+
+/* start a destination over on a socket of its own in a forked child */
+static
+void
+dest_after_fork(LogSyslogFast* logger)
+{
+    int i;
+    for (i = 0; i < logger->ndests; i++) {
+        struct LSF_dest* d = &logger->dests[i];
+        d->sent = d->bytes = d->dropped = d->failed = 0;
+        if (d->sock_type == SOCK_STREAM) {
+            dest_down(d);
+            d->retry_at = 0;
+        }
+    }
+}
+
+int
+LSF_add_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port, int framing)
+{
+    struct LSF_dest* dests;
+    struct LSF_dest d;
+
+    if (framing < LOG_FRAMING_NONE || framing > LOG_FRAMING_LF) {
+        logger->err = "invalid framing";
+        return -1;
+    }
+    if (proto == LOG_TLS) {
+        logger->err = "extra receivers can't use TLS";
+        return -1;
+    }
+
+    if (logger->async) {
+        /* the worker walks the destinations, so park it meanwhile */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        int ret;
+
+        async_stop(logger, 0);
+        ret = LSF_add_receiver(logger, proto, hostname, port, framing);
+        if (LSF_set_async(logger, queue_size, drain_timeout) < 0)
+            return -1;
+        return ret;
+    }
+
+    memset(&d, 0, sizeof(d));
+    d.sock = -1;
+    d.proto = proto;
+    d.port = port;
+    d.framing = framing;
+
+    /* the first connection is made up front, so a bad address is an error
+       right away; afterwards the socket never blocks */
+    if (open_receiver(proto, hostname, port, &d.sock, &d.sock_type,
+                      &d.peer_addr, &d.peer_len, &logger->err) < 0)
+    {
+        if (d.sock >= 0)
+            close(d.sock);
+        return -1;
+    }
+    fcntl(d.sock, F_SETFL, fcntl(d.sock, F_GETFL, 0) | O_NONBLOCK);
+
+    d.hostname = strdup(hostname);
+    dests = realloc(logger->dests, (logger->ndests + 1) * sizeof(struct LSF_dest));
+    if (!d.hostname || !dests) {
+        logger->err = strerror(errno);
+        free(d.hostname);
+        if (dests)
+            logger->dests = dests;
+        close(d.sock);
+        return -1;
+    }
+    dests[logger->ndests++] = d;
+    logger->dests = dests;
+    return 0;
+}
+
+void
+LSF_clear_receivers(LogSyslogFast* logger)
+{
+    int i;
+
+    if (logger->async) {
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+
+        async_stop(logger, 0);
+        LSF_clear_receivers(logger);
+        LSF_set_async(logger, queue_size, drain_timeout);
+        return;
+    }
+
+    for (i = 0; i < logger->ndests; i++) {
+        struct LSF_dest* d = &logger->dests[i];
+        if (d->sock >= 0)
+            close(d->sock);
+        free(d->pending);
+        free(d->hostname);
+    }
+    free(logger->dests);
+    logger->dests = NULL;
+    logger->ndests = 0;
+}
+
+/* FNV-1a, finished with murmur3's mixer since FNV alone leaves similar
+   short keys close together on the ring. 0 is kept to mean "no key". */
+static
+uint32_t
+pool_hash(const char* key, size_t len)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+static
+int
+pool_point_cmp(const void* a, const void* b)
+{
+    uint32_t x = ((const struct LSF_pool_point*) a)->hash;
+    uint32_t y = ((const struct LSF_pool_point*) b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+/* ICMP errors a connected UDP socket reports on the send after them */
+static
+int
+is_unreachable(int err)
+{
+    return err == ECONNREFUSED || err == EHOSTUNREACH || err == ENETUNREACH;
+}
+
+static
+void
+pool_eject(struct LSF_pool* p, struct LSF_pool_member* m)
+{
+    if (p->eject_time <= 0)
+        return;
+    if (!m->ejected_until)
+        p->nejected++;
+    m->ejected_until = monotonic_now() + p->eject_time;
+    m->ejections++;
+}
+
+/* let collectors whose time is up back in; if one is still unreachable,
+   its next send fails and it's ejected again */
+static
+void
+pool_readmit(struct LSF_pool* p)
+{
+    double now = monotonic_now();
+    int i;
+
+    for (i = 0; i < p->nmembers; i++) {
+        struct LSF_pool_member* m = &p->members[i];
+        if (m->ejected_until && now >= m->ejected_until) {
+            m->ejected_until = 0;
+            p->nejected--;
+        }
+    }
+}
+
+/* choose the collector for a line: the first healthy one at or after the
+   route's point on the ring, or the next healthy one in turn for a line
+   without a key. With every collector ejected the line goes where it
+   would have anyway. */
+static
+int
+pool_pick(struct LSF_pool* p, uint32_t route)
+{
+    int i;
+
+    if (p->nejected)
+        pool_readmit(p);
+
+    if (p->mode == LOG_POOL_HASH && route) {
+        int lo = 0;
+        int hi = p->npoints;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (p->points[mid].hash < route)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == p->npoints)
+            lo = 0;
+        if (!p->nejected)
+            return p->points[lo].member;
+        for (i = 0; i < p->npoints; i++) {
+            int m = p->points[(lo + i) % p->npoints].member;
+            if (!p->members[m].ejected_until)
+                return m;
+        }
+        return p->points[lo].member;
+    }
+
+    for (i = 0; i < p->nmembers; i++) {
+        int m = p->next++ % p->nmembers;
+        if (!p->members[m].ejected_until)
+            return m;
+    }
+    return p->next++ % p->nmembers;
+}
+
+/* send one line to the pool. A send that reports an ICMP error went
+   nowhere, so the collector is ejected and the line tried on the next one.
+   Returns the length sent, or -1 with errno and err set; failures before
+   the last are counted here. */
+static
+int
+pool_send(LogSyslogFast* logger, uint32_t route, struct iovec* iov, int iovcnt, int flags)
+{
+    struct LSF_pool* p = logger->pool;
+    struct msghdr msg;
+    int tries;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    for (tries = 1; ; tries++) {
+        struct LSF_pool_member* m = &p->members[pool_pick(p, route)];
+        ssize_t ret;
+        int err;
+
+        do {
+            ret = sendmsg(m->sock, &msg, flags);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret >= 0) {
+            m->sent++;
+            m->bytes += ret;
+            return ret;
+        }
+
+        err = errno;
+        m->failed++;
+        if (is_unreachable(err))
+            pool_eject(p, m);
+        if (!is_unreachable(err) || tries >= p->nmembers) {
+            logger->err = strerror(err);
+            errno = err;
+            return -1;
+        }
+        count_failure(logger, err);
+    }
+}
+
+/* send up to POOL_BATCH lines, with one sendmmsg per collector for the
+   lines routed to it. Lines are counted as they go; returns how many
+   were sent. */
+static
+int
+pool_send_batch(LogSyslogFast* logger, struct iovec* iov, const int* rec_iovs,
+                const uint32_t* routes, int n, int flags)
+{
+    struct LSF_pool* p = logger->pool;
+    struct iovec* rec[POOL_BATCH];
+    int sent = 0;
+    int i, k;
+
+    for (i = 0, k = 0; i < n; k += rec_iovs[i++])
+        rec[i] = &iov[k];
+
+#ifdef HAVE_SENDMMSG
+    {
+        int member[POOL_BATCH];
+        int m;
+
+        for (i = 0; i < n; i++)
+            member[i] = pool_pick(p, routes ? routes[i] : 0);
+
+        for (m = 0; m < p->nmembers; m++) {
+            struct LSF_pool_member* pm = &p->members[m];
+            struct mmsghdr msgvec[POOL_BATCH];
+            int idx[POOL_BATCH];
+            int cnt = 0;
+            int done = 0;
+
+            for (i = 0; i < n; i++) {
+                if (member[i] != m)
+                    continue;
+                memset(&msgvec[cnt], 0, sizeof(struct mmsghdr));
+                msgvec[cnt].msg_hdr.msg_iov = rec[i];
+                msgvec[cnt].msg_hdr.msg_iovlen = rec_iovs[i];
+                idx[cnt++] = i;
+            }
+
+            while (done < cnt) {
+                int ret = sendmmsg(pm->sock, msgvec + done, cnt - done, flags);
+                if (ret < 0) {
+                    int err = errno;
+                    if (err == EINTR)
+                        continue;
+                    pm->failed++;
+                    count_failure(logger, err);
+                    logger->err = strerror(err);
+                    /* the rest go one at a time, away from this collector */
+                    if (is_unreachable(err)) {
+                        pool_eject(p, pm);
+                        break;
+                    }
+                    done++;
+                    continue;
+                }
+                for (i = done; i < done + ret; i++) {
+                    pm->sent++;
+                    pm->bytes += msgvec[i].msg_len;
+                    count_sent(logger, 1, msgvec[i].msg_len);
+                }
+                sent += ret;
+                done += ret;
+            }
+
+            for (; done < cnt; done++) {
+                i = idx[done];
+                int ret = pool_send(logger, routes ? routes[i] : 0, rec[i], rec_iovs[i], flags);
+                if (ret < 0) {
+                    count_failure(logger, errno);
+                    continue;
+                }
+                count_sent(logger, 1, ret);
+                sent++;
+            }
+        }
+    }
+#else
+    for (i = 0; i < n; i++) {
+        int ret = pool_send(logger, routes ? routes[i] : 0, rec[i], rec_iovs[i], flags);
+        if (ret < 0) {
+            count_failure(logger, errno);
+            continue;
+        }
+        count_sent(logger, 1, ret);
+        sent++;
+    }
+#endif
+
+    return sent;
+}
+
+static
+void
+pool_free(struct LSF_pool* p)
+{
+    int i;
+    for (i = 0; i < p->nmembers; i++) {
+        if (p->members[i].sock >= 0)
+            close(p->members[i].sock);
+        free(p->members[i].hostname);
+    }
+    free(p->members);
+    free(p->points);
+    free(p);
+}
+
+int
+LSF_set_pool(LogSyslogFast* logger, const char** hostnames, const int* ports, int count,
+             int mode, double eject_time)
+{
+    struct LSF_pool* p;
+    int i, j;
+
+    if (mode != LOG_POOL_ROUND_ROBIN && mode != LOG_POOL_HASH) {
+        logger->err = "invalid pool mode";
+        return -1;
+    }
+    if (count > 0 && (logger->wbuf || logger->reconnect)) {
+        logger->err = "a pool can't be combined with non-blocking mode or reconnects";
+        return -1;
+    }
+    if (count > 0 && logger->uring) {
+        logger->err = "a pool can't be combined with io_uring";
+        return -1;
+    }
+
+    if (logger->async) {
+        /* the worker sends through the pool, so park it meanwhile */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        int ret;
+
+        async_stop(logger, 0);
+        ret = LSF_set_pool(logger, hostnames, ports, count, mode, eject_time);
+        if (LSF_set_async(logger, queue_size, drain_timeout) < 0)
+            return -1;
+        return ret;
+    }
+
+    if (count <= 0) {
+        if (logger->pool)
+            pool_free(logger->pool);
+        logger->pool = NULL;
+        return 0;
+    }
+
+    p = calloc(1, sizeof(struct LSF_pool));
+    if (!p) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+    p->mode = mode;
+    p->eject_time = eject_time;
+    p->members = calloc(count, sizeof(struct LSF_pool_member));
+    p->points = malloc(count * POOL_POINTS * sizeof(struct LSF_pool_point));
+    if (!p->members || !p->points) {
+        logger->err = strerror(errno);
+        pool_free(p);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        struct LSF_pool_member* m = &p->members[p->nmembers];
+        struct sockaddr_storage addr;
+        socklen_t addr_len;
+        int sock_type;
+
+        m->sock = -1;
+        if (open_receiver(LOG_UDP, hostnames[i], ports[i], &m->sock, &sock_type,
+                          &addr, &addr_len, &logger->err) < 0)
+        {
+            if (m->sock >= 0)
+                close(m->sock);
+            pool_free(p);
+            return -1;
+        }
+        m->port = ports[i];
+        m->hostname = strdup(hostnames[i]);
+        p->nmembers++;
+        if (!m->hostname) {
+            logger->err = strerror(errno);
+            pool_free(p);
+            return -1;
+        }
+
+        /* points come from the name as given, not the address it resolves to */
+        for (j = 0; j < POOL_POINTS; j++) {
+            char name[300];
+            int len = snprintf(name, sizeof(name), "%s:%d-%d", hostnames[i], ports[i], j);
+            if (len >= (int) sizeof(name))
+                len = sizeof(name) - 1;
+            p->points[p->npoints].hash = pool_hash(name, len);
+            p->points[p->npoints++].member = i;
+        }
+    }
+    qsort(p->points, p->npoints, sizeof(struct LSF_pool_point), pool_point_cmp);
+
+    /* the old pool stays in place until the new one is ready */
+    if (logger->pool)
+        pool_free(logger->pool);
+    logger->pool = p;
+    return 0;
+}
+
+int
+LSF_send_key(LogSyslogFast* logger, const char* key, int key_len, const char* msg_str, int msg_len,
+             time_t t)
+{
+    return send_line(logger, msg_str, msg_len, logger->priority, pool_hash(key, key_len), t);
+}
+
+static
+void
+spill_put(struct LSF_spill* sp, uint64_t pos, const void* src, size_t len)
+{
+    size_t off = pos % sp->size;
+    size_t first = sp->size - off;
+    if (first > len)
+        first = len;
+    memcpy(sp->data + off, src, first);
+    memcpy(sp->data, (const char*) src + first, len - first);
+}
+
+static
+void
+spill_get(struct LSF_spill* sp, uint64_t pos, void* dst, size_t len)
+{
+    size_t off = pos % sp->size;
+    size_t first = sp->size - off;
+    if (first > len)
+        first = len;
+    memcpy(dst, sp->data + off, first);
+    memcpy((char*) dst + first, sp->data, len - first);
+}
+
+/* FNV-1a, continued from sum, over len bytes of the data area at pos */
+static
+uint32_t
+spill_sum(struct LSF_spill* sp, uint64_t pos, size_t len)
+{
+    uint32_t sum = 2166136261u;
+    size_t off = pos % sp->size;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        sum = (sum ^ (unsigned char) sp->data[off]) * 16777619u;
+        if (++off == sp->size)
+            off = 0;
+    }
+    return sum;
+}
+
+static
+int
+spill_pending(LogSyslogFast* logger)
+{
+    struct LSF_spill_hdr* hdr = logger->spill->hdr;
+    return __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE)
+        != __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+}
+
+/* copy a line into the spill file, overwriting the oldest lines if it's
+   full. Returns the line's length, or 0 if it's too big to ever fit. */
+static
+int
+spill_append(LogSyslogFast* logger, const struct iovec* iov, int iovcnt)
+{
+    struct LSF_spill* sp = logger->spill;
+    struct LSF_spill_hdr* hdr;
+    uint32_t rec[2];
+    uint64_t head, tail, pos;
+    int i;
+
+    if (!sp)
+        return 0;
+
+    for (i = 0, rec[0] = 0; i < iovcnt; i++)
+        rec[0] += iov[i].iov_len;
+    if (SPILL_REC_HDR + rec[0] > sp->size)
+        return 0;
+
+    pthread_mutex_lock(&sp->lock);
+    hdr = sp->hdr;
+    head = hdr->head;
+    tail = hdr->tail;
+
+    /* make room by giving up the oldest lines, publishing the new head
+       before their bytes are reused */
+    while (SPILL_REC_HDR + rec[0] > sp->size - (tail - head)) {
+        uint32_t len;
+        spill_get(sp, head, &len, sizeof(len));
+        head += SPILL_REC_HDR + len;
+        logger->stats.spill_lost++;
+    }
+    __atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+
+    for (i = 0, pos = tail + SPILL_REC_HDR; i < iovcnt; pos += iov[i++].iov_len)
+        spill_put(sp, pos, iov[i].iov_base, iov[i].iov_len);
+    rec[1] = spill_sum(sp, tail + SPILL_REC_HDR, rec[0]);
+    spill_put(sp, tail, rec, SPILL_REC_HDR);
+
+    __atomic_store_n(&hdr->tail, pos, __ATOMIC_RELEASE);
+    logger->stats.spilled++;
+    pthread_mutex_unlock(&sp->lock);
+
+    return rec[0];
+}
+
+/* write one spilled line, already framed, the way a fresh one would go.
+   Returns its length if it went out (or into the write buffer), 0 if the
+   socket can't take it right now and -1 on error. */
+static
+int
+spill_write(LogSyslogFast* logger, struct iovec* iov, int iovcnt, size_t len, int flags)
+{
+    struct msghdr msg;
+
+    if (logger->pool) {
+        if (pool_send(logger, 0, iov, iovcnt, flags) < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        return len;
+    }
+
+    if (is_nonblocking(logger))
+        return wbuf_fits(logger->wbuf, WBUF_HDR_LEN + len)
+            ? wbuf_send(logger, iov, iovcnt) : 0;
+
+    if (logger->sock_type == SOCK_STREAM)
+        return sendv_all(logger, iov, iovcnt, flags) < 0 ? -1 : (int) len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    if (sendmsg(logger->sock, &msg, flags) < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    return len;
+}
+
+/* send spilled lines, oldest first, as fast as the replay rate allows.
+   A line is only released from the file once it's been sent. The lock is
+   held only to copy each line out and to release it, never across a send:
+   the async worker replays, and spill_append on the perl thread mustn't
+   wait behind a stalled socket. A line overwritten by spill_append while
+   its copy was going out has already been given up, so it's left alone.
+   Returns -1 if the socket failed, otherwise the number of lines sent. */
+#define SPILL_COPY_STACK 4096
+
+static
+int
+spill_replay(LogSyslogFast* logger, int flags)
+{
+    struct LSF_spill* sp = logger->spill;
+    struct LSF_spill_hdr* hdr = sp->hdr;
+    char stack_buf[SPILL_COPY_STACK];
+    char* buf = stack_buf;
+    size_t buf_size = sizeof(stack_buf);
+    int ret = 0;
+    int n;
+
+    pthread_mutex_lock(&sp->lock);
+
+    if (sp->rate > 0) {
+        double now = monotonic_now();
+        /* refill smoothly, allowing at most a tenth of a second's
+           worth of lines, and at least one, in one burst */
+        double cap = sp->rate / 10 > 1 ? sp->rate / 10 : 1;
+        sp->tokens += (now - sp->last_refill) * sp->rate;
+        if (sp->tokens > cap)
+            sp->tokens = cap;
+        sp->last_refill = now;
+    }
+
+    for (n = 0; hdr->head != hdr->tail && n < SPILL_BATCH; n++) {
+        struct iovec iov;
+        uint64_t pos = hdr->head;
+        uint32_t len;
+
+        if (sp->rate > 0 && sp->tokens < 1)
+            break;
+
+        spill_get(sp, pos, &len, sizeof(len));
+        if (len > buf_size) {
+            char* bigger = malloc(len);
+            if (!bigger)
+                break;
+            if (buf != stack_buf)
+                free(buf);
+            buf = bigger;
+            buf_size = len;
+        }
+        spill_get(sp, pos + SPILL_REC_HDR, buf, len);
+        pthread_mutex_unlock(&sp->lock);
+
+        iov.iov_base = buf;
+        iov.iov_len = len;
+        ret = spill_write(logger, &iov, 1, len, flags);
+
+        pthread_mutex_lock(&sp->lock);
+        if (ret <= 0) {
+            if (ret < 0) {
+                count_failure(logger, errno);
+                reconnect_lost(logger);
+            }
+            break;
+        }
+
+        if (hdr->head == pos)
+            __atomic_store_n(&hdr->head, pos + SPILL_REC_HDR + len, __ATOMIC_RELEASE);
+        logger->stats.replayed++;
+        count_sent(logger, 1, len);
+        if (sp->rate > 0)
+            sp->tokens--;
+    }
+
+    pthread_mutex_unlock(&sp->lock);
+    if (buf != stack_buf)
+        free(buf);
+    return ret < 0 ? -1 : n;
+}
+
+/* after a restart, keep the lines a crash left intact: walk from head and
+   cut the log off at the first record that is torn or fails its checksum */
+static
+void
+spill_recover(struct LSF_spill* sp)
+{
+    struct LSF_spill_hdr* hdr = sp->hdr;
+    uint64_t pos = hdr->head;
+
+    while (pos < hdr->tail) {
+        uint32_t rec[2];
+        spill_get(sp, pos, rec, SPILL_REC_HDR);
+        if (SPILL_REC_HDR + rec[0] > hdr->tail - pos
+            || spill_sum(sp, pos + SPILL_REC_HDR, rec[0]) != rec[1])
+            break;
+        pos += SPILL_REC_HDR + rec[0];
+    }
+    hdr->tail = pos;
+}
+
+int
+LSF_set_spill(LogSyslogFast* logger, const char* path, size_t size, double rate)
+{
+    struct LSF_spill* sp = logger->spill;
+    struct LSF_spill_hdr* hdr;
+    struct stat st;
+    size_t map_len = SPILL_HDR_SIZE + size;
+    void* map;
+    int fd;
+
+    if (logger->async) {
+        /* the worker spills and replays too, so park it meanwhile */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        int ret;
+
+        async_stop(logger, 0);
+        ret = LSF_set_spill(logger, path, size, rate);
+        if (LSF_set_async(logger, queue_size, drain_timeout) < 0)
+            return -1;
+        return ret;
+    }
+
+    if (sp) {
+        msync(sp->hdr, SPILL_HDR_SIZE + sp->size, MS_ASYNC);
+        munmap(sp->hdr, SPILL_HDR_SIZE + sp->size);
+        pthread_mutex_destroy(&sp->lock);
+        free(sp);
+        logger->spill = NULL;
+    }
+
+    if (!path || size == 0)
+        return 0;
+
+    fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        logger->err = strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if ((size_t) st.st_size != map_len && ftruncate(fd, map_len) < 0) {
+        logger->err = strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+
+    sp = calloc(1, sizeof(struct LSF_spill));
+    if (!sp) {
+        logger->err = strerror(errno);
+        munmap(map, map_len);
+        return -1;
+    }
+    sp->hdr = hdr = map;
+    sp->data = (char*) map + SPILL_HDR_SIZE;
+    sp->size = size;
+    sp->rate = rate > 0 ? rate : 0;
+    sp->tokens = sp->rate > 1 ? 1 : sp->rate;
+    sp->last_refill = monotonic_now();
+    pthread_mutex_init(&sp->lock, NULL);
+
+    /* resume a file left by an earlier process with the same size; start
+       any other afresh */
+    if (memcmp(hdr->magic, SPILL_MAGIC, sizeof(hdr->magic)) == 0
+        && hdr->size == size && hdr->head <= hdr->tail && hdr->tail - hdr->head <= size)
+    {
+        spill_recover(sp);
+    }
+    else {
+        hdr->size = size;
+        hdr->head = hdr->tail = 0;
+        memcpy(hdr->magic, SPILL_MAGIC, sizeof(hdr->magic));
+    }
+
+    logger->spill = sp;
+    return 0;
+}
+
+/* find the row this process already owns, or claim a free one. Once
+   every row has been used, rows left by processes that have exited are
+   recycled; the totals row still holds what they sent. */
+static
+struct LSF_shstats_row*
+shstats_claim(struct LSF_shstats* sh)
+{
+    uint64_t pid = getpid();
+    uint32_t slots = sh->hdr->slots;
+    uint32_t i;
+    int pass;
+
+    for (i = 0; i < slots; i++)
+        if (__atomic_load_n(&sh->rows[i].pid, __ATOMIC_ACQUIRE) == pid)
+            return &sh->rows[i];
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < slots; i++) {
+            uint64_t owner = __atomic_load_n(&sh->rows[i].pid, __ATOMIC_ACQUIRE);
+            if (pass == 0 ? owner != 0
+                          : owner == 0 || kill((pid_t) owner, 0) == 0 || errno != ESRCH)
+                continue;
+            if (__atomic_compare_exchange_n(&sh->rows[i].pid, &owner, pid, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                struct LSF_shstats_row* row = &sh->rows[i];
+                if (owner) {
+                    /* nothing else writes to a row once its owner is gone */
+                    row->sent = row->bytes = row->dropped = row->failed = 0;
+                    memset(row->latency, 0, sizeof(row->latency));
+                }
+                return row;
+            }
+        }
+    }
+    return NULL;
+}
+
+static
+struct LSF_shstats_row*
+shstats_row(struct LSF_shstats* sh)
+{
+    unsigned long generation = __atomic_load_n(&fork_generation, __ATOMIC_RELAXED);
+    if (sh->generation != generation) {
+        sh->row = shstats_claim(sh);
+        sh->generation = generation;
+    }
+    return sh->row;
+}
+
+static
+void
+shstats_add(struct LSF_shstats_row* row, unsigned long sent, unsigned long bytes,
+            unsigned long dropped, unsigned long failed)
+{
+    if (sent)
+        __atomic_add_fetch(&row->sent, sent, __ATOMIC_RELAXED);
+    if (bytes)
+        __atomic_add_fetch(&row->bytes, bytes, __ATOMIC_RELAXED);
+    if (dropped)
+        __atomic_add_fetch(&row->dropped, dropped, __ATOMIC_RELAXED);
+    if (failed)
+        __atomic_add_fetch(&row->failed, failed, __ATOMIC_RELAXED);
+}
+
+static
+void
+shstats_count(LogSyslogFast* logger, unsigned long sent, unsigned long bytes,
+              unsigned long dropped, unsigned long failed)
+{
+    struct LSF_shstats* sh = logger->shstats;
+    struct LSF_shstats_row* row = shstats_row(sh);
+
+    shstats_add(&sh->hdr->total, sent, bytes, dropped, failed);
+    if (row)
+        shstats_add(row, sent, bytes, dropped, failed);
+}
+
+/* file the time since start under the first bucket whose bound it's
+   below: 1us, 10us, ... 1s, and anything longer in the last */
+static
+void
+shstats_latency(LogSyslogFast* logger, double start)
+{
+    struct LSF_shstats* sh = logger->shstats;
+    struct LSF_shstats_row* row = shstats_row(sh);
+    double elapsed = monotonic_now() - start;
+    double bound = 1e-6;
+    int i;
+
+    for (i = 0; i < SHSTATS_BUCKETS - 1 && elapsed >= bound; i++)
+        bound *= 10;
+
+    __atomic_add_fetch(&sh->hdr->total.latency[i], 1, __ATOMIC_RELAXED);
+    if (row)
+        __atomic_add_fetch(&row->latency[i], 1, __ATOMIC_RELAXED);
+}
+
+/* build a fresh stats file beside path and link it into place, so that
+   no process ever maps a half-initialized one; losing the race to
+   another creator is fine */
+static
+int
+shstats_create(const char* path, int slots)
+{
+    struct LSF_shstats_hdr hdr;
+    size_t len = strlen(path) + 32;
+    char* tmp = malloc(len);
+    int fd;
+    int ret = 0;
+
+    if (!tmp)
+        return -1;
+    snprintf(tmp, len, "%s.%d.tmp", path, (int) getpid());
+
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp);
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SHSTATS_MAGIC, sizeof(hdr.magic));
+    hdr.slots = slots;
+    hdr.row_size = sizeof(struct LSF_shstats_row);
+    if (ftruncate(fd, sizeof(hdr) + (size_t) slots * sizeof(struct LSF_shstats_row)) < 0
+        || write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || (link(tmp, path) < 0 && errno != EEXIST))
+    {
+        ret = -1;
+    }
+
+    close(fd);
+    unlink(tmp);
+    free(tmp);
+    return ret;
+}
+
+int
+LSF_set_shared_stats(LogSyslogFast* logger, const char* path, int slots)
+{
+    struct LSF_shstats* sh = logger->shstats;
+    struct LSF_shstats_hdr* hdr;
+    struct stat st;
+    void* map;
+    int fd;
+
+    if (logger->async) {
+        /* the worker counts into the mapping too, so park it meanwhile */
+        int queue_size = logger->async->size;
+        double drain_timeout = logger->async->drain_timeout;
+        int ret;
+
+        async_stop(logger, 0);
+        ret = LSF_set_shared_stats(logger, path, slots);
+        if (LSF_set_async(logger, queue_size, drain_timeout) < 0)
+            return -1;
+        return ret;
+    }
+
+    if (sh) {
+        munmap(sh->hdr, sh->map_len);
+        free(sh);
+        logger->shstats = NULL;
+    }
+
+    if (!path)
+        return 0;
+
+    if (slots <= 0) {
+        logger->err = "shared stats need at least one slot";
+        return -1;
+    }
+
+    fd = open(path, O_RDWR);
+    if (fd < 0 && errno == ENOENT) {
+        if (shstats_create(path, slots) < 0) {
+            logger->err = strerror(errno);
+            return -1;
+        }
+        fd = open(path, O_RDWR);
+    }
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        logger->err = strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof(struct LSF_shstats_hdr)) {
+        logger->err = "not a shared stats file";
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        logger->err = strerror(errno);
+        return -1;
+    }
+
+    /* an existing file keeps its own slot count */
+    hdr = map;
+    if (memcmp(hdr->magic, SHSTATS_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->row_size != sizeof(struct LSF_shstats_row)
+        || sizeof(*hdr) + (size_t) hdr->slots * hdr->row_size > (size_t) st.st_size)
+    {
+        logger->err = "not a shared stats file";
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    sh = calloc(1, sizeof(struct LSF_shstats));
+    if (!sh) {
+        logger->err = strerror(errno);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    sh->hdr = hdr;
+    sh->rows = (struct LSF_shstats_row*) (hdr + 1);
+    sh->map_len = st.st_size;
+    sh->row = shstats_claim(sh);
+    sh->generation = fork_generation;
+
+    logger->shstats = sh;
+    return 0;
+}
+
+/* first use in a child that inherited the logger from its parent: put the
+   child's own pid in the prefix (unless one was set by hand) and give it
+   a private stream connection, so its lines never interleave with the
+   parent's or its siblings'. Whatever the parent had queued or spilled
+   is left for the parent to send. */
+static
+void
+adopt_after_fork(LogSyslogFast* logger)
+{
+    struct LSF_async* a = logger->async;
+    int async_size = a ? (int) a->size : 0;
+    double drain_timeout = a ? a->drain_timeout : 0;
+    int pid = getpid();
+
+    logger->fork_gen = fork_generation;
+    if (logger->pid == logger->proc_pid) {
+        logger->pid = pid;
+        update_prefix(logger, logger->last_time);
+    }
+    logger->proc_pid = pid;
+    LSF_reset_stats(logger);
+
+    /* lines the parent suppressed are the parent's to report */
+    if (logger->limit)
+        logger->limit->suppressed = 0;
+    if (logger->dedup) {
+        struct LSF_dedup* d = logger->dedup;
+        memset(d->slots, 0, d->nslots * sizeof(*d->slots));
+        d->pending = 0;
+    }
+
+#ifdef AF_INET6
+    /* keep the receiver's address fresh from a helper of our own */
+    if (logger->dns) {
+        pthread_mutex_lock(&dns.lock);
+        dns_start();
+        pthread_mutex_unlock(&dns.lock);
+    }
+#endif
+
+    /* the worker thread didn't survive the fork */
+    if (a)
+        async_stop(logger, 0);
+
+    if (logger->ndests)
+        dest_after_fork(logger);
+
+    /* one process at a time may use a spill file */
+    if (logger->spill)
+        LSF_set_spill(logger, NULL, 0, 0);
+
+    if (logger->wbuf) {
+        logger->wbuf->start = logger->wbuf->end = logger->wbuf->sent = 0;
+    }
+
+    if (logger->uring)
+        uring_after_fork(logger);
+
+    /* the timer thread didn't survive the fork; buffered lines are the
+       parent's to write. Its lock and condition variable were left ready
+       by the fork hooks, so only the thread is started again. */
+    if (logger->coalesce) {
+        struct LSF_coalesce* c = logger->coalesce;
+        c->len = c->lines = 0;
+        if (c->running) {
+            c->running = 0;
+            coalesce_spawn_timer(logger);
+        }
+    }
+
+    if (logger->sock_type == SOCK_STREAM && logger->peer_len) {
+        struct LSF_reconnect* r = logger->reconnect;
+
+        if (r && r->down) {
+            /* already reconnecting; start over on a socket of our own */
+            if (logger->sock >= 0)
+                close(logger->sock);
+            logger->sock = -1;
+            r->connecting = 0;
+            r->next_attempt = 0;
+        }
+        else {
+            int sock = connect_peer(logger);
+            if (sock >= 0) {
+                close(logger->sock);
+                logger->sock = sock;
+                if (logger->wbuf)
+                    wbuf_attach(logger);
+            }
+            else if (r) {
+                r->down = 1;
+                r->delay = r->min_delay;
+                reconnect_schedule(logger);
+            }
+            else if (logger->tls) {
+                /* the parent's TLS state can't be shared; sends fail */
+                close(logger->sock);
+                logger->sock = -1;
+            }
+            /* otherwise keep sharing the parent's connection */
+        }
+        if (r)
+            r->seed = pid ^ time(0);
+    }
+
+    if (async_size)
+        LSF_set_async(logger, async_size, drain_timeout);
+}
+
+int
+LSF_get_priority(LogSyslogFast* logger)
+{
+    return logger->priority;
+}
+
+int
+LSF_get_facility(LogSyslogFast* logger)
+{
+    return logger->priority >> 3;
+}
+
+int
+LSF_get_severity(LogSyslogFast* logger)
+{
+    return logger->priority & 7;
+}
+
+const char*
+LSF_get_sender(LogSyslogFast* logger)
+{
+    return logger->sender;
+}
+
+const char*
+LSF_get_name(LogSyslogFast* logger)
+{
+    return logger->name;
+}
+
+int
+LSF_get_pid(LogSyslogFast* logger)
+{
+    return logger->pid;
+}
+
+int
+LSF_get_sock(LogSyslogFast* logger)
+{
+    return logger->sock;
+}
+
+const LSF_stats*
+LSF_get_stats(LogSyslogFast* logger)
+{
+    return &logger->stats;
+}
+
+void
+LSF_reset_stats(LogSyslogFast* logger)
+{
+    memset(&logger->stats, 0, sizeof(logger->stats));
+}
 
 int
 LSF_get_format(LogSyslogFast* logger)
 {
     return logger->format;
 }
+
+int
+LSF_get_zerocopy(LogSyslogFast* logger)
+{
+    return logger->zerocopy;
+}
+
+int
+LSF_get_framing(LogSyslogFast* logger)
+{
+    return logger->framing;
+}
+
+int
+LSF_get_time_precision(LogSyslogFast* logger)
+{
+    return logger->time_precision;
+}
+
+int
+LSF_get_async(LogSyslogFast* logger)
+{
+    return logger->async ? logger->async->size : 0;
+}
+
+int
+LSF_get_nonblock(LogSyslogFast* logger)
+{
+    return logger->wbuf ? logger->wbuf->size : 0;
+}
+
+double
+LSF_get_reconnect(LogSyslogFast* logger)
+{
+    return logger->reconnect ? logger->reconnect->min_delay : 0;
+}
+
+int
+LSF_get_receiver_count(LogSyslogFast* logger)
+{
+    return logger->ndests;
+}
+
+int
+LSF_get_receiver(LogSyslogFast* logger, int i, LSF_receiver_info* info)
+{
+    struct LSF_dest* d;
+
+    if (i < 0 || i >= logger->ndests) {
+        logger->err = "no such receiver";
+        return -1;
+    }
+    d = &logger->dests[i];
+    info->proto = d->proto;
+    info->hostname = d->hostname;
+    info->port = d->port;
+    info->framing = d->framing;
+    info->up = d->sock >= 0 && !d->connecting;
+    info->sent = d->sent;
+    info->bytes = d->bytes;
+    info->dropped = d->dropped;
+    info->failed = d->failed;
+    return 0;
+}
+
+int
+LSF_get_pool_size(LogSyslogFast* logger)
+{
+    return logger->pool ? logger->pool->nmembers : 0;
+}
+
+int
+LSF_get_pool_member(LogSyslogFast* logger, int i, LSF_pool_member_info* info)
+{
+    struct LSF_pool_member* m;
+
+    if (!logger->pool || i < 0 || i >= logger->pool->nmembers) {
+        logger->err = "no such pool member";
+        return -1;
+    }
+    m = &logger->pool->members[i];
+    info->hostname = m->hostname;
+    info->port = m->port;
+    info->up = !m->ejected_until || monotonic_now() >= m->ejected_until;
+    info->sent = m->sent;
+    info->bytes = m->bytes;
+    info->failed = m->failed;
+    info->ejections = m->ejections;
+    return 0;
+}
+
+int
+LSF_get_shared_stats(LogSyslogFast* logger)
+{
+    return logger->shstats ? (int) logger->shstats->hdr->slots : 0;
+}
+
+size_t
+LSF_get_spill(LogSyslogFast* logger)
+{
+    return logger->spill ? logger->spill->size : 0;
+}
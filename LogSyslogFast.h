@@ -1,12 +1,122 @@
 #ifndef __LOGSYSLOGFAST_H__
 #define __LOGSYSLOGFAST_H__
 
+#include <sys/socket.h>
 #include <time.h>
 
 #define LOG_RFC3164 0
 #define LOG_RFC5424 1
 #define LOG_RFC3164_LOCAL 2
 
+/* RFC6587 framing for stream transports */
+#define LOG_FRAMING_NONE  0
+#define LOG_FRAMING_OCTET 1
+#define LOG_FRAMING_LF    2
+
+/* what a non-blocking stream does with a line its write buffer can't hold */
+#define LOG_OVERFLOW_DROP_NEWEST 0
+#define LOG_OVERFLOW_DROP_OLDEST 1
+#define LOG_OVERFLOW_BLOCK       2
+#define LOG_OVERFLOW_ERROR       3
+
+/* how a pool of UDP collectors shares out lines */
+#define LOG_POOL_ROUND_ROBIN 0
+#define LOG_POOL_HASH        1
+
+struct LSF_async;
+struct LSF_wbuf;
+struct LSF_reconnect;
+struct LSF_spill;
+struct LSF_shstats;
+struct LSF_dest;
+struct LSF_pool;
+struct LSF_dns_entry;
+struct LSF_tls;
+struct LSF_uring;
+struct LSF_coalesce;
+struct LSF_limit;
+struct LSF_dedup;
+
+/* counters kept as lines go out; a snapshot is cheap to take */
+typedef struct {
+    unsigned long sent;             /* lines handed to the socket or its write buffer */
+    unsigned long bytes;            /* bytes in those lines, framing included */
+    unsigned long dropped;          /* lines discarded: full queue or buffer, connection down */
+    unsigned long failed;           /* sends that returned an error */
+    unsigned long truncated;        /* lines the socket took only part of */
+    unsigned long eagain;           /* failures with EAGAIN or EWOULDBLOCK */
+    unsigned long enobufs;          /* failures with ENOBUFS */
+    unsigned long econnrefused;     /* failures with ECONNREFUSED */
+    unsigned long reconnects;       /* stream connections re-established */
+    unsigned long spilled;          /* lines written to the spill file */
+    unsigned long replayed;         /* lines sent from the spill file */
+    unsigned long spill_lost;       /* spilled lines overwritten before replay */
+    unsigned long prefix_rebuilds;  /* full regenerations of the cached prefix */
+    unsigned long buffer_reallocs;  /* times linebuf was grown */
+    unsigned long filtered;         /* lines less severe than the threshold */
+    unsigned long suppressed;       /* lines dropped by a rate limit or sampling */
+    unsigned long deduplicated;     /* repeated lines counted instead of sent */
+} LSF_stats;
+
+/* one of the extra receivers added with LSF_add_receiver */
+typedef struct {
+    int proto;
+    const char* hostname;
+    int port;
+    int framing;
+    int up;                         /* connected right now */
+    unsigned long sent;
+    unsigned long bytes;
+    unsigned long dropped;
+    unsigned long failed;
+} LSF_receiver_info;
+
+/* one of the collectors in a pool set with LSF_set_pool */
+typedef struct {
+    const char* hostname;
+    int port;
+    int up;                         /* not ejected right now */
+    unsigned long sent;
+    unsigned long bytes;
+    unsigned long failed;
+    unsigned long ejections;        /* times it was taken out for an ICMP error */
+} LSF_pool_member_info;
+
+/* the TLS session of a LOG_TLS receiver */
+typedef struct {
+    const char* version;            /* protocol in use, or NULL while not connected */
+    const char* cipher;
+    int resumed;                    /* this connection resumed an earlier session */
+    int ktls;                       /* the kernel encrypts sends */
+    unsigned long handshakes;
+    unsigned long resumptions;      /* handshakes that resumed a session */
+} LSF_tls_info;
+
+/* the io_uring queue set with LSF_set_uring */
+typedef struct {
+    int entries;                    /* lines that may be in flight at once */
+    int sqpoll;                     /* a kernel thread submits them */
+    int fixed;                      /* sends come from registered buffers */
+    int in_flight;                  /* queued lines not yet completed */
+} LSF_uring_info;
+
+/* the stream coalescing buffer set with LSF_set_coalesce */
+typedef struct {
+    int size;                       /* bytes buffered before a write */
+    double max_delay;               /* seconds a line may wait, 0 for no limit */
+    int timer;                      /* a helper thread writes lines that are due */
+    int lines;                      /* lines buffered right now */
+    int bytes;                      /* bytes in those lines */
+} LSF_coalesce_info;
+
+/* a rate limit and sampling rate set with LSF_set_rate_limit and LSF_set_sample */
+typedef struct {
+    double rate;                    /* lines per second, 0 for no limit */
+    double burst;                   /* lines that may go out back to back */
+    double tokens;                  /* lines that may go out right now */
+    double sample;                  /* fraction of lines kept */
+} LSF_limit_info;
+
 typedef struct {
 
     /* configuration */
@@ -15,17 +125,55 @@ typedef struct {
     char*  name;                /* sending program name */
     int    pid;                 /* sending program pid */
     int    format;              /* RFC3164 or RFC5424 or RFC3164_LOCAL */
+    int    zerocopy;            /* send message from caller's buffer via iovec */
+    int    framing;             /* LOG_FRAMING_* for stream sockets */
+    int    time_precision;      /* RFC5424 TIME-SECFRAC digits, 0-6 */
+    int    coarse_clock;        /* LSF_now uses CLOCK_REALTIME_COARSE */
+    int    gso;                 /* LOG_UDP batches go out with UDP_SEGMENT */
+    int    min_severity;        /* less severe lines are dropped unformatted */
 
     /* resource handles */
     int    sock;                /* socket fd */
+    int    sock_type;           /* SOCK_STREAM or SOCK_DGRAM */
+    struct LSF_async* async;    /* background sender, or NULL */
+    struct LSF_wbuf* wbuf;      /* non-blocking stream write buffer, or NULL */
+    struct LSF_reconnect* reconnect; /* stream reconnect state, or NULL */
+    struct LSF_spill* spill;    /* on-disk overflow ring, or NULL */
+    struct sockaddr_storage peer_addr; /* receiver's address, kept for reconnects */
+    socklen_t peer_len;         /* length of peer_addr */
+    struct LSF_dns_entry* dns;  /* cached lookup of the receiver's name, or NULL */
+    unsigned long dns_gen;      /* generation of the cached address now in use */
+    int    send_flags;          /* flags for every send on the socket */
+    struct LSF_dest* dests;     /* extra receivers each line is copied to */
+    int    ndests;              /* number of dests */
+    struct LSF_pool* pool;      /* UDP collectors used instead of sock, or NULL */
+    struct LSF_tls* tls;        /* TLS over the stream for LOG_TLS, or NULL */
+    struct LSF_uring* uring;    /* io_uring queue that sends go through, or NULL */
+    struct LSF_coalesce* coalesce; /* buffer gathering stream lines into one write, or NULL */
+    int*   min_severity_word;   /* mapped control word used instead of min_severity, or NULL */
+    struct LSF_limit* limit;    /* rate limits and sampling, or NULL */
+    struct LSF_dedup* dedup;    /* recent lines whose repeats are counted, or NULL */
+
+    /* statistics */
+    LSF_stats stats;
+    struct LSF_shstats* shstats; /* counters shared across processes, or NULL */
 
     /* internal state */
+    int    proc_pid;            /* process the logger is running in */
+    unsigned long fork_gen;     /* fork generation the logger last ran in */
     time_t last_time;           /* time when the prefix was last generated */
+    time_t minute_start;        /* start of the minute in the prefix's timestamp */
+    long   utc_offset;          /* local zone's offset when the prefix was built */
+    int    time_day;            /* year and day of year of the prefix's timestamp */
+    int    clock_pos;           /* offset of the timestamp's hh:mm:ss in linebuf */
+    int    frac_pos;            /* offset of TIME-SECFRAC digits in linebuf, or 0 */
+    int    gso_seg;             /* largest GSO segment the socket takes, 0 for none */
+    long   usec;                /* fraction of a second for the next send */
     char*  linebuf;             /* log line, including prefix and message */
     int    bufsize;             /* current size of linebuf */
     size_t prefix_len;          /* length of the prefix string */
+    int    pri_len;             /* length of the "<PRI>" at the start of linebuf */
     char*  msg_start;           /* pointer into linebuf after end of prefix */
-    const char* time_format;    /* strftime format string */
     const char* msg_format;     /* snprintf format string */
 
     /* error reporting */
@@ -33,11 +181,33 @@ typedef struct {
 
 } LogSyslogFast;
 
+/* are lines of this severity less severe than the logger's threshold?
+   If so they're counted as filtered. Kept inline so that a caller can skip
+   formatting them at the cost of a load and a compare. */
+static inline int
+LSF_filtered(LogSyslogFast* logger, int severity, unsigned long lines)
+{
+    int min = logger->min_severity_word
+        ? __atomic_load_n(logger->min_severity_word, __ATOMIC_RELAXED)
+        : logger->min_severity;
+    if (severity <= min)
+        return 0;
+    logger->stats.filtered += lines;
+    return 1;
+}
+
 LogSyslogFast* LSF_alloc();
 int LSF_init(LogSyslogFast* logger, int proto, const char* hostname, int port, int facility, int severity, const char* sender, const char* name);
 int LSF_destroy(LogSyslogFast* logger);
 
 int LSF_set_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port);
+int LSF_add_receiver(LogSyslogFast* logger, int proto, const char* hostname, int port, int framing);
+void LSF_clear_receivers(LogSyslogFast* logger);
+int LSF_get_receiver_count(LogSyslogFast* logger);
+int LSF_get_receiver(LogSyslogFast* logger, int i, LSF_receiver_info* info);
+int LSF_set_pool(LogSyslogFast* logger, const char** hostnames, const int* ports, int count, int mode, double eject_time);
+int LSF_get_pool_size(LogSyslogFast* logger);
+int LSF_get_pool_member(LogSyslogFast* logger, int i, LSF_pool_member_info* info);
 
 void LSF_set_priority(LogSyslogFast* logger, int facility, int severity);
 void LSF_set_facility(LogSyslogFast* logger, int facility);
@@ -46,6 +216,25 @@ int LSF_set_sender(LogSyslogFast* logger, const char* sender);
 int LSF_set_name(LogSyslogFast* logger, const char* name);
 void LSF_set_pid(LogSyslogFast* logger, int pid);
 int LSF_set_format(LogSyslogFast* logger, int format);
+void LSF_set_zerocopy(LogSyslogFast* logger, int zerocopy);
+int LSF_set_framing(LogSyslogFast* logger, int framing);
+int LSF_set_time_precision(LogSyslogFast* logger, int digits, int coarse);
+int LSF_set_async(LogSyslogFast* logger, int queue_size, double drain_timeout);
+int LSF_set_nonblock(LogSyslogFast* logger, int buffer_size, int policy, double deadline);
+int LSF_set_reconnect(LogSyslogFast* logger, double min_delay, double max_delay);
+int LSF_set_spill(LogSyslogFast* logger, const char* path, size_t size, double rate);
+int LSF_set_shared_stats(LogSyslogFast* logger, const char* path, int slots);
+int LSF_set_uring(LogSyslogFast* logger, int entries, int sqpoll);
+int LSF_set_coalesce(LogSyslogFast* logger, int size, double max_delay, int timer);
+int LSF_set_gso(LogSyslogFast* logger, int gso);
+void LSF_set_min_severity(LogSyslogFast* logger, int severity);
+int LSF_set_min_severity_file(LogSyslogFast* logger, const char* path);
+
+/* a severity of -1 limits or samples all of the logger's lines together */
+int LSF_set_rate_limit(LogSyslogFast* logger, int severity, double rate, double burst);
+int LSF_set_sample(LogSyslogFast* logger, int severity, double fraction);
+int LSF_set_suppress_interval(LogSyslogFast* logger, int seconds);
+int LSF_set_dedup(LogSyslogFast* logger, int window, int slots);
 
 int LSF_get_priority(LogSyslogFast* logger);
 int LSF_get_facility(LogSyslogFast* logger);
@@ -54,9 +243,43 @@ const char* LSF_get_sender(LogSyslogFast* logger);
 const char* LSF_get_name(LogSyslogFast* logger);
 int LSF_get_pid(LogSyslogFast* logger);
 int LSF_get_format(LogSyslogFast* logger);
+int LSF_get_zerocopy(LogSyslogFast* logger);
+int LSF_get_framing(LogSyslogFast* logger);
+int LSF_get_time_precision(LogSyslogFast* logger);
+int LSF_get_async(LogSyslogFast* logger);
+int LSF_get_nonblock(LogSyslogFast* logger);
+double LSF_get_reconnect(LogSyslogFast* logger);
+size_t LSF_get_spill(LogSyslogFast* logger);
+int LSF_get_shared_stats(LogSyslogFast* logger);
+int LSF_get_uring(LogSyslogFast* logger, LSF_uring_info* info);
+int LSF_get_coalesce(LogSyslogFast* logger, LSF_coalesce_info* info);
+int LSF_get_gso(LogSyslogFast* logger);
+int LSF_get_min_severity(LogSyslogFast* logger);
+int LSF_get_rate_limit(LogSyslogFast* logger, int severity, LSF_limit_info* info);
+int LSF_get_suppress_interval(LogSyslogFast* logger);
+int LSF_get_dedup(LogSyslogFast* logger);
 
 int LSF_get_sock(LogSyslogFast* logger);
 
+/* process-wide: certificates LOG_TLS receivers are connected with from now on */
+int LSF_set_tls(const char* ca_file, const char* cert_file, const char* key_file, int ktls, const char** err);
+int LSF_get_tls(LogSyslogFast* logger, LSF_tls_info* info);
+
+/* process-wide: resolve receivers through a cache refreshed in the background */
+int LSF_set_dns_cache(double ttl, double timeout);
+double LSF_get_dns_cache(void);
+
+const LSF_stats* LSF_get_stats(LogSyslogFast* logger);
+void LSF_reset_stats(LogSyslogFast* logger);
+
+/* sub-second part of the time passed to the next send; LSF_now sets it too */
+void LSF_set_usec(LogSyslogFast* logger, long usec);
+time_t LSF_now(LogSyslogFast* logger);
+
 int LSF_send(LogSyslogFast* logger, const char* msg, int len, time_t t);
+int LSF_send_prio(LogSyslogFast* logger, const char* msg, int len, int priority, time_t t);
+int LSF_send_key(LogSyslogFast* logger, const char* key, int key_len, const char* msg, int len, time_t t);
+int LSF_send_many(LogSyslogFast* logger, const char** msgs, const int* lens, int count, time_t t);
+int LSF_flush(LogSyslogFast* logger, double timeout);
 
 #endif
@@ -137,6 +137,42 @@ for my $p (sort keys %servers) {
         }
     } "$p reconnect";
 
+    # plain sends against the same sends queued on an io_uring or gathered
+    # into one write per 64KB (streams only), with a child draining the
+    # receiver so the sender never waits on the reads
+    my @modes = (
+        ['send',     sub {}],
+        ['io_uring', sub { $_[0]->set_uring(256) }],
+        ['coalesce', sub { $_[0]->set_coalesce(65536) }],
+    );
+    for my $mode (@modes) {
+        my ($label, $setup) = @$mode;
+        next if $label eq 'coalesce' && $p !~ /tcp|stream/;
+        bench {
+            my $server = $listen->();
+            my $logger = $server->connect(@params);
+            my $receiver = $server->accept;
+            $setup->($logger);
+
+            my $pid = fork;
+            die "fork failed: $!" unless defined $pid;
+            if (!$pid) {
+                $receiver->blocking(1);
+                1 while sysread($receiver, my $buf, 65536);
+                POSIX::_exit(0);
+            }
+
+            for (1 .. 200000) {
+                $logger->send("testing 4");
+            }
+            $logger->flush;
+
+            # the reader shares the logger's socket, so it never sees EOF
+            kill 'TERM', $pid;
+            waitpid $pid, 0;
+        } "$p $label";
+    }
+
 }
 package ServerCreator;
 
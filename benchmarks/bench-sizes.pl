@@ -7,6 +7,7 @@ use warnings;
 
 use Benchmark qw(:all);
 use Getopt::Long;
+use Time::HiRes 'time';
 use Log::Syslog::Fast ':all';
 
 GetOptions(
@@ -14,12 +15,18 @@ GetOptions(
     'host=s'    => \(my $host       = '10.0.0.1'), # should be a blackhole that doesn't return ICMP errors
     'port=i'    => \(my $port       = 5516),
     'class=s'   => \(my $class      = 'Log::Syslog::Fast'),
+    'zerocopy!' => \(my $zerocopy),   # also bench zero-copy sends of large messages
+    'gso!'      => \(my $gso),        # also bench send_many bursts with and without UDP GSO
 );
 
 eval "use $class (); 1" or die "failed to load $class: $!";
 
+my @cases = map { [$_, 0] } 0, 10, 50, 100, 500, 1000, 5000;
+push @cases, map { [$_, 1] } 1000, 5000 if $zerocopy;
+
 my %loggers;
-for my $size (0, 10, 50, 100, 500, 1000, 5000) {
+for my $case (@cases) {
+    my ($size, $zc) = @$case;
     my $msg = 'X' x $size;
 
     my $logger = $class->new(
@@ -32,13 +39,31 @@ for my $size (0, 10, 50, 100, 500, 1000, 5000) {
         'benchmark',
     );
 
-    my $n = 0;
-    $loggers{sprintf '%4d', $size} = sub {
-        if ($n++ % 1000 == 0) {
-            $logger->set_pid($$);
-        }
+    $logger->set_zerocopy(1) if $zc;
+
+    $loggers{sprintf($zc ? '%4d zerocopy' : '%4d', $size)} = sub {
         $logger->send($msg);
     };
 }
 
 timethese(-$seconds, \%loggers);
+
+# packets per second for bursts of 64 equal-sized lines through send_many,
+# a datagram each and then with segmentation offload
+if ($gso) {
+    for my $size (10, 100, 500, 1000) {
+        my @msgs = ('X' x $size) x 64;
+        my @rates;
+        for my $on (0, 1) {
+            my $logger = $class->new(LOG_UDP, $host, $port, LOG_LOCAL0, LOG_DEBUG,
+                                     'localhost', 'benchmark');
+            $logger->set_gso($on);
+            my ($lines, $start) = (0, time);
+            while (time - $start < $seconds) {
+                $lines += $logger->send_many(\@msgs) for 1 .. 100;
+            }
+            push @rates, $lines / (time - $start);
+        }
+        printf "%5d: %10.0f pkt/s per datagram, %10.0f pkt/s with GSO\n", $size, @rates;
+    }
+}
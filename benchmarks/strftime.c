@@ -1,10 +1,21 @@
-#include <stdio.h>
+/* compare the cost of stamping a prefix with the current time.
+
+   build from the top of the distribution with:
+       cc -O2 -I. -o strftime benchmarks/strftime.c -lpthread
+*/
+
+#include "LogSyslogFast.c"
+
 #include <sys/time.h>
-#include <sys/types.h>
-#include <time.h>
+
+static double elapsed_since(struct timeval* start) {
+    struct timeval end;
+    gettimeofday(&end, 0);
+    return end.tv_sec - start->tv_sec + (((double) end.tv_usec - start->tv_usec) / 1000000);
+}
 
 void bench(int count, const char* fmt) {
-    struct timeval start, end;
+    struct timeval start;
     char buf[25];
     time_t t = time(0);
     const struct tm* x = localtime(&t);
@@ -14,12 +25,57 @@ void bench(int count, const char* fmt) {
     for (i = 0; i < count; i++) {
         strftime(buf, 25, fmt, x);
     }
-    gettimeofday(&end, 0);
 
-    double elapsed = end.tv_sec - start.tv_sec + (((double) end.tv_usec - start.tv_usec) / 1000000);
+    double elapsed = elapsed_since(&start);
     printf("%s: %.6f (%.6f/s)\n", fmt, elapsed, count / elapsed);
 }
 
+/* what update_prefix used to do for every new second */
+void bench_strftime_prefix(int count, int format) {
+    struct timeval start;
+    char timestr[26];
+    char linebuf[256];
+    time_t t = time(0);
+    int i;
+
+    const char* time_format = format == LOG_RFC5424 ? "%Y-%m-%dT%H:%M:%S%z" : "%h %e %H:%M:%S";
+    const char* msg_format = format == LOG_RFC5424 ? "<%d>1 %s %s %s %d - - " : "<%d>%s %s %s[%d]: ";
+
+    gettimeofday(&start, 0);
+    for (i = 0; i < count; i++) {
+        time_t now = t + i;
+        strftime(timestr, 26, time_format, localtime(&now));
+        snprintf(linebuf, sizeof(linebuf), msg_format, 134, timestr, "localhost", "benchmark", 12345);
+    }
+
+    double elapsed = elapsed_since(&start);
+    printf("strftime prefix (format %d): %.6f (%.6f/s)\n", format, elapsed, count / elapsed);
+}
+
+/* the incremental path taken by LSF_send */
+void bench_incremental_prefix(int count, int format) {
+    struct timeval start;
+    time_t t = time(0);
+    int i;
+
+    LogSyslogFast* logger = LSF_alloc();
+    if (LSF_init(logger, LOG_UDP, "127.0.0.1", 514, 16, 6, "localhost", "benchmark") < 0) {
+        printf("LSF_init failed: %s\n", logger->err);
+        return;
+    }
+    LSF_set_format(logger, format);
+
+    gettimeofday(&start, 0);
+    for (i = 0; i < count; i++) {
+        update_time(logger, t + i);
+    }
+
+    double elapsed = elapsed_since(&start);
+    printf("incremental prefix (format %d): %.6f (%.6f/s)\n", format, elapsed, count / elapsed);
+
+    LSF_destroy(logger);
+}
+
 int main(int argc, char** argv) {
     int count = 1000;
     if (argc > 1) {
@@ -32,5 +88,10 @@ int main(int argc, char** argv) {
 
     bench(count, "%h %e %T");
     bench(count, "%h %e %H:%M:%S");
+
+    bench_strftime_prefix(count, LOG_RFC3164);
+    bench_incremental_prefix(count, LOG_RFC3164);
+    bench_strftime_prefix(count, LOG_RFC5424);
+    bench_incremental_prefix(count, LOG_RFC5424);
     return 0;
 }
@@ -53,7 +53,7 @@ Create a new Log::Syslog::Fast object with the following parameters:
 
 =item $proto
 
-The transport protocol: one of LOG_TCP, LOG_UDP, or LOG_UNIX.
+The transport protocol: one of LOG_TCP, LOG_UDP, LOG_UNIX, or LOG_TLS.
 
 If LOG_TCP or LOG_UNIX is used, calls to $logger-E<gt>send() will block until
 remote receipt of the message is confirmed. If LOG_UDP is used, the call will
@@ -64,12 +64,25 @@ With LOG_UNIX, I<< ->new >> will first attempt to connect with a SOCK_STREAM
 socket, and then try a SOCK_DGRAM if that is what the server expects (e.g.
 rsyslog).
 
+LOG_TLS is LOG_TCP wrapped in TLS, as in RFC 5425. Messages are always
+octet-counted (see B<set_framing>). The server's certificate must verify
+against the CAs given to B<set_tls> (the system's by default) and match
+$hostname. LOG_TLS needs the module to have been built with OpenSSL.
+
 =item $hostname
 
 For LOG_TCP and LOG_UDP, the destination hostname where a syslogd is running.
 For LOG_UNIX, the path to the UNIX socket where syslogd is listening (typically
 /dev/log).
 
+When a LOG_TCP hostname resolves to several addresses, they're raced in the
+style of RFC 8305 ("Happy Eyeballs"). Address families take turns, a new
+non-blocking connect starts every 250 milliseconds or as soon as one fails,
+and the first to connect is kept. A dead first address then costs a quarter
+second instead of a full connect timeout. The whole race, like a connect to a
+single address, gives up after 10 seconds with "Connection timed out".
+Reconnects go straight to the address that won. LOG_UDP uses the first address.
+
 =item $port
 
 For LOG_TCP and LOG_UDP, the destination port where a syslogd is listening,
@@ -107,7 +120,9 @@ The program name or tag to use for the message.
 
 Send a syslog message through the configured logger. If $time is not provided,
 B<time(2)> will be called for you. That doubles the syscalls per message, so
-try to pass it if you're already calling time() yourself.
+try to pass it if you're already calling time() yourself. $time may be
+fractional (e.g. from L<Time::HiRes>); the fraction is used only if
+B<set_time_precision> has been called.
 
 ->send may throw an exception if the system call fails (e.g. the transport
 becomes disconnected for connected protocols, or the kernel buffer is full for
@@ -119,16 +134,134 @@ B<emit> is an alias for B<send>.
 
 B<NEWLINE CAVEAT>
 
-Note that B<send> does not add any newline character(s) to its input. You will
-certainly want to do this yourself for TCP connections, or the server will not
-treat each message as a separate line. However with UDP the server should
-accept a message without a trailing newline (though some implementations may
-have difficulty with that).
+Note that B<send> does not add any newline character(s) to its input. For TCP
+and stream LOG_UNIX connections you will certainly want to either do this
+yourself or enable framing with B<set_framing>, or the server will not treat
+each message as a separate line. However with UDP the server should accept a
+message without a trailing newline (though some implementations may have
+difficulty with that).
+
+=item $logger-E<gt>send_prio($logmsg, $severity, [$facility], [$time])
+
+Like B<send>, but for this one message use $severity and $facility (which
+defaults to the logger's own) instead of the configured priority. Unlike
+calling B<set_severity> first, this doesn't rebuild the cached prefix: the PRI
+part is taken from a precomputed table of all 192 combinations and sent ahead
+of the rest of the prefix, so one logger can emit mixed severities at full
+speed.
+
+=item $logger-E<gt>send_key($key, $logmsg, [$time])
+
+Like B<send>, but with a pool in LOG_POOL_HASH mode (see B<set_pool>) the
+message goes to the collector that $key hashes to, so messages with the same
+key, e.g. a user or request id, all end up on one collector. Without a pool
+the key is ignored.
+
+=item $logger-E<gt>send_many(\@logmsgs, [$time])
+
+Send several syslog messages, all stamped with the same $time, in as few
+system calls as possible. For datagram sockets (LOG_UDP and SOCK_DGRAM
+LOG_UNIX) each message is still its own datagram but the batch is handed to the
+kernel with a single B<sendmmsg(2)> where available; for stream sockets the
+batch is written with a single B<writev(2)>. Messages are not copied into an
+intermediate buffer.
+
+Returns the number of messages accepted by the kernel, which may be fewer than
+were given if a datagram socket runs out of buffer space partway through. An
+exception is thrown only if the very first message fails.
+
+The NEWLINE CAVEAT for B<send> applies to each message.
+
+=item $logger-E<gt>flush([$timeout])
+
+In async mode (see B<set_async>), wait up to $timeout seconds for the
+background sender to hand every queued message to the kernel. In non-blocking
+mode (see B<set_nonblock>), wait up to $timeout seconds to write out the
+userspace buffer. With B<set_uring>, wait up to $timeout seconds for every
+queued message to complete. With B<set_coalesce>, write out the buffered
+lines at once, e.g. at the end of a request. A tally of lines suppressed by
+B<set_rate_limit> or B<set_sample>, and repeats counted by B<set_dedup>, are
+reported first. Without async mode, messages in a spill file (see
+B<set_spill>) are replayed first. Waits indefinitely if $timeout is omitted or negative.
+Returns true if everything was handed off and false on timeout or a socket
+error. Always returns true when none of these modes is on.
 
 =item $logger-E<gt>set_receiver($proto, $hostname, $port)
 
 Change the protocol, destination host, and port. This will force a reconnection
-in LOG_TCP or LOG_UNIX mode.
+in LOG_TCP or LOG_UNIX mode. In async mode the queue is drained (within the
+drain timeout) before the old connection is closed.
+
+=item $logger-E<gt>add_receiver($proto, $hostname, $port, [$framing])
+
+Also send every message to another receiver, given like the arguments to
+B<new>, with its own framing constant for stream receivers (LOG_FRAMING_NONE
+by default). Each message is formatted once and then written to the main
+receiver and to every added one. The first connection is made right away and
+an exception is thrown if it fails.
+
+Added receivers are kept apart from each other and from the main one: their
+sockets never block, so a message one of them can't take at once is skipped
+for that receiver alone, and a lost connection is retried in the background
+about once a second. They don't take part in B<set_nonblock> buffering,
+B<set_reconnect> or B<set_spill>, which apply to the main receiver only. In
+async mode the background thread writes to them too.
+
+=item $logger-E<gt>clear_receivers()
+
+Stop sending to the receivers added with B<add_receiver>.
+
+=item $logger-E<gt>get_receivers()
+
+Returns a reference to a list of hashes, one for each receiver added with
+B<add_receiver>, with its I<proto>, I<hostname>, I<port> and I<framing>,
+whether it is I<up> right now, and counts of the messages it was I<sent>, the
+I<bytes> in them, the messages I<dropped> because it was full or down, and
+the sends to it that I<failed>.
+
+=item $logger-E<gt>set_pool(\@collectors, [$mode], [$eject_time])
+
+Send over UDP to a pool of collectors, given as a list of [$hostname, $port]
+pairs, instead of to the receiver. Each collector gets a connected socket of
+its own. $mode says how messages are shared out:
+
+=over 4
+
+=item LOG_POOL_ROUND_ROBIN
+
+The default: each message goes to the next collector in turn.
+
+=item LOG_POOL_HASH
+
+Messages sent with B<send_key> go to a collector picked by a consistent hash
+of the key; other messages go round robin. Each collector gets 160 points on
+a hash ring made from its hostname and port as given, so every process with
+the same list agrees on where a key goes, and adding or removing a collector
+only moves the keys on its points.
+
+=back
+
+A collector whose host answers with ICMP errors (connection refused, host or
+network unreachable) is ejected for $eject_time seconds (default 10; 0 never
+ejects). The kernel reports such an error on the next send to that socket, and
+that message is then sent to the next collector instead. Messages that would
+have gone to an ejected collector go to the others; with LOG_POOL_HASH, to the
+next collector along the ring, so other keys stay put. Once its time is up a
+collector is tried again. If every collector is ejected, messages go where
+they would have anyway.
+
+B<send_many> hands each collector its share of a batch with a single
+B<sendmmsg(2)>. In async mode the background thread sends through the pool.
+Framing doesn't apply, and a pool can't be combined with B<set_nonblock> or
+B<set_reconnect>. The receiver is kept and used again once the pool is
+cleared with an empty list.
+
+=item $logger-E<gt>get_pool()
+
+Returns a reference to a list of hashes, one for each collector in the pool,
+with its I<hostname> and I<port>, whether it is I<up> (not ejected) right now,
+and counts of the messages it was I<sent>, the I<bytes> in them, the sends to
+it that I<failed> and the times it was ejected (I<ejections>).
 
 =item $logger-E<gt>set_priority($facility, $severity)
 
@@ -142,6 +275,76 @@ Change only the syslog facility.
 
 Change only the syslog severity.
 
+=item $logger-E<gt>set_min_severity($severity)
+
+Drop lines less severe than $severity (numerically greater, e.g. LOG_DEBUG
+with a $severity of LOG_INFO) instead of sending them. B<send>, B<emit>,
+B<send_prio>, B<send_key> and B<send_many> check the threshold before they
+look at the message, so a dropped line is never stringified, formatted or
+timestamped; they return 0 for it, and B<get_stats> counts it as filtered.
+The default of LOG_DEBUG lets everything through, and a negative $severity
+drops everything. The setting takes effect on the next send, so it's safe
+to change from a signal handler, e.g. to turn debug lines on for a while.
+
+=item $logger-E<gt>set_min_severity_file($path)
+
+Take the threshold from the file at $path from now on, so that another
+process can change it for every logger using the file, e.g. across a
+preforked server. The file holds the threshold as a native-endian 32-bit
+integer in its first four bytes; a new or empty file is given the
+logger's current threshold. B<set_min_severity> then writes to the file.
+Any process can do the same, e.g.
+C<perl -e 'open my $f, "+<", shift; print $f pack("i", 7)' $path>. The file
+is mapped into memory, so the check costs no syscall; the pure perl
+implementation reads it on every send instead. Children share the mapping
+with their parent. An undefined $path goes back to a threshold of the
+logger's own, starting from the file's last value.
+
+=item $logger-E<gt>set_rate_limit($severity, $rate, [$burst])
+
+Let at most $rate lines a second of $severity through, in bursts of up to
+$burst lines (by default a second's worth, and at least 1), using a token
+bucket. An undefined $severity limits all of the logger's lines together,
+on top of any limit per severity. The bucket is refilled by the time
+passed since it was last, to fractions of a second, read from the coarse
+monotonic clock, which costs no syscall on Linux. A line over the limit
+isn't sent; the send returns 0 for it, and B<get_stats> counts it as
+suppressed. B<send_many> checks each of its lines on its own and sends the
+ones let through. A $rate of 0 removes the limit.
+
+=item $logger-E<gt>set_sample($severity, $fraction)
+
+Keep a random $fraction of lines of $severity, between 0 (none) and 1
+(all, the default), or of all lines with an undefined $severity. Lines
+sampled out are counted as suppressed, like lines over a B<set_rate_limit>.
+Each line of a B<send_many> batch is sampled on its own.
+
+=item $logger-E<gt>set_suppress_interval($seconds)
+
+While lines are being suppressed, send a line of their count, e.g.
+"42 messages suppressed", at LOG_WARNING and the logger's facility once
+$seconds have passed since the first of them. The report goes out with the
+next send, and anything not yet reported goes out on B<flush> or when the
+logger is destroyed. It isn't itself limited. The default is 10 seconds; 0 turns the
+reports off.
+
+=item $logger-E<gt>set_dedup($window, [$slots])
+
+Collapse repeated lines. The logger remembers the last $slots different
+lines (8 by default, at most 64) by a hash of their text and priority. A
+line that comes again within $window seconds of going out isn't sent; the
+send returns 0, and B<get_stats> counts it as deduplicated. The first
+occurrence still goes out at once. The repeats are summarized in a line of
+their own at the same priority, e.g. "message repeated 42 times: [...]",
+quoting up to 80 bytes of the line. A different line ends the run of
+repeats, and the summary goes out ahead of it; it also goes out when a
+send finds the window closed, on B<flush>, or when the logger is
+destroyed. The other slots let a line that comes back after a different
+one within the window still be counted as a repeat. Times are taken from
+the sends, and
+repeats are taken out before any rate limit applies. A $window of 0 turns
+it off, summarizing any repeats first.
+
 =item $logger-E<gt>set_sender($sender)
 
 Change what is sent as the hostname of the sender.
@@ -152,13 +355,308 @@ Change what is sent as the name of the sending program.
 
 =item $logger-E<gt>set_pid($name)
 
-Change what is sent as the process id of the sending program.
+Change what is sent as the process id of the sending program. A pid set this
+way is kept across forks; see L</FORKING>.
 
 =item $logger-E<gt>set_format($format)
 
 Change the message format. This should be either the constant LOG_RFC3164 (the
 default) or LOG_RFC5424 or LOG_RFC3164_LOCAL (without HOSTNAME).
 
+=item $logger-E<gt>set_zerocopy($bool)
+
+Enable or disable zero-copy sends. Normally each message is copied into an
+internal buffer just after the cached prefix and sent as one contiguous block.
+With zero-copy enabled, B<send> instead passes the prefix and the message's own
+string buffer to B<sendmsg(2)> as separate iovecs, so the message bytes are
+never copied in user space and the internal buffer never has to grow. This is
+a win for large (multi-KB) messages; for short messages the plain copy is
+usually just as fast. Off by default.
+
+=item $logger-E<gt>set_gso($bool)
+
+Enable or disable UDP segmentation offload (Linux 4.18 or later) for bursts
+to a LOG_UDP receiver. B<send_many>, and the background sender in async
+mode, then pass each run of equal-length lines in a batch to the kernel as
+one message, which it splits into datagrams; the run may end with a shorter
+line. Lines of a fixed-width format from one template burst best. Lines too
+long for the path's MTU are sent on their own. Where the kernel or the path
+doesn't support segmentation, every datagram is sent on its own as before.
+A single B<send> is unaffected, as is a pool. Off by default.
+
+=item $logger-E<gt>set_time_precision($digits, [$coarse])
+
+Include $digits (1 to 6) digits of fractional seconds in RFC5424 timestamps
+(TIME-SECFRAC), e.g. 3 for milliseconds or 6 for microseconds; 0, the
+default, sends whole seconds only. Has no effect on the RFC3164 formats.
+
+With a precision set, B<send> uses the fractional part of a passed-in $time;
+if $time is omitted the clock is read with B<clock_gettime(2)>, which on
+Linux is served from the vDSO without a system call. A true $coarse selects
+CLOCK_REALTIME_COARSE where available, which is cheaper still but only
+advances once per kernel tick (typically 1-4ms).
+
+Only the fraction digits of the cached prefix are rewritten on each send.
+
+=item $logger-E<gt>set_framing($framing)
+
+Set how messages are delimited on stream sockets (LOG_TCP and SOCK_STREAM
+LOG_UNIX), per RFC6587. One of:
+
+=over 4
+
+=item LOG_FRAMING_NONE
+
+The default: messages are written back to back exactly as given.
+
+=item LOG_FRAMING_OCTET
+
+Octet counting: each message is preceded by its length in bytes and a space.
+Messages may contain embedded newlines, and receivers such as rsyslog can use
+their faster framed parser.
+
+=item LOG_FRAMING_LF
+
+Non-transparent framing: a newline is appended to each message.
+
+=back
+
+Framing is ignored for datagram sockets, which preserve message boundaries on
+their own. When framing is enabled each message is written in full (resuming
+after partial writes), and B<send> returns the number of bytes written
+including the framing.
+
+=item $logger-E<gt>set_async($queue_size, [$drain_timeout])
+
+Enable asynchronous sending. A background thread is started which owns all
+writes to the socket; B<send>, B<emit> and B<send_many> then only copy the
+formatted line into a lock-free queue of at least $queue_size bytes (rounded
+up to a power of two, minimum 4096) and return immediately, even if the
+receiver has stalled. The worker drains the queue in batches.
+
+If the queue is full the message is dropped and B<send> returns 0 rather than
+the number of bytes queued. Errors from the worker's sends cannot be reported
+to the caller and the affected messages are discarded.
+
+When the logger is destroyed, or async mode is turned off or resized, the
+worker is given up to $drain_timeout seconds (default 1) to empty the queue.
+Messages still queued after that are lost. On destruction a worker stuck
+sending to a stalled receiver is interrupted by shutting down the socket.
+
+A $queue_size of 0 turns async mode off. The worker thread does not survive
+fork(); create loggers in async mode after forking.
+
+=item $logger-E<gt>set_nonblock($buffer_size, [$policy], [$deadline])
+
+Put stream sockets (LOG_TCP and SOCK_STREAM LOG_UNIX) into non-blocking mode,
+so that the time B<send> can spend waiting on a slow or stalled receiver is
+bounded. Whatever the socket will not take right away, including the rest of a
+partly written message, is kept in a userspace buffer of $buffer_size bytes and
+is written out ahead of later messages. Messages are always written whole, so
+framing is never broken.
+
+When a message does not fit in the buffer, $policy decides what happens:
+
+=over 4
+
+=item LOG_OVERFLOW_DROP_NEWEST
+
+The default: the new message is dropped and B<send> returns 0.
+
+=item LOG_OVERFLOW_DROP_OLDEST
+
+Buffered messages are discarded, oldest first, to make room. A message that
+has already been partly written is never discarded.
+
+=item LOG_OVERFLOW_BLOCK
+
+Wait up to $deadline seconds (default 0.1) for the receiver to make room. If
+there is still no room, the message is dropped and B<send> returns 0.
+
+=item LOG_OVERFLOW_ERROR
+
+B<send> throws an exception.
+
+=back
+
+A message larger than the whole buffer always overflows. Datagram sockets are
+not affected. B<set_receiver> keeps buffered messages for the new connection,
+except a partly written one. When the logger is destroyed or non-blocking mode
+is turned off with a $buffer_size of 0, the buffer is given up to $deadline
+seconds to drain. This mode cannot be combined with B<set_async>.
+
+=item $logger-E<gt>set_reconnect($min_delay, [$max_delay])
+
+Re-establish lost stream connections (LOG_TCP and SOCK_STREAM LOG_UNIX)
+automatically. If a send fails because the receiver went away (EPIPE,
+ECONNRESET and similar), the socket is closed. Later sends silently drop their
+messages and return 0 until a new connection is up, unless there's a spill
+file (see B<set_spill>). Reconnect attempts start
+$min_delay seconds after the failure and back off exponentially up to
+$max_delay seconds (default 30). Each wait is jittered by up to half, so that
+many clients don't all reconnect at the same moment.
+
+Reconnecting never blocks B<send>. The address resolved when the receiver was
+set is reused without another lookup, and the connect is non-blocking; each
+send checks on its progress. Sends also use MSG_NOSIGNAL, so a dead
+LOG_UNIX peer no longer raises SIGPIPE. In async mode the background worker
+does the reconnecting.
+
+As with any TCP sender, the first message written after the receiver closed
+may be accepted by the kernel and lost. A $min_delay of 0 turns reconnecting
+off; if the connection is down at that point, it is re-established at once
+(blocking) and an exception is thrown if that fails.
+
+=item $logger-E<gt>set_spill($path, $size, [$rate])
+
+Keep messages that can't be sent right now in an on-disk spill file at $path
+instead of dropping them. The file holds a header page and a circular data
+area of $size bytes, and is mapped into memory with B<mmap(2)>. Messages go
+into it while a lost connection is being re-established (see
+B<set_reconnect>). They also go into it when the async queue or the
+non-blocking write buffer is full, including messages the
+LOG_OVERFLOW_DROP_OLDEST policy pushes out. When the file itself is full, the
+oldest spilled messages are overwritten.
+
+Once the connection is up, spilled messages are sent again, oldest first,
+alongside new ones. Replay happens during later sends or B<flush> calls, or
+in the background in async mode. A $rate sets the maximum number of spilled
+messages replayed per second, so that a backlog doesn't swamp a receiver
+that just restarted; 0, the default, means no limit. A spilled message is
+removed from the file only after it has been sent.
+
+Every record in the file carries its length and a checksum, and the file's
+head and tail are updated so that a crash leaves the existing records intact.
+A process that opens an existing spill file of the same $size picks up where
+the earlier one left off. Records that were only partly written are
+discarded. A file of a different size is started afresh. Only one logger at a
+time may use a given file. An undefined $path or a $size of 0 closes the
+spill file.
+
+=item $logger-E<gt>set_shared_stats($path, [$slots])
+
+Also count sends, drops, failures, bytes and send latencies in the shared
+stats file at $path, which is created with room for $slots processes (256 by
+default) if it doesn't exist yet. An existing file keeps its own number of
+slots. Every logger using the file adds to one row of totals and to a row
+for its own process, so with preforked servers the parent can call this
+before forking and each worker will be counted separately. Rows of processes
+that have exited are recycled. Counting takes a few atomic additions and two
+clock reads per send. See L<Log::Syslog::Fast::SharedStats> and
+L<syslog-fast-stats> for reading the file. An undefined $path stops using
+the file.
+
+=item $logger-E<gt>set_uring($entries, [$sqpoll])
+
+On Linux (5.6 or later), queue sends on an io_uring of $entries entries
+(rounded up to a power of two) instead of making a syscall for each.
+B<send>, B<emit> and B<send_many> format the line into a buffer of $entries
+times 2KB and queue it, returning the line's length. With a true $sqpoll
+(the default) a kernel thread picks queued lines up without any syscall from
+the sender; it sleeps after 50ms without work, and the next send wakes it.
+Where the kernel doesn't allow the thread (before 5.11, without privileges)
+each send makes one B<io_uring_enter(2)> call, and B<send_many> one per batch.
+The buffer is registered with the kernel when it accepts registered buffers
+for plain sends.
+
+Lines go out in order. Each datagram is a send of its own. A stream has one
+send in progress at a time, since a later one could overtake it while the
+socket's buffer is full. The lines queued meanwhile are gathered into the next
+send, which starts when a later B<send>, B<flush> or B<get_uring> finds the
+earlier one complete; call B<flush> after a burst to be sure they've gone.
+When all $entries are in flight, or the buffer is full, B<send> waits for the
+oldest to complete. A line longer than the buffer is sent directly once the
+queue has emptied. So are lines to a SOCK_DGRAM LOG_UNIX receiver, since
+queued sends aren't reliably woken when its full queue drains. Results are collected on later
+sends. So B<get_stats> counts a line as sent, failed or truncated only after
+it completes, and errors can't be reported to the caller. Call B<flush> to
+wait for everything queued. On destruction, or when the receiver or the
+queue size changes, queued lines get up to a second to complete.
+
+io_uring can't be combined with B<set_async>, B<set_nonblock>,
+B<set_reconnect>, B<set_pool>, LOG_TLS or B<set_coalesce>. An $entries of 0 turns it off.
+The pure perl implementation only remembers the setting.
+
+=item $logger-E<gt>set_coalesce($size, [$max_delay, $timer])
+
+For LOG_TCP, LOG_TLS and SOCK_STREAM LOG_UNIX receivers, gather lines in a
+buffer of $size bytes and write them out together instead of making a
+syscall, and possibly a small TCP segment, for each. B<send>, B<emit> and
+B<send_many> return a buffered line's length. The buffer is written out
+when the next line wouldn't fit or it's full, and when a send finds its
+oldest line $max_delay seconds old (0.05 by default; 0 for no limit). That
+check reads a coarse clock, so it may be a few milliseconds late. A line
+longer than the buffer is sent directly, after what was buffered.
+
+Without a send to check it, a line could wait indefinitely. Call B<flush>
+at request boundaries or before going idle. Or pass a true $timer to start
+a thread that writes the buffer out once its oldest line is due. The
+logger then takes a lock on every send, which is cheap while uncontended.
+
+B<get_stats> counts lines as sent once they're written. If that write
+fails, every line in it counts as failed, and the sender learns of the
+failure on the send that triggered it. The buffer is written out on
+destruction, when the receiver changes, and when coalescing is set again.
+It has no effect on datagram sockets.
+
+Coalescing can't be combined with B<set_async>, B<set_nonblock> or
+B<set_uring>, which already gather lines. A $size of 0 turns it off. The
+pure perl implementation only remembers the setting.
+
+=item Log::Syslog::Fast-E<gt>set_tls($ca_file, [$cert_file, $key_file, $ktls])
+
+Set the certificates LOG_TLS receivers are connected with from then on,
+for every logger in the process. Call it as a class method before B<new>.
+The server's certificate is checked against the CAs in $ca_file, or against
+the system's CAs if $ca_file is undefined. A $cert_file and $key_file
+(PEM) are presented to servers that ask for a client certificate.
+Loggers already connected keep the settings they connected with.
+
+Each logger keeps the session the server hands out. When it connects to the
+same receiver again, through B<set_reconnect> or B<set_receiver>, the
+session is resumed, which skips most of the handshake's work. A reconnect's
+handshake never blocks B<send>.
+
+With a true $ktls, on Linux with the kernel's C<tls> module loaded, OpenSSL
+hands encryption over to the kernel once the handshake is done. Messages
+are then written to the socket with plain B<sendmsg(2)>, as with LOG_TCP.
+Otherwise they're encrypted in the process, batched into TLS records of up
+to 16KB. LOG_TLS can't be combined with B<set_nonblock>. It also can't be
+used with B<add_receiver>.
+
+=item $logger-E<gt>get_tls()
+
+For a LOG_TLS logger, a hashref describing its TLS connection; otherwise
+undef. The keys are version, cipher, resumed (this connection resumed an
+earlier session), ktls (the kernel is doing the encryption), handshakes
+and resumptions. version and cipher are undef while the connection is
+down.
+
+=item Log::Syslog::Fast-E<gt>set_dns_cache($ttl, [$timeout])
+
+Resolve LOG_TCP and LOG_UDP hostnames through a cache shared by every logger
+in the process, from then on. Call it as a class method before B<new> so the
+constructor uses the cache too. Lookups are done by a helper thread, so a
+receiver that was resolved before never waits for the resolver: B<new>,
+B<set_receiver> and reconnects get the cached address at once. A hostname the
+cache has never seen makes the caller wait up to $timeout seconds (default 2)
+for the helper's first answer. If there's no answer by then, an exception is
+thrown, but the lookup carries on for the next try.
+
+While a logger uses an address, the helper looks it up again every $ttl
+seconds. If the lookup fails, the old address is kept and the lookup is tried
+again within 5 seconds. When the address changes, a LOG_UDP logger sends to the
+new one from its next message on. A LOG_TCP logger moves over the next time it
+connects, e.g. on a reconnect (see B<set_reconnect>), so collectors can be
+moved behind DNS without restarting anything. Connects race all of a
+name's cached addresses, as without the cache, but a move follows the first
+one. Receivers added with
+B<add_receiver> and collectors in a pool are looked up through the cache too,
+but keep the address they started with.
+
+A $ttl of 0 turns the cache off. Addresses already in use are then no longer
+refreshed.
+
 =item $logger-E<gt>get_priority()
 
 Returns the current priority value.
@@ -171,10 +669,143 @@ Returns the current facility value.
 
 Returns the current severity value.
 
+=item $logger-E<gt>get_min_severity()
+
+Returns the severity threshold in effect, read from the file if
+B<set_min_severity_file> is on.
+
+=item $logger-E<gt>get_rate_limit([$severity])
+
+Returns a hashref of rate, burst, tokens (lines that may go out right now)
+and sample for $severity, or for the logger as a whole if it's undefined.
+
+=item $logger-E<gt>get_suppress_interval()
+
+Returns the number of seconds between reports of suppressed lines.
+
+=item $logger-E<gt>get_dedup()
+
+Returns the B<set_dedup> window, or 0 if duplicate suppression is off.
+
 =item $logger-E<gt>get_format($format)
 
 Returns the current message format.
 
+=item $logger-E<gt>get_zerocopy()
+
+Returns true if zero-copy sends are enabled.
+
+=item $logger-E<gt>get_gso()
+
+With B<set_gso> on, returns the largest line the kernel will segment for the
+current receiver, or 0 if datagrams go one at a time. Always 0 with it off.
+The receiver is probed when B<set_gso> is called and again whenever it
+changes, so this only reads the answer.
+
+=item $logger-E<gt>get_time_precision()
+
+Returns the number of fractional-second digits in RFC5424 timestamps.
+
+=item $logger-E<gt>get_framing()
+
+Returns the current framing constant.
+
+=item $logger-E<gt>get_async()
+
+Returns the async queue size in bytes, or 0 if async mode is off.
+
+=item $logger-E<gt>get_nonblock()
+
+Returns the non-blocking write buffer size in bytes, or 0 if the mode is off.
+
+=item $logger-E<gt>get_reconnect()
+
+Returns the initial reconnect delay, or 0 if reconnecting is off.
+
+=item $logger-E<gt>get_spill()
+
+Returns the size of the spill file's data area, or 0 if there is none.
+
+=item $logger-E<gt>get_shared_stats()
+
+Returns the number of process slots in the shared stats file, or 0 if there
+is none.
+
+=item $logger-E<gt>get_uring()
+
+With B<set_uring> on, a hashref of entries, sqpoll (a kernel thread
+submits), fixed (sends come from the registered buffer) and in_flight
+(lines queued but not yet completed); otherwise undef.
+
+=item $logger-E<gt>get_coalesce()
+
+With B<set_coalesce> on, a hashref of size, max_delay, timer (the timer
+thread is running), lines and bytes (what's buffered now); otherwise undef.
+
+=item Log::Syslog::Fast-E<gt>get_dns_cache()
+
+Returns the DNS cache's $ttl, or 0 if the cache is off.
+
+=item $logger-E<gt>get_stats()
+
+Returns a reference to a hash of counters kept since the logger was created
+or since the last B<reset_stats>:
+
+=over 4
+
+=item * sent, bytes
+
+Messages handed to the socket (or the non-blocking write buffer), and their
+size on the wire. Replayed spilled messages are included.
+
+=item * dropped
+
+Messages discarded because the async queue or write buffer was full, the
+connection was down with no spill file, or a background send failed.
+
+=item * failed, eagain, enobufs, econnrefused
+
+Sends that returned an error, and how many of those failed with EAGAIN (or
+EWOULDBLOCK), ENOBUFS and ECONNREFUSED.
+
+=item * truncated
+
+Messages the socket accepted only part of.
+
+=item * reconnects, spilled, replayed, spill_lost
+
+Connections re-established by B<set_reconnect>, messages written to and
+replayed from the spill file, and spilled messages overwritten before they
+could be replayed.
+
+=item * prefix_rebuilds, buffer_reallocs
+
+Times the cached message prefix was regenerated from scratch, and times the
+internal line buffer had to grow.
+
+=item * filtered
+
+Messages dropped for being less severe than the B<set_min_severity>
+threshold.
+
+=item * suppressed
+
+Messages dropped by a B<set_rate_limit> limit or B<set_sample>.
+
+=item * deduplicated
+
+Repeated messages counted by B<set_dedup> instead of being sent.
+
+=back
+
+The counters are plain integers updated as messages go out, so taking a
+snapshot is cheap. In async mode the background thread updates some of them
+while the snapshot is taken, so the values may be a message or two apart.
+
+=item $logger-E<gt>reset_stats()
+
+Sets all the counters returned by B<get_stats> to 0.
+
 =back
 
 =head1 UNREACHABLE SERVERS
@@ -188,7 +819,13 @@ raise a signal:
 
 If the server is unreachable at connect time, I<< ->new >> will fail with an
 exception. If an established connection is closed remotely, I<< ->send >> will
-fail with an exception.
+fail with an exception, unless B<set_reconnect> is used. If the server stops
+reading, I<< ->send >> blocks unless B<set_nonblock> is used.
+
+=item * LOG_TLS
+
+As LOG_TCP. I<< ->new >> also fails if the TLS handshake fails, e.g. because
+the server's certificate doesn't verify.
 
 =item * LOG_UDP
 
@@ -205,7 +842,41 @@ With both SOCK_STREAM- and SOCK_DGRAM-based servers, I<< ->new >> will throw an
 exception if the socket is missing or not connectable.
 
 With SOCK_DGRAM, I<< ->send >> to a peer that went away will throw. With
-SOCK_STREAM, I<< ->send >> to a peer that went away will raise SIGPIPE.
+SOCK_STREAM, I<< ->send >> to a peer that went away will raise SIGPIPE, unless
+B<set_reconnect> is used.
+
+=back
+
+=head1 FORKING
+
+A logger created before a fork can be used in the children as is. On its
+first send (or B<flush>) in a child, the logger notices the fork, without any
+extra work on later sends:
+
+=over 4
+
+=item * The child's own pid goes into the prefix, unless a different one was
+set with B<set_pid>.
+
+=item * A stream (LOG_TCP or SOCK_STREAM LOG_UNIX) logger opens its own
+connection to the receiver, so that lines from different processes never
+interleave. If that connection can't be made, the child goes on sharing the
+parent's, unless B<set_reconnect> is on, in which case it keeps trying in the
+background. A LOG_TLS child resumes the parent's TLS session on its own
+connection. It can't share the parent's, so if that connection fails its
+sends fail too, unless B<set_reconnect> is on. Stream receivers added with B<add_receiver> are reopened the same
+way. Datagram sockets are shared, since each message is sent whole.
+
+=item * Lines the parent had queued in async mode or in a non-blocking write
+buffer are left to the parent, as are lines on its io_uring or in its
+coalescing buffer. A child in async mode starts its own background thread,
+one using B<set_uring> sets up its own ring, and one with a B<set_coalesce>
+timer starts its own timer thread.
+
+=item * The child stops using the spill file, which belongs to the parent.
+
+=item * The counters returned by B<get_stats> start over from 0, and lines
+the parent suppressed or deduplicated are left for the parent to report.
 
 =back
 
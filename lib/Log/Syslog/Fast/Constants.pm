@@ -13,16 +13,38 @@ our @ISA = qw(Exporter);
 use constant LOG_UDP    => 0; # UDP
 use constant LOG_TCP    => 1; # TCP
 use constant LOG_UNIX   => 2; # UNIX socket
+use constant LOG_TLS    => 3; # TCP with TLS (RFC 5425)
 
 # formats
 use constant LOG_RFC3164 => 0;
 use constant LOG_RFC5424 => 1;
 use constant LOG_RFC3164_LOCAL => 2;
 
+# framings (RFC6587), used on stream sockets only
+use constant LOG_FRAMING_NONE   => 0;
+use constant LOG_FRAMING_OCTET  => 1; # octet counting: "LEN SP MSG"
+use constant LOG_FRAMING_LF     => 2; # non-transparent: "MSG LF"
+
+# overflow policies for non-blocking stream sockets
+use constant LOG_OVERFLOW_DROP_NEWEST   => 0;
+use constant LOG_OVERFLOW_DROP_OLDEST   => 1;
+use constant LOG_OVERFLOW_BLOCK         => 2; # wait up to a deadline, then drop
+use constant LOG_OVERFLOW_ERROR         => 3;
+
+# how a pool of UDP collectors shares out lines
+use constant LOG_POOL_ROUND_ROBIN   => 0;
+use constant LOG_POOL_HASH          => 1; # consistent hash of send_key's key
+
 our @EXPORT = ();
 our %EXPORT_TAGS = (
-    protos =>  [qw/ LOG_TCP LOG_UDP LOG_UNIX /],
+    protos =>  [qw/ LOG_TCP LOG_UDP LOG_UNIX LOG_TLS /],
     formats => [qw/ LOG_RFC3164 LOG_RFC5424 LOG_RFC3164_LOCAL /],
+    framings => [qw/ LOG_FRAMING_NONE LOG_FRAMING_OCTET LOG_FRAMING_LF /],
+    overflows => [qw/
+        LOG_OVERFLOW_DROP_NEWEST LOG_OVERFLOW_DROP_OLDEST
+        LOG_OVERFLOW_BLOCK LOG_OVERFLOW_ERROR
+    /],
+    pools => [qw/ LOG_POOL_ROUND_ROBIN LOG_POOL_HASH /],
 );
 $EXPORT_TAGS{$_} = $Log::Syslog::Constants::EXPORT_TAGS{$_}
     for qw(facilities severities);
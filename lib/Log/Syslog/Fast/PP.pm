@@ -12,13 +12,13 @@ our %EXPORT_TAGS = %Log::Syslog::Fast::Constants::EXPORT_TAGS;
 our @EXPORT_OK = @Log::Syslog::Fast::Constants::EXPORT_OK;
 
 use Carp;
+use Fcntl qw(O_RDWR O_CREAT);
 use POSIX 'strftime';
+use Time::HiRes ();
 use IO::Socket::IP;
 use IO::Socket::UNIX;
 use Socket;
 
-sub DESTROY { }
-
 use constant PRIORITY   => 0;
 use constant SENDER     => 1;
 use constant NAME       => 2;
@@ -28,6 +28,49 @@ use constant LAST_TIME  => 5;
 use constant PREFIX     => 6;
 use constant PREFIX_LEN => 7;
 use constant FORMAT     => 8;
+use constant ZEROCOPY   => 9;
+use constant ASYNC      => 10;
+use constant FRAMING    => 11;
+use constant TIME_PRECISION => 12;
+use constant USEC       => 13;
+use constant NONBLOCK   => 14;
+use constant RECONNECT  => 15;
+use constant SPILL      => 16;
+use constant STATS      => 17;
+use constant SHARED_STATS => 18;
+use constant PROC_PID   => 19;
+use constant RECEIVER   => 20;
+use constant DESTS      => 21;
+use constant POOL       => 22;
+use constant TLS        => 23;
+use constant URING      => 24;
+use constant COALESCE   => 25;
+use constant GSO        => 26;
+use constant MIN_SEVERITY => 27;
+use constant SEVERITY_FILE => 28;
+use constant LIMIT      => 29;
+use constant DEDUP      => 30;
+
+my @STAT_KEYS = qw(
+    sent bytes dropped failed truncated eagain enobufs econnrefused
+    reconnects spilled replayed spill_lost prefix_rebuilds buffer_reallocs
+    filtered suppressed deduplicated
+);
+
+# repeats and suppressed lines not yet reported are reported on the way out
+sub DESTROY {
+    my $self = shift;
+    my $l = $self->[LIMIT];
+    my $d = $self->[DEDUP];
+    return unless $$ == $self->[PROC_PID]
+        && (($d && $d->{pending}) || ($l && $l->{suppressed} && $l->{interval}));
+    local ($@, $!);
+    eval {
+        $self->_stamp(time);
+        $self->_dedup_expire(1) if $d && $d->{pending};
+        $self->_report_suppressed if $l;
+    };
+}
 
 sub new {
     my $ref = shift;
@@ -50,6 +93,28 @@ sub new {
         undef, # prefix
         undef, # prefix_len
         LOG_RFC3164, # format
+        0, # zerocopy
+        0, # async
+        LOG_FRAMING_NONE, # framing
+        0, # time_precision
+        0, # usec
+        0, # nonblock
+        0, # reconnect
+        0, # spill
+        { map { $_ => 0 } @STAT_KEYS }, # stats
+        0, # shared_stats
+        $$, # proc_pid
+        undef, # receiver
+        [], # dests
+        undef, # pool
+        undef, # tls
+        0, # uring
+        undef, # coalesce
+        0, # gso
+        7, # min_severity
+        undef, # severity_file
+        undef, # limit
+        undef, # dedup
     ], $class;
 
     $self->update_prefix(time());
@@ -64,11 +129,16 @@ sub update_prefix {
     my $t = shift;
 
     $self->[LAST_TIME] = $t;
+    $self->[STATS]{prefix_rebuilds}++;
 
     my $timestr = strftime("%h %e %T", localtime $t);
     if ($self->[FORMAT] == LOG_RFC5424) {
         $timestr = strftime("%Y-%m-%dT%H:%M:%S%z", localtime $t);
         $timestr =~ s/(\d{2})$/:$1/; # see http://tools.ietf.org/html/rfc3339#section-5.6 time-numoffset
+        if (my $digits = $self->[TIME_PRECISION]) {
+            my $frac = sprintf ".%0${digits}d", $self->[USEC] / 10 ** (6 - $digits);
+            $timestr =~ s/([+-]\d{2}:\d{2})$/$frac$1/;
+        }
     }
 
     $self->[PREFIX] = sprintf "<%d>%s %s %s[%d]: ",
@@ -83,42 +153,323 @@ sub update_prefix {
     }
 }
 
-sub set_receiver {
-    my $self = shift;
-    croak("hostname required") unless defined $_[1];
-
+# IO::Socket::IP tries a name's addresses one after another rather than
+# racing them, which is as much as pure perl gets
+sub _open_receiver {
     my ($proto, $hostname, $port) = @_;
+    my $sock;
 
     if ($proto == LOG_TCP) {
-        $self->[SOCK] = IO::Socket::IP->new(
+        $sock = IO::Socket::IP->new(
             Proto    => 'tcp',
             PeerHost => $hostname,
             PeerPort => $port,
         );
     }
     elsif ($proto == LOG_UDP) {
-        $self->[SOCK] = IO::Socket::IP->new(
+        $sock = IO::Socket::IP->new(
             Proto    => 'udp',
             PeerHost => $hostname,
             PeerPort => $port,
         );
     }
+    elsif ($proto == LOG_TLS) {
+        $sock = _open_tls($hostname, $port);
+    }
     elsif ($proto == LOG_UNIX) {
         eval {
-            $self->[SOCK] = IO::Socket::UNIX->new(
+            $sock = IO::Socket::UNIX->new(
                 Type => SOCK_STREAM,
                 Peer => $hostname,
             );
         };
-        if ($@ || !$self->[SOCK]) {
-            $self->[SOCK] = IO::Socket::UNIX->new(
+        if ($@ || !$sock) {
+            $sock = IO::Socket::UNIX->new(
                 Type => SOCK_DGRAM,
                 Peer => $hostname,
             );
         }
     }
 
+    return $sock;
+}
+
+# TLS is left to IO::Socket::SSL, loaded only when it's used. Sessions
+# are resumed through a cache shared by every logger; there's no kTLS.
+my %tls_conf;
+my $tls_sessions;
+
+sub set_tls {
+    my (undef, $ca_file, $cert_file, $key_file, $ktls) = @_;
+    eval { require IO::Socket::SSL; 1 }
+        or croak "Error in set_tls: IO::Socket::SSL is needed for TLS";
+    %tls_conf = (
+        defined $ca_file   ? (SSL_ca_file   => $ca_file)   : (),
+        defined $cert_file ? (SSL_cert_file => $cert_file) : (),
+        defined $key_file  ? (SSL_key_file  => $key_file)  : (),
+    );
+}
+
+sub _open_tls {
+    my ($hostname, $port) = @_;
+    eval { require IO::Socket::SSL; 1 }
+        or die "IO::Socket::SSL is needed for TLS\n";
+    $tls_sessions ||= IO::Socket::SSL::Session_Cache->new(64);
+
+    my $sock = IO::Socket::SSL->new(
+        PeerHost            => $hostname,
+        PeerPort            => $port,
+        SSL_version         => 'TLSv1_2:TLSv1_3',
+        SSL_verify_mode     => IO::Socket::SSL::SSL_VERIFY_PEER(),
+        SSL_verifycn_name   => $hostname,
+        SSL_verifycn_scheme => 'default',
+        SSL_hostname        => $hostname,
+        SSL_session_cache   => $tls_sessions,
+        SSL_session_key     => "$hostname:$port",
+        %tls_conf,
+    );
+    die((IO::Socket::SSL->errstr || $!) . "\n") unless $sock;
+    return $sock;
+}
+
+sub set_receiver {
+    my $self = shift;
+    croak("hostname required") unless defined $_[1];
+
+    my ($proto, $hostname, $port) = @_;
+    croak "Error in set_receiver: non-blocking mode can't be combined with TLS"
+        if $proto == LOG_TLS && $self->[NONBLOCK];
+    croak "Error in set_receiver: io_uring can't be combined with TLS"
+        if $proto == LOG_TLS && $self->[URING];
+
+    my $tls = $self->[TLS];
+    $tls = undef unless $tls && $tls->{hostname} eq $hostname && $tls->{port} == $port;
+
+    $self->[RECEIVER] = [ $proto, $hostname, $port ];
+    $self->[TLS] = undef;
+    $self->[SOCK] = _open_receiver($proto, $hostname, $port);
+
     die "Error in ->set_receiver: $!" unless $self->[SOCK];
+
+    if ($proto == LOG_TLS) {
+        # RFC 5425 section 4.3
+        $self->[FRAMING] = LOG_FRAMING_OCTET;
+        $tls ||= { hostname => $hostname, port => $port, handshakes => 0, resumptions => 0 };
+        $tls->{handshakes}++;
+        $tls->{resumptions}++ if $self->[SOCK]->get_session_reused;
+        $self->[TLS] = $tls;
+    }
+}
+
+sub get_tls {
+    my $self = shift;
+    my $tls = $self->[TLS] or return undef;
+    my $sock = $self->[SOCK];
+    return {
+        version     => $sock->get_sslversion,
+        cipher      => $sock->get_cipher,
+        resumed     => $sock->get_session_reused ? 1 : 0,
+        ktls        => 0,
+        handshakes  => $tls->{handshakes},
+        resumptions => $tls->{resumptions},
+    };
+}
+
+# extra receivers get every line too; their sockets don't block, so a full
+# one just misses lines. There are no reconnects in pure perl.
+sub add_receiver {
+    my $self = shift;
+    croak("hostname required") unless defined $_[1];
+
+    my ($proto, $hostname, $port, $framing) = @_;
+    $framing = LOG_FRAMING_NONE unless defined $framing;
+    croak "Error in add_receiver: invalid framing"
+        if $framing < LOG_FRAMING_NONE || $framing > LOG_FRAMING_LF;
+    croak "Error in add_receiver: extra receivers can't use TLS"
+        if $proto == LOG_TLS;
+
+    my $sock = _open_receiver($proto, $hostname, $port)
+        or die "Error in add_receiver: $!";
+    $sock->blocking(0);
+
+    push @{ $self->[DESTS] }, {
+        proto    => $proto,
+        hostname => $hostname,
+        port     => $port,
+        framing  => $framing,
+        sock     => $sock,
+        map { $_ => 0 } qw(sent bytes dropped failed),
+    };
+}
+
+sub clear_receivers {
+    my $self = shift;
+    $self->[DESTS] = [];
+}
+
+sub get_receivers {
+    my $self = shift;
+    return [ map {
+        my $d = $_;
+        +{ (map { $_ => $d->{$_} } qw(proto hostname port framing sent bytes dropped failed)), up => 1 }
+    } @{ $self->[DESTS] } ];
+}
+
+sub _fanout {
+    my $self = shift;
+    for my $d (@{ $self->[DESTS] }) {
+        my $line = $_[0];
+        if ($d->{sock}->socktype == SOCK_STREAM) {
+            $line = length($line) . " $line" if $d->{framing} == LOG_FRAMING_OCTET;
+            $line = "$line\n"                if $d->{framing} == LOG_FRAMING_LF;
+        }
+        my $ret = CORE::send($d->{sock}, $line, 0);
+        if (!defined $ret) {
+            $d->{$!{EAGAIN} || $!{EWOULDBLOCK} ? 'dropped' : 'failed'}++;
+            next;
+        }
+        $d->{sent}++;
+        $d->{bytes} += length $line;
+    }
+}
+
+# FNV-1a finished with murmur3's mixer, as in the XS version, so that both
+# put a key on the same collector
+sub _mul32 {
+    my ($x, $y) = @_;
+    return ($x * ($y & 0xffff) + ((($x * ($y >> 16)) & 0xffff) << 16)) & 0xffffffff;
+}
+
+sub _pool_hash {
+    my $key = shift;
+    utf8::encode($key) if utf8::is_utf8($key);
+
+    my $h = 2166136261;
+    $h = _mul32($h ^ $_, 16777619) for unpack 'C*', $key;
+    $h ^= $h >> 16;
+    $h = _mul32($h, 0x85ebca6b);
+    $h ^= $h >> 13;
+    $h = _mul32($h, 0xc2b2ae35);
+    $h ^= $h >> 16;
+    return $h || 1;
+}
+
+# lines go to a pool of UDP collectors instead of the receiver, in turn or
+# by a consistent hash of send_key's key; one that answers with an ICMP
+# error sits out for $eject_time seconds
+sub set_pool {
+    my $self = shift;
+    my ($collectors, $mode, $eject_time) = @_;
+    $mode = LOG_POOL_ROUND_ROBIN unless defined $mode;
+    $eject_time = 10 unless defined $eject_time;
+
+    croak "Error in set_pool: collectors must be an array reference"
+        if defined $collectors && ref $collectors ne 'ARRAY';
+    croak "Error in set_pool: invalid pool mode"
+        unless $mode == LOG_POOL_ROUND_ROBIN || $mode == LOG_POOL_HASH;
+
+    unless ($collectors && @$collectors) {
+        $self->[POOL] = undef;
+        return;
+    }
+    croak "Error in set_pool: a pool can't be combined with non-blocking mode or reconnects"
+        if $self->[NONBLOCK] || $self->[RECONNECT];
+    croak "Error in set_pool: a pool can't be combined with io_uring"
+        if $self->[URING];
+
+    my (@members, @points);
+    for my $c (@$collectors) {
+        croak "Error in set_pool: each collector must be a [hostname, port] pair"
+            unless ref $c eq 'ARRAY';
+        my ($hostname, $port) = @$c;
+        croak "hostname required" unless defined $hostname;
+
+        my $sock = _open_receiver(LOG_UDP, $hostname, $port)
+            or die "Error in set_pool: $!";
+        push @points, map { [ _pool_hash("$hostname:$port-$_"), scalar @members ] } 0 .. 159;
+        push @members, {
+            hostname      => $hostname,
+            port          => $port,
+            sock          => $sock,
+            ejected_until => 0,
+            map { $_ => 0 } qw(sent bytes failed ejections),
+        };
+    }
+
+    $self->[POOL] = {
+        mode       => $mode,
+        eject_time => $eject_time,
+        members    => \@members,
+        points     => [ sort { $a->[0] <=> $b->[0] } @points ],
+        next       => 0,
+    };
+}
+
+sub get_pool {
+    my $self = shift;
+    my $pool = $self->[POOL] or return [];
+    my $now = Time::HiRes::time();
+    return [ map {
+        my $m = $_;
+        +{ (map { $_ => $m->{$_} } qw(hostname port sent bytes failed ejections)),
+           up => $m->{ejected_until} <= $now ? 1 : 0 }
+    } @{ $pool->{members} } ];
+}
+
+# the first healthy collector at or after the route's point on the ring, or
+# the next healthy one in turn
+sub _pool_pick {
+    my ($pool, $route) = @_;
+    my $members = $pool->{members};
+    my $now = Time::HiRes::time();
+
+    if ($pool->{mode} == LOG_POOL_HASH && $route) {
+        my $points = $pool->{points};
+        my ($lo, $hi) = (0, scalar @$points);
+        while ($lo < $hi) {
+            my $mid = int(($lo + $hi) / 2);
+            if ($points->[$mid][0] < $route) { $lo = $mid + 1 } else { $hi = $mid }
+        }
+        $lo = 0 if $lo == @$points;
+        for my $i (0 .. $#$points) {
+            my $m = $points->[($lo + $i) % @$points][1];
+            return $m if $members->[$m]{ejected_until} <= $now;
+        }
+        return $points->[$lo][1];
+    }
+
+    for (1 .. @$members) {
+        my $m = $pool->{next}++ % @$members;
+        return $m if $members->[$m]{ejected_until} <= $now;
+    }
+    return $pool->{next}++ % @$members;
+}
+
+# a send that reports an ICMP error went nowhere, so the collector is
+# ejected and the line tried on the next one
+sub _pool_send {
+    my ($self, $line, $route) = @_;
+    my $pool = $self->[POOL];
+    my $tries = 0;
+
+    while (1) {
+        my $m = $pool->{members}[ _pool_pick($pool, $route) ];
+        my $ret = CORE::send($m->{sock}, $line, 0);
+        if (defined $ret) {
+            $m->{sent}++;
+            $m->{bytes} += $ret;
+            return $ret;
+        }
+
+        $m->{failed}++;
+        my $unreachable = $!{ECONNREFUSED} || $!{EHOSTUNREACH} || $!{ENETUNREACH};
+        if ($unreachable && $pool->{eject_time} > 0) {
+            $m->{ejected_until} = Time::HiRes::time() + $pool->{eject_time};
+            $m->{ejections}++;
+        }
+        return undef if !$unreachable || ++$tries >= @{ $pool->{members} };
+        $self->_count_failure;
+    }
 }
 
 sub set_priority {
@@ -138,6 +489,229 @@ sub set_severity {
     $self->set_priority($self->get_facility, shift);
 }
 
+sub set_min_severity {
+    my $self = shift;
+    my $severity = shift;
+    if (my $fh = $self->[SEVERITY_FILE]) {
+        sysseek($fh, 0, 0);
+        syswrite($fh, pack('i', $severity));
+    }
+    else {
+        $self->[MIN_SEVERITY] = $severity;
+    }
+}
+
+# pure perl can't map the file, so it's read on every send instead
+sub set_min_severity_file {
+    my $self = shift;
+    my $path = shift;
+    if ($self->[SEVERITY_FILE]) {
+        $self->[MIN_SEVERITY] = $self->get_min_severity;
+        $self->[SEVERITY_FILE] = undef;
+    }
+    return unless defined $path;
+
+    sysopen(my $fh, $path, O_RDWR | O_CREAT, 0644)
+        or croak "Error in set_min_severity_file: $!";
+    if (-s $fh < 4) {
+        syswrite($fh, pack('i', $self->[MIN_SEVERITY])) == 4
+            or croak "Error in set_min_severity_file: $!";
+    }
+    $self->[SEVERITY_FILE] = $fh;
+}
+
+# are lines of this severity less severe than the threshold?
+sub _filtered {
+    my ($self, $severity, $lines) = @_;
+    return 0 if $severity <= $self->get_min_severity;
+    $self->[STATS]{filtered} += $lines || 1;
+    return 1;
+}
+
+# rate limits and sampling as the C version keeps them: token buckets per
+# severity and for the whole logger, refilled from the send time
+sub _bucket {
+    my ($self, $severity, $method) = @_;
+    $severity = -1 unless defined $severity;
+    croak "Error in $method: invalid severity" if $severity < -1 || $severity > 7;
+    my $l = $self->[LIMIT] ||= {
+        map({ ($_ => { rate => 0, burst => 0, tokens => 0, last => 0, sample => 1 }) } -1 .. 7),
+        suppressed => 0,
+        since      => 0,
+        interval   => 10,
+    };
+    return $l->{$severity};
+}
+
+sub set_rate_limit {
+    my ($self, $severity, $rate, $burst) = @_;
+    $burst ||= 0;
+    croak "Error in set_rate_limit: invalid rate limit" if $rate < 0 || ($burst && $burst < 1);
+    my $b = $self->_bucket($severity, 'set_rate_limit');
+    $b->{rate} = $rate;
+    $b->{burst} = $b->{tokens} = $burst || ($rate > 1 ? $rate : 1);
+    $b->{last} = 0;
+}
+
+sub set_sample {
+    my ($self, $severity, $fraction) = @_;
+    croak "Error in set_sample: invalid sampling fraction" unless $fraction >= 0 && $fraction <= 1;
+    $self->_bucket($severity, 'set_sample')->{sample} = $fraction;
+}
+
+sub set_suppress_interval {
+    my ($self, $seconds) = @_;
+    croak "Error in set_suppress_interval: invalid interval" if $seconds < 0;
+    $self->_bucket(-1, 'set_suppress_interval');
+    $self->[LIMIT]{interval} = $seconds;
+}
+
+sub get_rate_limit {
+    my ($self, $severity) = @_;
+    $severity = -1 unless defined $severity;
+    croak "Error in get_rate_limit: invalid severity" if $severity < -1 || $severity > 7;
+    my $b = $self->[LIMIT] ? $self->[LIMIT]{$severity} : { rate => 0, burst => 0, tokens => 0, sample => 1 };
+    return { map { $_ => $b->{$_} } qw(rate burst tokens sample) };
+}
+
+sub get_suppress_interval {
+    my $self = shift;
+    return $self->[LIMIT] ? $self->[LIMIT]{interval} : 10;
+}
+
+sub _level {
+    my ($b, $now) = @_;
+    if ($now > $b->{last}) {
+        $b->{tokens} += ($now - $b->{last}) * $b->{rate};
+        $b->{tokens} = $b->{burst} if $b->{tokens} > $b->{burst};
+    }
+    $b->{last} = $now;
+    return $b->{tokens};
+}
+
+sub _monotonic { Time::HiRes::clock_gettime(Time::HiRes::CLOCK_MONOTONIC()) }
+
+# may a line at this severity go out at monotonic time $now? If not it's
+# tallied as suppressed
+sub _allowed {
+    my ($self, $severity, $now) = @_;
+    my $l = $self->[LIMIT];
+    my ($b, $all) = @{$l}{$severity, -1};
+
+    unless (($b->{sample} < 1 && rand() >= $b->{sample})
+            || ($all->{sample} < 1 && rand() >= $all->{sample})
+            || ($b->{rate} && _level($b, $now) < 1)
+            || ($all->{rate} && _level($all, $now) < 1)) {
+        $_->{tokens}-- for grep { $_->{rate} } $b, $all;
+        return 1;
+    }
+    $l->{since} = $now unless $l->{suppressed};
+    $l->{suppressed}++;
+    $self->[STATS]{suppressed}++;
+    return 0;
+}
+
+# may one line go out now that the prefix is stamped? The tally is
+# reported when due either way
+sub _limited {
+    my ($self, $severity) = @_;
+    $self->[LIMIT] or return 1;
+    my $now = _monotonic();
+    my $ok = $self->_allowed($severity, $now);
+    $self->_report_suppressed($now);
+    return $ok;
+}
+
+# send the tally if it's due at $now, or whatever it is without $now
+sub _report_suppressed {
+    my ($self, $now) = @_;
+    my $l = $self->[LIMIT];
+    return unless $l->{suppressed} && $l->{interval}
+        && (!defined $now || $now - $l->{since} >= $l->{interval});
+    my $pri = ($self->[PRIORITY] & ~7) | LOG_WARNING;
+    (my $prefix = $self->[PREFIX]) =~ s/^<\d+>/<$pri>/;
+    my $msg = "$l->{suppressed} messages suppressed";
+    $l->{suppressed} = 0;
+    $self->_write($prefix . $msg);
+}
+
+# the lines seen last; one that comes again within the window is counted
+# instead of sent, and the count goes out when a different line follows,
+# the window closes or its slot is taken. Lines are compared whole here rather
+# than by hash.
+sub set_dedup {
+    my ($self, $window, $slots) = @_;
+    $slots = 8 unless defined $slots;
+    croak "Error in set_dedup: invalid window" if $window < 0;
+    croak "Error in set_dedup: invalid slot count" if $window && ($slots < 1 || $slots > 64);
+    if ($self->[DEDUP]) {
+        $self->_dedup_expire(1) if $self->[DEDUP]{pending};
+        $self->[DEDUP] = undef;
+    }
+    $self->[DEDUP] = { window => $window, slots => [ map { {} } 1 .. $slots ], pending => 0 }
+        if $window;
+}
+
+sub get_dedup {
+    my $self = shift;
+    return $self->[DEDUP] ? $self->[DEDUP]{window} : 0;
+}
+
+sub _dedup_summarize {
+    my ($self, $s) = @_;
+    my $excerpt = length $s->{msg} > 80 ? substr($s->{msg}, 0, 80) . '...' : $s->{msg};
+    (my $prefix = $self->[PREFIX]) =~ s/^<\d+>/<$s->{prio}>/;
+    my ($msg, $route) = ("message repeated $s->{repeats} times: [$excerpt]", $s->{route});
+    $self->[DEDUP]{pending}--;
+    %$s = ();
+    $self->_write($prefix . $msg, $route);
+}
+
+sub _dedup_expire {
+    my ($self, $force) = @_;
+    my $d = $self->[DEDUP];
+    for my $s (@{ $d->{slots} }) {
+        $self->_dedup_summarize($s)
+            if $s->{repeats} && ($force || $self->[LAST_TIME] - $s->{since} >= $d->{window});
+    }
+}
+
+# is the line a repeat to be counted rather than sent? A different line
+# ends the run of repeats before it, which is summarized first. A line that
+# isn't a repeat takes a slot, the empty or oldest one, summarizing what
+# that held
+sub _repeat {
+    my ($self, $msg, $prio, $route) = @_;
+    my $d = $self->[DEDUP];
+    my $now = $self->[LAST_TIME];
+    utf8::encode($msg) if utf8::is_utf8($msg);
+
+    $self->_dedup_expire if $d->{pending};
+
+    my $victim;
+    for my $s (@{ $d->{slots} }) {
+        if (defined $s->{msg} && $s->{prio} == $prio && $s->{msg} eq $msg) {
+            $self->_dedup_summarize($d->{last}) if $d->{last} != $s && $d->{last}{repeats};
+            $d->{last} = $s;
+            if ($now - $s->{since} < $d->{window}) {
+                $d->{pending}++ unless $s->{repeats}++;
+                $self->[STATS]{deduplicated}++;
+                return 1;
+            }
+            $s->{since} = $now;
+            return 0;
+        }
+        $victim = $s if !$victim || !defined $s->{msg}
+            || (defined $victim->{msg} && $s->{since} < $victim->{since});
+    }
+
+    $self->_dedup_summarize($d->{last}) if $d->{last} && $d->{last}{repeats};
+    $self->_dedup_summarize($victim) if $victim->{repeats};
+    $d->{last} = $victim;
+    %$victim = (msg => $msg, prio => $prio, route => $route, since => $now, repeats => 0);
+    return 0;
+}
+
 sub set_sender {
     my $self = shift;
     croak("sender required") unless defined $_[0];
@@ -164,15 +738,323 @@ sub set_format {
     $self->update_prefix(time);
 }
 
+# no user-space copy to avoid in pure perl; remembered for API compatibility
+sub set_zerocopy {
+    my $self = shift;
+    $self->[ZEROCOPY] = shift() ? 1 : 0;
+}
+
+# pure perl sends each datagram on its own, so segmentation offload never
+# comes into play; remembered for API compatibility
+sub set_gso {
+    my $self = shift;
+    $self->[GSO] = shift() ? 1 : 0;
+}
+
+sub set_framing {
+    my $self = shift;
+    my $framing = shift;
+    croak "Error in set_framing: invalid framing constant"
+        unless $framing == LOG_FRAMING_NONE
+            || $framing == LOG_FRAMING_OCTET
+            || $framing == LOG_FRAMING_LF;
+    croak "Error in set_framing: TLS receivers always use octet-counting framing"
+        if $self->[TLS] && $framing != LOG_FRAMING_OCTET;
+    $self->[FRAMING] = $framing;
+}
+
+# wrap a formatted line in the configured framing; stream sockets only
+sub _frame {
+    my $self = shift;
+    return $_[0] if $self->[FRAMING] == LOG_FRAMING_NONE
+                 || $self->[POOL]
+                 || $self->[SOCK]->socktype != SOCK_STREAM;
+    return length($_[0]) . " $_[0]" if $self->[FRAMING] == LOG_FRAMING_OCTET;
+    return "$_[0]\n";
+}
+
+# sends are always synchronous in pure perl, so there is never anything to
+# flush; the queue size is remembered for API compatibility
+sub set_async {
+    my $self = shift;
+    my $size = shift;
+    croak "Error in set_async: async mode can't be combined with coalescing"
+        if $size > 0 && $self->[COALESCE];
+    $self->[ASYNC] = $size > 0 ? $size : 0;
+}
+
+# lines are never queued, but tallies of suppressed and repeated lines are sent
+sub flush {
+    my $self = shift;
+    $self->_report_suppressed if $self->[LIMIT];
+    $self->_dedup_expire(1) if $self->[DEDUP] && $self->[DEDUP]{pending};
+    return 1;
+}
+
+# pure perl sockets stay blocking, so no line ever overflows; the settings
+# are only checked and remembered for API compatibility
+sub set_nonblock {
+    my $self = shift;
+    my ($size, $policy) = @_;
+    $policy = LOG_OVERFLOW_DROP_NEWEST unless defined $policy;
+    croak "Error in set_nonblock: invalid overflow policy"
+        if $policy < LOG_OVERFLOW_DROP_NEWEST || $policy > LOG_OVERFLOW_ERROR;
+    croak "Error in set_nonblock: non-blocking mode can't be combined with a pool"
+        if $size > 0 && $self->[POOL];
+    croak "Error in set_nonblock: non-blocking mode can't be combined with TLS"
+        if $size > 0 && $self->[TLS];
+    croak "Error in set_nonblock: non-blocking mode can't be combined with io_uring"
+        if $size > 0 && $self->[URING];
+    croak "Error in set_nonblock: non-blocking mode can't be combined with coalescing"
+        if $size > 0 && $self->[COALESCE];
+    $self->[NONBLOCK] = $size > 0 ? $size : 0;
+}
+
+# pure perl sends keep failing loudly; the delay is only remembered for API
+# compatibility
+sub set_reconnect {
+    my $self = shift;
+    my $delay = shift;
+    croak "Error in set_reconnect: reconnects can't be combined with a pool"
+        if $delay > 0 && $self->[POOL];
+    croak "Error in set_reconnect: reconnects can't be combined with io_uring"
+        if $delay > 0 && $self->[URING];
+    $self->[RECONNECT] = $delay > 0 ? $delay : 0;
+}
+
+# nothing is ever dropped for lack of a connection in pure perl, so there is
+# nothing to spill; the size is only remembered for API compatibility
+sub set_spill {
+    my $self = shift;
+    my ($path, $size) = @_;
+    $self->[SPILL] = defined $path && $size ? $size : 0;
+}
+
+# pure perl has no way to reach io_uring, so every send stays a syscall; the
+# queue size is only checked and remembered for API compatibility
+sub set_uring {
+    my $self = shift;
+    my $entries = shift;
+    croak "Error in set_uring: io_uring can't be combined with async or non-blocking mode, reconnects, a pool, TLS or coalescing"
+        if $entries > 0 && ($self->[ASYNC] || $self->[NONBLOCK] || $self->[RECONNECT]
+                            || $self->[POOL] || $self->[TLS] || $self->[COALESCE]);
+    $self->[URING] = $entries > 0 ? $entries : 0;
+}
+
+sub get_uring {
+    my $self = shift;
+    return undef unless $self->[URING];
+    return { entries => $self->[URING], sqpoll => 0, fixed => 0, in_flight => 0 };
+}
+
+# pure perl writes each line as it's sent, so nothing is ever buffered; the
+# settings are only checked and remembered for API compatibility
+sub set_coalesce {
+    my $self = shift;
+    my ($size, $max_delay, $timer) = @_;
+    $max_delay = 0.05 unless defined $max_delay;
+    croak "Error in set_coalesce: coalescing can't be combined with async or non-blocking mode or io_uring"
+        if $size > 0 && ($self->[ASYNC] || $self->[NONBLOCK] || $self->[URING]);
+    $self->[COALESCE] = $size > 0 ? [$size, $max_delay] : undef;
+}
+
+sub get_coalesce {
+    my $self = shift;
+    return undef unless $self->[COALESCE];
+    my ($size, $max_delay) = @{ $self->[COALESCE] };
+    return { size => $size, max_delay => $max_delay, timer => 0, lines => 0, bytes => 0 };
+}
+
+# pure perl has no atomic adds to share counters safely between processes;
+# the slot count is only checked and remembered for API compatibility
+sub set_shared_stats {
+    my $self = shift;
+    my ($path, $slots) = @_;
+    $slots = 256 unless defined $slots;
+    croak "Error in set_shared_stats: shared stats need at least one slot"
+        if defined $path && $slots <= 0;
+    $self->[SHARED_STATS] = defined $path ? $slots : 0;
+}
+
+# IO::Socket::IP resolves on every connect and there are no threads to
+# refresh a cache with in pure perl; like the XS setting this applies to the
+# whole process, and is only checked and remembered for API compatibility
+my $dns_cache = 0;
+
+sub set_dns_cache {
+    my (undef, $ttl) = @_;
+    $dns_cache = $ttl > 0 ? $ttl : 0;
+}
+
+sub get_dns_cache { $dns_cache }
+
+sub set_time_precision {
+    my $self = shift;
+    my $digits = shift;
+    croak "Error in set_time_precision: time precision must be between 0 and 6 digits"
+        if $digits < 0 || $digits > 6;
+    $self->[TIME_PRECISION] = $digits;
+    $self->update_prefix(time);
+}
+
+# first use in a forked child: take on the child's pid unless one was set
+# by hand, and connect a stream of its own so lines don't interleave
+sub _adopt_after_fork {
+    my $self = shift;
+
+    $self->[PID] = $$ if $self->[PID] == $self->[PROC_PID];
+    $self->[PROC_PID] = $$;
+    $self->reset_stats;
+    $self->update_prefix($self->[LAST_TIME]);
+
+    # lines the parent suppressed are the parent's to report
+    $self->[LIMIT]{suppressed} = 0 if $self->[LIMIT];
+    if (my $d = $self->[DEDUP]) {
+        %$_ = () for @{ $d->{slots} };
+        $d->{pending} = 0;
+    }
+
+    if ($self->[SOCK]->socktype == SOCK_STREAM) {
+        my $inherited = $self->[SOCK];
+        my $tls = $self->[TLS];
+        eval { $self->set_receiver(@{ $self->[RECEIVER] }) };
+        # the parent's TLS session can't be shared; let go of it quietly
+        $inherited->close(SSL_no_shutdown => 1) if $tls;
+        $self->[SOCK] = $inherited if $@; # keep sharing the parent's
+    }
+
+    for my $d (@{ $self->[DESTS] }) {
+        $d->{$_} = 0 for qw(sent bytes dropped failed);
+        next unless $d->{sock}->socktype == SOCK_STREAM;
+        my $sock = _open_receiver(@{$d}{qw(proto hostname port)}) or next;
+        $sock->blocking(0);
+        $d->{sock} = $sock;
+    }
+}
+
+# bring the prefix up to date for a send at $now, which may be fractional
+sub _stamp {
+    my $self = shift;
+    my $now = shift;
+
+    $self->_adopt_after_fork if $$ != $self->[PROC_PID];
+
+    if ($self->[TIME_PRECISION]) {
+        $now ||= Time::HiRes::time();
+        $self->[USEC] = int(($now - int $now) * 1_000_000);
+        $self->update_prefix(int $now);
+    }
+    else {
+        $now ||= time;
+
+        # update the prefix if seconds have rolled over
+        $self->update_prefix($now) if $now != $self->[LAST_TIME];
+    }
+}
+
+sub _count_failure {
+    my $stats = $_[0][STATS];
+    $stats->{failed}++;
+    $stats->{eagain}++       if $!{EAGAIN} || $!{EWOULDBLOCK};
+    $stats->{enobufs}++      if $!{ENOBUFS};
+    $stats->{econnrefused}++ if $!{ECONNREFUSED};
+}
+
+# send one formatted line, with send_key's route if any, keeping the
+# counters up to date
+sub _write {
+    my $self = shift;
+    $self->_fanout($_[0]) if @{ $self->[DESTS] };
+
+    my $line = $self->_frame($_[0]);
+    my $stats = $self->[STATS];
+
+    my $ret = $self->[POOL] ? $self->_pool_send($line, $_[1])
+            : $self->[TLS]  ? ($self->[SOCK]->print($line) ? length $line : undef)
+            :                 CORE::send($self->[SOCK], $line, 0);
+    if (!defined $ret) {
+        $self->_count_failure;
+        return $ret;
+    }
+    $stats->{sent}++;
+    $stats->{bytes} += $ret;
+    $stats->{truncated}++ if $ret < length $line;
+    return $ret;
+}
+
 sub send {
-    my $now = $_[2] || time;
+    return 0 if $_[0]->_filtered($_[0][PRIORITY] & 7);
+    $_[0]->_stamp($_[2]);
+    return 0 if $_[0][DEDUP] && $_[0]->_repeat($_[1], $_[0][PRIORITY]);
+    return 0 unless $_[0]->_limited($_[0][PRIORITY] & 7);
+
+    $_[0]->_write($_[0][PREFIX] . $_[1]) || die "Error while sending: $!";
+}
+
+sub send_prio {
+    my ($self, $msg, $severity, $facility, $now) = @_;
+    $facility = $self->get_facility unless defined $facility;
+    die "Error while sending: invalid severity" if $severity < 0 || $severity > 7;
+    die "Error while sending: invalid facility" if $facility < 0 || $facility > 23;
+    return 0 if $self->_filtered($severity);
+
+    $self->_stamp($now);
+    return 0 if $self->[DEDUP] && $self->_repeat($msg, ($facility << 3) | $severity);
+    return 0 unless $self->_limited($severity);
+
+    (my $prefix = $self->[PREFIX]) =~ s/^<\d+>/'<' . (($facility << 3) | $severity) . '>'/e;
+    $self->_write($prefix . $msg) || die "Error while sending: $!";
+}
 
-    # update the prefix if seconds have rolled over
-    if ($now != $_[0][LAST_TIME]) {
-        $_[0]->update_prefix($now);
+sub send_key {
+    my ($self, $key, $msg, $now) = @_;
+    return 0 if $self->_filtered($self->[PRIORITY] & 7);
+    my $route = _pool_hash($key);
+    $self->_stamp($now);
+    return 0 if $self->[DEDUP] && $self->_repeat($msg, $self->[PRIORITY], $route);
+    return 0 unless $self->_limited($self->[PRIORITY] & 7);
+    $self->_write($self->[PREFIX] . $msg, $route) || die "Error while sending: $!";
+}
+
+sub send_many {
+    return 0 if !@{ $_[1] } || $_[0]->_filtered($_[0][PRIORITY] & 7, scalar @{ $_[1] });
+    $_[0]->_stamp($_[2]);
+    my ($self, $msgs) = @_;
+    return $self->_write_lines($msgs, 0) unless $self->[DEDUP] || $self->[LIMIT];
+
+    my $now = $self->[LIMIT] ? _monotonic() : undef;
+    my ($sent, @kept) = (0);
+    for my $msg (@$msgs) {
+        if ($self->[DEDUP]) {
+            # a summary goes out after the lines kept ahead of it
+            if ($self->[DEDUP]{pending} && @kept) {
+                my $n = $self->_write_lines(\@kept, $sent);
+                $sent += $n;
+                return $sent if $n < @kept;
+                @kept = ();
+            }
+            next if $self->_repeat($msg, $self->[PRIORITY]);
+        }
+        next if $self->[LIMIT] && !$self->_allowed($self->[PRIORITY] & 7, $now);
+        push @kept, $msg;
     }
+    $self->_report_suppressed($now) if $self->[LIMIT];
+    return $sent + $self->_write_lines(\@kept, $sent);
+}
 
-    send($_[0][SOCK], $_[0][PREFIX] . $_[1], 0) || die "Error while sending: $!";
+# write lines after $sent others of the batch, returning how many went out
+# before one failed; a failure dies if none of the batch went out at all
+sub _write_lines {
+    my ($self, $msgs, $sent) = @_;
+    my $n = 0;
+    for my $msg (@$msgs) {
+        unless ($self->_write($self->[PREFIX] . $msg)) {
+            die "Error while sending: $!" unless $sent + $n;
+            last;
+        }
+        $n++;
+    }
+    return $n;
 }
 
 #no warnings 'redefine';
@@ -192,6 +1074,14 @@ sub get_severity {
     return $self->[PRIORITY] & 7;
 }
 
+sub get_min_severity {
+    my $self = shift;
+    my $fh = $self->[SEVERITY_FILE] or return $self->[MIN_SEVERITY];
+    sysseek($fh, 0, 0);
+    my $word;
+    return sysread($fh, $word, 4) == 4 ? unpack('i', $word) : $self->[MIN_SEVERITY];
+}
+
 sub get_sender {
     my $self = shift;
     return $self->[SENDER];
@@ -212,6 +1102,58 @@ sub get_format {
     return $self->[FORMAT];
 }
 
+sub get_zerocopy {
+    my $self = shift;
+    return $self->[ZEROCOPY];
+}
+
+sub get_gso { 0 }
+
+sub get_framing {
+    my $self = shift;
+    return $self->[FRAMING];
+}
+
+sub get_time_precision {
+    my $self = shift;
+    return $self->[TIME_PRECISION];
+}
+
+sub get_async {
+    my $self = shift;
+    return $self->[ASYNC];
+}
+
+sub get_reconnect {
+    my $self = shift;
+    return $self->[RECONNECT];
+}
+
+sub get_spill {
+    my $self = shift;
+    return $self->[SPILL];
+}
+
+sub get_nonblock {
+    my $self = shift;
+    return $self->[NONBLOCK];
+}
+
+sub get_shared_stats {
+    my $self = shift;
+    return $self->[SHARED_STATS];
+}
+
+sub get_stats {
+    my $self = shift;
+    return { %{ $self->[STATS] } };
+}
+
+sub reset_stats {
+    my $self = shift;
+    $_ = 0 for values %{ $self->[STATS] };
+}
+
 sub _get_sock {
     my $self = shift;
     return $self->[SOCK]->fileno;
@@ -0,0 +1,129 @@
+package Log::Syslog::Fast::SharedStats;
+
+use strict;
+use warnings;
+
+use Carp;
+
+# must match struct LSF_shstats_hdr and struct LSF_shstats_row in
+# LogSyslogFast.c
+use constant MAGIC      => 'LSFSTAT1';
+use constant BUCKETS    => 8;
+use constant HDR_FMT    => 'a8 L L';
+use constant HDR_LEN    => 16;
+use constant ROW_FMT    => 'Q' x (5 + BUCKETS);
+use constant ROW_LEN    => 8 * (5 + BUCKETS);
+
+our @LATENCY_BOUNDS = qw(1us 10us 100us 1ms 10ms 100ms 1s inf);
+
+sub _row {
+    my ($pid, $sent, $bytes, $dropped, $failed, @latency) = unpack ROW_FMT, shift;
+    return {
+        pid     => $pid,
+        sent    => $sent,
+        bytes   => $bytes,
+        dropped => $dropped,
+        failed  => $failed,
+        latency => \@latency,
+    };
+}
+
+sub read {
+    my $class = shift;
+    my $path = shift;
+
+    croak "path required" unless defined $path;
+    open my $fh, '<', $path or croak "Error opening $path: $!";
+    binmode $fh;
+    local $/;
+    my $data = <$fh>;
+    close $fh;
+
+    my ($magic, $slots, $row_size) = unpack HDR_FMT, $data;
+    croak "$path is not a shared stats file"
+        unless defined $row_size && $magic eq MAGIC && $row_size == ROW_LEN
+            && length $data >= HDR_LEN + ($slots + 1) * ROW_LEN;
+
+    my $total = _row(substr $data, HDR_LEN, ROW_LEN);
+    delete $total->{pid};
+
+    my @workers;
+    for my $i (0 .. $slots - 1) {
+        my $row = _row(substr $data, HDR_LEN + ($i + 1) * ROW_LEN, ROW_LEN);
+        next unless $row->{pid};
+        $row->{alive} = kill(0, $row->{pid}) || $!{EPERM} ? 1 : 0;
+        push @workers, $row;
+    }
+
+    return {
+        slots   => $slots,
+        total   => $total,
+        workers => \@workers,
+    };
+}
+
+1;
+__END__
+
+=head1 NAME
+
+Log::Syslog::Fast::SharedStats - Read the counters that loggers in many
+processes keep in a shared stats file
+
+=head1 SYNOPSIS
+
+  # in the parent, before forking workers
+  $logger->set_shared_stats('/run/myapp/syslog.stats');
+
+  # anywhere else, e.g. from a monitoring script
+  use Log::Syslog::Fast::SharedStats;
+  my $stats = Log::Syslog::Fast::SharedStats->read('/run/myapp/syslog.stats');
+  printf "%d sent, %d dropped\n", $stats->{total}{sent}, $stats->{total}{dropped};
+
+=head1 DESCRIPTION
+
+Loggers given the same file with B<set_shared_stats> in L<Log::Syslog::Fast>
+add to a row of totals and to a row of their own process in it. This module
+reads a snapshot of the file without locking or otherwise disturbing the
+processes writing to it. It needs a perl with 64-bit integers.
+
+=head1 METHODS
+
+=over 4
+
+=item Log::Syslog::Fast::SharedStats-E<gt>read($path)
+
+Returns a reference to a hash with these keys:
+
+=over 4
+
+=item * slots
+
+The number of per-process rows in the file.
+
+=item * total
+
+A hash of the counters summed over every process that has used the file,
+including processes that have exited.
+
+=item * workers
+
+A list of hashes, one for each process row in use, with its I<pid> and
+whether that process is still I<alive>, along with its counters. The row of
+a process that has exited is kept until a new process reuses it.
+
+=back
+
+Each set of counters has I<sent>, I<bytes>, I<dropped> and I<failed>, with
+the same meaning as in B<get_stats>, and I<latency>. I<latency> is a list of
+8 counts of sends (or batches of sends) by how long the socket calls took:
+under 1us, 10us, 100us, 1ms, 10ms, 100ms and 1s, then longer. Labels for the
+buckets are in C<@Log::Syslog::Fast::SharedStats::LATENCY_BOUNDS>.
+
+=back
+
+=head1 SEE ALSO
+
+L<Log::Syslog::Fast>, L<syslog-fast-stats>
+
+=cut
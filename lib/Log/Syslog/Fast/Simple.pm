@@ -12,7 +12,7 @@ our @EXPORT      = qw();
 our %EXPORT_TAGS = %Log::Syslog::Fast::Constants::EXPORT_TAGS;
 our @EXPORT_OK   = @Log::Syslog::Fast::Constants::EXPORT_OK;
 
-use constant _LOGGERS   => 0;
+use constant _LOGGER    => 0;
 use constant _ARGS      => 1;
 
 use constant _PROTO     => 0;
@@ -44,29 +44,24 @@ sub new {
     $args->{format}     ||= LOG_RFC3164;
 
     return bless [
-        [],    # loggers
+        undef, # logger
         [@{ $args }{qw/
             proto hostname port facility severity sender name format
         /}],
     ], $class;
 }
 
-sub send {
-    my $severity = $_[3] || $_[0][_ARGS][_SEVERITY];
-    my $facility = $_[4] || $_[0][_ARGS][_FACILITY];
+# ->send is implemented in Fast.xs. It calls this on first use to connect the
+# one logger that messages of every facility and severity share.
+sub _connect {
+    my $self = shift;
 
-    my $logger = $_[0][_LOGGERS][$facility][$severity];
-    if (!$logger) {
-        my @args = @{ $_[0][_ARGS] };
-        $args[_FACILITY] = $facility;
-        $args[_SEVERITY] = $severity;
+    my @args = @{ $self->[_ARGS] };
+    my $format = pop(@args);
+    my $logger = Log::Syslog::Fast->new(@args);
+    $logger->set_format($format);
 
-        my $format = pop(@args);
-        $logger = $_[0][_LOGGERS][$facility][$severity] = Log::Syslog::Fast->new(@args);
-        $logger->set_format($format);
-    }
-
-    return $logger->send($_[1], $_[2] || time);
+    return $self->[_LOGGER] = $logger;
 }
 
 1;
@@ -75,7 +70,7 @@ __END__
 =head1 NAME
 
 Log::Syslog::Fast::Simple - Wrapper around Log::Syslog::Fast that adds some
-flexibility at the expense of additional runtime overhead.
+flexibility with little additional runtime overhead.
 
 =head1 SYNOPSIS
 
@@ -102,6 +97,9 @@ This module wraps L<Log::Syslog::Fast> to provide a constructor with reasonable
 defaults and a send() method that optionally accepts override parameters for
 facility and severity.
 
+The send() method is implemented in C. All facilities and severities share a
+single connection, which is made on the first call to send().
+
 =head1 METHODS
 
 =over 4
@@ -1,8 +1,9 @@
 use strict;
 use warnings;
 
-use Test::More tests => 3;
+use Test::More tests => 4;
 
 use_ok('Log::Syslog::Fast');
 use_ok('Log::Syslog::Fast::Simple');
 use_ok('Log::Syslog::Fast::PP');
+use_ok('Log::Syslog::Fast::SharedStats');
@@ -1,10 +1,14 @@
 use strict;
 use warnings;
 
-use Test::More tests => 7;
+use Test::More tests => 12;
 
 use Log::Syslog::Fast::Simple ':all';
 
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
 my $logger = Log::Syslog::Fast::Simple->new(
     proto    => LOG_UDP,
     loghost  => 'localhost',
@@ -35,3 +39,39 @@ ok(!$@, "->send with overrides doesn't throw");
 # just check one of each
 is(LOG_DEBUG,    7,  'LOG_DEBUG');
 is(LOG_LOCAL0,   16, 'LOG_LOCAL0');
+
+# every priority goes out over the same connection
+{
+    my $server = make_server('udp');
+    my $receiver = $server->accept;
+    my ($host, $port) = $server->address;
+    my $simple = Log::Syslog::Fast::Simple->new(
+        proto    => LOG_UDP,
+        hostname => $host,
+        port     => $port,
+        facility => LOG_LOCAL1,
+        severity => LOG_DEBUG,
+        sender   => 'localhost',
+        name     => 'test',
+    );
+    my $time = time;
+
+    my @cases = (
+        [[],                       LOG_LOCAL1, LOG_DEBUG],
+        [[LOG_ERR],                LOG_LOCAL1, LOG_ERR],
+        [[LOG_WARNING, LOG_MAIL],  LOG_MAIL,   LOG_WARNING],
+        [[0, LOG_LOCAL5],          LOG_LOCAL5, LOG_DEBUG],
+    );
+    my $sock;
+    for my $case (@cases) {
+        my ($overrides, $facility, $severity) = @$case;
+        $simple->send('msg', $time, @$overrides);
+        $sock = $simple->[0]->_get_sock unless defined $sock;
+
+        my $buf;
+        $receiver->recv($buf, 256) if wait_for_readable($receiver);
+        is($buf, expected_payload($facility, $severity, 'localhost', 'test', $$, 'msg', $time),
+            "->send with @{[ scalar @$overrides ]} override(s)");
+    }
+    is($simple->[0]->_get_sock, $sock, 'one socket shared by all priorities');
+}
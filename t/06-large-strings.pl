@@ -1,4 +1,4 @@
-use Test::More tests => 10;
+use Test::More tests => 22;
 use IO::Select;
 use IO::Socket::INET;
 use POSIX 'strftime';
@@ -11,7 +11,8 @@ use Test::LogSyslogFast;
 
 my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
 
-for my $p (qw(udp)) {
+for my $case (['udp', 0], ['udp', 1]) {
+    my ($p, $zerocopy) = @$case;
 
     # basic behavior
     eval {
@@ -25,6 +26,9 @@ for my $p (qw(udp)) {
         my $receiver = $server->accept;
         ok($receiver, "$p: accepted");
 
+        $logger->set_zerocopy($zerocopy);
+        is($logger->get_zerocopy, $zerocopy, "$p: zerocopy is $zerocopy");
+
         my $time = time;
 
         my $msg = '.' x 4500; # larger than INITIAL_BUFSIZE
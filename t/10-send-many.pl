@@ -0,0 +1,57 @@
+use Test::More tests => 24;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+for my $p (qw( tcp udp unix_dgram unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+
+        my $time = time;
+        my @msgs = map { "batched $_" } 1 .. 3;
+        my @expected = map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+        my $sent = eval { $logger->send_many(\@msgs, $time) };
+        ok(!$@, "$p: ->send_many doesn't throw");
+        is($sent, scalar @msgs, "$p: ->send_many sent every message");
+
+        is(eval { $logger->send_many([], $time) }, 0, "$p: ->send_many of nothing sends nothing");
+
+        my $buf = '';
+        while (wait_for_readable($receiver)) {
+            $receiver->recv(my $chunk, 1024);
+            last unless length $chunk;
+            if ($server->isa('DgramServer')) {
+                $buf .= "$chunk\n";
+            }
+            else {
+                $buf .= $chunk;
+            }
+            last if length $buf >= length join '', @expected;
+        }
+
+        if ($server->isa('DgramServer')) {
+            is($buf, join('', map { "$_\n" } @expected), "$p: one datagram per message");
+        }
+        else {
+            is($buf, join('', @expected), "$p: messages written back to back");
+        }
+
+        # a batch larger than a single syscall's worth; unix datagram
+        # sockets have too short a queue to take it without a reader
+        SKIP: {
+            skip "$p: receive queue too short", 2 if $p eq 'unix_dgram';
+            my @many = map { "m$_" } 1 .. 200;
+            is(eval { $logger->send_many(\@many, $time) }, 200, "$p: large batch sent");
+            ok(!$@, "$p: large batch doesn't throw");
+        }
+    };
+    diag($@) if $@;
+}
+
+1;
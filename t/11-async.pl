@@ -0,0 +1,56 @@
+use Test::More tests => 28;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+sub read_lines {
+    my ($server, $receiver, $want) = @_;
+    my $buf = '';
+    while (length $buf < $want && wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 4096);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+for my $p (qw( tcp udp unix_dgram unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+
+        eval { $logger->set_async(8192) };
+        ok(!$@, "$p: ->set_async doesn't throw");
+        ok($logger->get_async >= 8192, "$p: async queue is at least as large as requested");
+
+        my $time = time;
+        my @msgs = map { "async $_" } 1 .. 5;
+        my $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+        my $queued = 0;
+        $queued += $logger->send($_, $time) for @msgs;
+        is($queued, length $expected, "$p: ->send reports bytes queued");
+
+        ok($logger->flush(5), "$p: ->flush drains the queue");
+        is(read_lines($server, $receiver, length $expected), $expected, "$p: queued messages arrive in order");
+
+        # a message larger than the whole queue is dropped, not sent
+        SKIP: {
+            skip "$p: pure perl sends synchronously", 1 if $CLASS =~ /PP/;
+            is($logger->send('x' x 10000, $time), 0, "$p: oversized message is dropped");
+        }
+
+        # messages still queued at destruction are delivered
+        my $last = expected_payload(@params, $$, 'last words', $time);
+        $logger->send('last words', $time);
+        undef $logger;
+        is(read_lines($server, $receiver, length $last), $last, "$p: queue drained on destroy");
+    };
+    diag($@) if $@;
+}
+
+1;
@@ -0,0 +1,8 @@
+use strict;
+use warnings;
+
+our $CLASS = 'Log::Syslog::Fast';
+use Log::Syslog::Constants ':all';
+use Log::Syslog::Fast ':protos';
+
+require 't/11-async.pl';
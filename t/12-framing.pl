@@ -0,0 +1,46 @@
+use Test::More tests => 27;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+my %framers = (
+    LOG_FRAMING_NONE()  => sub { $_[0] },
+    LOG_FRAMING_OCTET() => sub { length($_[0]) . " $_[0]" },
+    LOG_FRAMING_LF()    => sub { "$_[0]\n" },
+);
+
+for my $p (qw( tcp unix_stream udp )) {
+    for my $framing (LOG_FRAMING_NONE, LOG_FRAMING_OCTET, LOG_FRAMING_LF) {
+        eval {
+            my $server = make_server($p);
+            my $logger = $server->connect($CLASS => @params);
+            my $receiver = $server->accept;
+
+            $logger->set_framing($framing);
+            is($logger->get_framing, $framing, "$p/$framing: framing set");
+
+            my $time = time;
+            my @msgs = ("multi\nline", "second");
+            my $frame = $p eq 'udp' ? $framers{LOG_FRAMING_NONE()} : $framers{$framing};
+            my @expected = map { $frame->(expected_payload(@params, $$, $_, $time)) } @msgs;
+
+            is($logger->send($msgs[0], $time), length $expected[0], "$p/$framing: ->send counts framing bytes");
+            $logger->send_many([ $msgs[1] ], $time);
+
+            my $buf = '';
+            while (wait_for_readable($receiver)) {
+                $receiver->recv(my $chunk, 1024);
+                last unless length $chunk;
+                $buf .= $chunk;
+                last if length $buf >= length join '', @expected;
+            }
+            is($buf, join('', @expected), "$p/$framing: framed payload");
+        };
+        diag($@) if $@;
+    }
+}
+
+1;
@@ -0,0 +1,81 @@
+use Test::More tests => 11;
+use POSIX qw(strftime tzset);
+
+use lib 't/lib';
+use LSF;
+
+# the prefix's timestamp is patched incrementally as seconds, minutes, days
+# and UTC offsets roll over; check it against strftime across all of them
+
+my @params = (LOG_LOCAL0, LOG_INFO, 'localhost', 'test');
+
+# a DST start, a DST end and a year boundary, visited out of order
+my @times = map { my $base = $_; map { $base + $_ * 37 } -100 .. 200 }
+    1710050000, 1730600000, 1704067100;
+push @times, reverse @times;
+
+for my $tz (qw( America/Los_Angeles Asia/Kolkata UTC )) {
+    local $ENV{TZ} = $tz;
+    tzset();
+
+    for my $format (LOG_RFC3164, LOG_RFC5424) {
+        eval {
+            my $server = make_server('udp');
+            my $logger = $server->connect($CLASS => @params);
+            my $receiver = $server->accept;
+            $logger->set_format($format);
+
+            my @bad;
+            for my $t (@times) {
+                $logger->send('m', $t);
+                wait_for_readable($receiver) or die "timed out";
+                $receiver->recv(my $buf, 512);
+
+                my $ts;
+                if ($format == LOG_RFC5424) {
+                    ($ts = strftime("%Y-%m-%dT%H:%M:%S%z", localtime $t)) =~ s/(\d{2})$/:$1/;
+                }
+                else {
+                    $ts = strftime("%h %e %T", localtime $t);
+                }
+                push @bad, "$t: $buf" if index($buf, " $ts ") < 0 && index($buf, ">$ts ") < 0;
+            }
+            is(scalar @bad, 0, "$tz/$format: timestamps match strftime")
+                or diag(join "\n", @bad[0 .. ($#bad > 4 ? 4 : $#bad)]);
+        };
+        diag($@) if $@;
+    }
+}
+
+# fractional seconds in RFC5424
+eval {
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_format(LOG_RFC5424);
+
+    my $recv = sub {
+        wait_for_readable($receiver) or die "timed out";
+        $receiver->recv(my $buf, 512);
+        return $buf;
+    };
+
+    my $t = 1700000000.015625; # exactly representable
+    for my $case ([3, '.015'], [6, '.015625'], [1, '.0']) {
+        my ($digits, $frac) = @$case;
+        $logger->set_time_precision($digits);
+        $logger->send('m', $t);
+        like($recv->(), qr/:20\Q$frac\E[+-]\d\d:\d\d /, "$digits digits of fraction");
+    }
+
+    $logger->set_time_precision(3, 1);
+    $logger->send('m');
+    like($recv->(), qr/:\d\d\.\d{3}[+-]\d\d:\d\d /, "coarse clock read when no time given");
+
+    $logger->set_time_precision(0);
+    $logger->send('m', $t);
+    like($recv->(), qr/:20[+-]\d\d:\d\d /, "no fraction by default");
+};
+diag($@) if $@;
+
+1;
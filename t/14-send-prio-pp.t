@@ -0,0 +1,8 @@
+use strict;
+use warnings;
+
+our $CLASS = 'Log::Syslog::Fast::PP';
+use Log::Syslog::Constants ':all';
+use Log::Syslog::Fast::PP qw(:protos :framings);
+
+require 't/14-send-prio.pl';
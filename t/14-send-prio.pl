@@ -0,0 +1,63 @@
+use Test::More tests => 15;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+sub recv_all {
+    my ($receiver, $want) = @_;
+    my $buf = '';
+    while (length $buf < $want && wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 1024);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+for my $p (qw( tcp udp unix_dgram unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        my $time = time;
+
+        my $expected = expected_payload(LOG_AUTH, LOG_ERR, 'localhost', 'test', $$, 'sev', $time);
+        $logger->send_prio('sev', LOG_ERR, undef, $time);
+        is(recv_all($receiver, length $expected), $expected, "$p: severity override");
+
+        $expected = expected_payload(LOG_LOCAL7, LOG_DEBUG, 'localhost', 'test', $$, 'fac', $time);
+        $logger->send_prio('fac', LOG_DEBUG, LOG_LOCAL7, $time);
+        is(recv_all($receiver, length $expected), $expected, "$p: facility and severity override");
+
+        $expected = expected_payload(@params, $$, 'plain', $time);
+        $logger->send('plain', $time);
+        is(recv_all($receiver, length $expected), $expected, "$p: logger's own priority is untouched");
+    };
+    diag($@) if $@;
+}
+
+# octet counting accounts for a PRI of a different width
+eval {
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_framing(LOG_FRAMING_OCTET);
+
+    my $time = time;
+    my $line = expected_payload(LOG_KERN, LOG_EMERG, 'localhost', 'test', $$, 'x', $time);
+    my $expected = length($line) . " $line";
+    is($logger->send_prio('x', LOG_EMERG, LOG_KERN, $time), length $expected, "framed ->send_prio returns bytes sent");
+    is(recv_all($receiver, length $expected), $expected, "framed ->send_prio has correct octet count");
+};
+diag($@) if $@;
+
+eval {
+    my $logger = $CLASS->new(LOG_UDP, 'localhost', 514, @params);
+    $logger->send_prio('x', 8);
+};
+like($@, qr/invalid severity/, "bad severity throws");
+
+1;
@@ -0,0 +1,105 @@
+use Test::More tests => 22;
+
+use lib 't/lib';
+use LSF;
+use IO::Select ();
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+my $filler = 'x' x 4000;
+
+# read what the logger has buffered until it reports nothing is left
+sub drain {
+    my ($logger, $receiver) = @_;
+    my $buf = '';
+    my $select = IO::Select->new($receiver);
+    for (1 .. 1000) {
+        my $done = $logger->flush(0);
+        my $got = 0;
+        while ($select->can_read(0.05)) {
+            my $n = $receiver->sysread(my $chunk, 65536);
+            last unless $n;
+            $buf .= $chunk;
+            $got = 1;
+        }
+        last if $done && !$got;
+    }
+    return $buf;
+}
+
+# the message numbers of all whole lines received, or undef if any was torn
+sub line_numbers {
+    my @nums;
+    for (split /\n/, shift) {
+        return undef unless /: n (\d+) $filler$/;
+        push @nums, $1;
+    }
+    return \@nums;
+}
+
+sub fill {
+    my ($logger, $start) = @_;
+    my $i = $start;
+    while ($i < $start + 100_000) {
+        last unless $logger->send("n $i $filler");
+        $i++;
+    }
+    return $i;
+}
+
+for my $p (qw( tcp unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        $logger->set_framing(LOG_FRAMING_LF);
+
+        eval { $logger->set_nonblock(65536) };
+        ok(!$@, "$p: ->set_nonblock doesn't throw");
+        is($logger->get_nonblock, 65536, "$p: ->get_nonblock returns the buffer size");
+
+        eval { $logger->set_nonblock(65536, 42) };
+        like($@, qr/invalid overflow policy/, "$p: bad policy throws");
+
+        SKIP: {
+            skip "$p: pure perl sockets stay blocking", 8 if $CLASS =~ /PP/;
+
+            # drop-newest: once socket and buffer are full, sends return 0
+            my $started = Time::HiRes::time;
+            my $accepted = fill($logger, 0);
+            ok(Time::HiRes::time - $started < 5, "$p: sends to a stalled reader don't block");
+            ok($accepted < 100_000, "$p: overflowing line is dropped");
+            my $nums = line_numbers(drain($logger, $receiver));
+            is_deeply($nums, [0 .. $accepted - 1], "$p: accepted lines arrive whole and in order");
+
+            # drop-oldest: the newest lines survive
+            $logger->set_nonblock(65536, LOG_OVERFLOW_DROP_OLDEST);
+            my $end = fill($logger, 0) + 50;
+            $logger->send("n $_ $filler") for $end - 50 .. $end - 1;
+            $nums = line_numbers(drain($logger, $receiver));
+            ok($nums && $nums->[-1] == $end - 1, "$p: newest line is kept under drop-oldest");
+            ok($nums && @$nums < $end && !grep({ $nums->[$_] <= $nums->[$_ - 1] } 1 .. $#$nums),
+                "$p: older lines were dropped whole");
+
+            # block: waits up to the deadline, then drops
+            $logger->set_nonblock(65536, LOG_OVERFLOW_BLOCK, 0.2);
+            $started = Time::HiRes::time;
+            fill($logger, 0);
+            my $waited = Time::HiRes::time - $started;
+            ok($waited >= 0.15, "$p: block policy waits for the deadline");
+            drain($logger, $receiver);
+
+            # error: the overflowing send throws
+            $logger->set_nonblock(65536, LOG_OVERFLOW_ERROR);
+            eval { fill($logger, 0) };
+            like($@, qr/write buffer full/, "$p: error policy throws");
+            drain($logger, $receiver);
+
+            $logger->set_nonblock(0);
+            is($logger->get_nonblock, 0, "$p: non-blocking mode turned off");
+        }
+    };
+    diag($@) if $@;
+}
+
+1;
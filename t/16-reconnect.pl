@@ -0,0 +1,69 @@
+use Test::More tests => 12;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use IO::Select ();
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+sub read_lines {
+    my ($receiver, $want) = @_;
+    my $buf = '';
+    while (length $buf < $want && wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 4096);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+for my $p (qw( tcp unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        my $time = time;
+
+        eval { $logger->set_reconnect(0.05, 0.2) };
+        ok(!$@, "$p: ->set_reconnect doesn't throw");
+        is($logger->get_reconnect, 0.05, "$p: ->get_reconnect returns the initial delay");
+
+        SKIP: {
+            skip "$p: pure perl doesn't reconnect", 4 if $CLASS =~ /PP/;
+
+            # the receiver hangs up; sends are dropped instead of throwing
+            undef $receiver;
+            my ($dropped, $error);
+            for (1 .. 100) {
+                my $ret = eval { $logger->send('into the void', $time) };
+                $error = $@, last if $@;
+                $dropped = 1, last if defined $ret && $ret == 0;
+                Time::HiRes::sleep(0.01);
+            }
+            ok(!$error, "$p: lost connection doesn't throw");
+            ok($dropped, "$p: lines are dropped while disconnected");
+
+            # the logger comes back on its own once the backoff has passed
+            my $listener = IO::Select->new($server->{listener});
+            for (1 .. 300) {
+                $logger->send('hello again', $time);
+                if ($listener->can_read(0.01)) {
+                    $receiver = $server->accept;
+                    last;
+                }
+            }
+            ok($receiver, "$p: logger reconnected");
+
+            my $expected = expected_payload(@params, $$, 'after', $time);
+            Time::HiRes::sleep(0.05);
+            $logger->send('after', $time) for 1 .. 2;
+            like(read_lines($receiver, 2 * length $expected), qr/\Q$expected\E/,
+                "$p: lines arrive over the new connection");
+        }
+    };
+    diag($@) if $@;
+}
+
+1;
@@ -0,0 +1,133 @@
+use Test::More tests => 20;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use IO::Select ();
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+sub read_all {
+    my $receiver = shift;
+    my $buf = '';
+    while (IO::Select->new($receiver)->can_read(0.2)) {
+        $receiver->recv(my $chunk, 65536);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+# send numbered lines until the logger notices the receiver is gone
+sub send_until_down {
+    my ($logger, $tag, $count) = @_;
+    for my $i (1 .. $count) {
+        $logger->send("$tag $i");
+        Time::HiRes::sleep(0.01) if $i < 5;
+    }
+}
+
+sub numbers {
+    my ($tag, $buf) = @_;
+    return [ $buf =~ /: $tag (\d+)\n/g ];
+}
+
+for my $p (qw( tcp unix_stream )) {
+    eval {
+        my $spill = test_dir() . "/spill-$p";
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        $logger->set_framing(LOG_FRAMING_LF);
+
+        eval { $logger->set_spill($spill, 65536) };
+        ok(!$@, "$p: ->set_spill doesn't throw");
+        is($logger->get_spill, 65536, "$p: ->get_spill returns the spill size");
+
+        SKIP: {
+            skip "$p: pure perl has nothing to spill", 7 if $CLASS =~ /PP/;
+
+            is(-s $spill, 4096 + 65536, "$p: spill file is header plus data area");
+
+            # lines sent while the receiver is away come back, in order
+            $logger->set_reconnect(0.05, 0.1);
+            undef $receiver;
+            send_until_down($logger, 'a', 30);
+
+            my $listener = IO::Select->new($server->{listener});
+            for (1 .. 300) {
+                $logger->flush(0);
+                if ($listener->can_read(0.01)) {
+                    $receiver = $server->accept;
+                    last;
+                }
+            }
+            ok($receiver, "$p: logger reconnected");
+            ok($logger->flush(5), "$p: spill replayed");
+            my $nums = numbers('a', read_all($receiver));
+            ok(@$nums && $nums->[-1] == 30 && !grep({ $nums->[$_] != $nums->[$_ - 1] + 1 } 1 .. $#$nums),
+                "$p: spilled lines arrive in order");
+
+            # a new process picks up a spill file left behind
+            undef $listener;
+            undef $server;
+            undef $receiver;
+            send_until_down($logger, 'b', 10);
+            undef $logger;
+
+            my $server2 = make_server($p);
+            my $logger2 = $server2->connect($CLASS => @params);
+            my $receiver2 = $server2->accept;
+            $logger2->set_framing(LOG_FRAMING_LF);
+            $logger2->set_spill($spill, 65536);
+            $logger2->send('b 11');
+            $nums = numbers('b', read_all($receiver2));
+            ok(@$nums > 1 && $nums->[-1] == 11, "$p: spill from an earlier logger is replayed first");
+
+            # a rate limit spreads the replay out; the long reconnect delay
+            # makes sure all the lines land in the spill first
+            $logger2->set_reconnect(0.5, 1);
+            $logger2->set_spill($spill, 65536, 20);
+            undef $receiver2;
+            send_until_down($logger2, 'c', 20);
+            my $listener2 = IO::Select->new($server2->{listener});
+            for (1 .. 300) {
+                $logger2->flush(0);
+                if ($listener2->can_read(0.01)) {
+                    $receiver2 = $server2->accept;
+                    last;
+                }
+            }
+            my $started = Time::HiRes::time;
+            $logger2->flush(5);
+            ok(Time::HiRes::time - $started > 0.3, "$p: replay is paced by the rate");
+            read_all($receiver2);
+
+            # below 10 lines a second the burst is one line, not a tenth
+            # of a second's worth rounded up each time
+            $logger2->set_spill($spill, 65536, 5);
+            undef $receiver2;
+            send_until_down($logger2, 'd', 10);
+            for (1 .. 300) {
+                $logger2->flush(0);
+                if ($listener2->can_read(0.01)) {
+                    $receiver2 = $server2->accept;
+                    last;
+                }
+            }
+            $started = Time::HiRes::time;
+            $logger2->flush(5);
+            my $elapsed = Time::HiRes::time - $started;
+            $nums = numbers('d', read_all($receiver2));
+            ok(@$nums > 2 && $elapsed > (@$nums - 1) * 0.16, "$p: a slow replay rate isn't exceeded")
+                or diag(scalar(@$nums) . " lines in ${elapsed}s");
+        }
+
+        $logger->set_spill(undef) if $logger;
+        is($logger ? $logger->get_spill : 0, 0, "$p: spill turned off");
+    };
+    diag($@) if $@;
+}
+
+1;
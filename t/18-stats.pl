@@ -0,0 +1,85 @@
+use Test::More tests => 39;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+my @keys = qw(
+    sent bytes dropped failed truncated eagain enobufs econnrefused
+    reconnects spilled replayed spill_lost prefix_rebuilds buffer_reallocs
+    filtered suppressed deduplicated
+);
+
+for my $p (qw( tcp udp unix_dgram unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+
+        my $stats = $logger->get_stats;
+        is_deeply([sort keys %$stats], [sort @keys], "$p: ->get_stats has every counter");
+        is($stats->{sent}, 0, "$p: nothing sent yet");
+
+        my $time = time;
+        my @msgs = map { "counted $_" } 1 .. 5;
+        my $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+        $logger->send($_, $time) for @msgs[0 .. 2];
+        $logger->send_many([ @msgs[3, 4] ], $time);
+
+        $stats = $logger->get_stats;
+        is($stats->{sent}, 5, "$p: sends and send_many are counted");
+        is($stats->{bytes}, length $expected, "$p: bytes match what was written");
+        is($stats->{failed}, 0, "$p: no failures");
+
+        $stats->{sent} = 42;
+        is($logger->get_stats->{sent}, 5, "$p: ->get_stats returns a snapshot");
+
+        # a day later, the prefix can't be patched in place
+        $logger->reset_stats;
+        $logger->send('later', $time + 2 * 86400);
+        ok($logger->get_stats->{prefix_rebuilds} >= 1, "$p: prefix rebuild counted");
+
+        SKIP: {
+            skip "$p: pure perl has no line buffer to grow", 1 if $CLASS =~ /PP/;
+            skip "$p: datagram too large", 1 if $p =~ /dgram|udp/;
+            $logger->send('x' x 100_000, $time);
+            ok($logger->get_stats->{buffer_reallocs} >= 1, "$p: buffer growth counted");
+        }
+
+        $logger->reset_stats;
+        is_deeply($logger->get_stats, { map { $_ => 0 } @keys }, "$p: ->reset_stats zeroes every counter");
+
+        if ($p eq 'unix_dgram') {
+            # once the receiver is gone, every send fails
+            undef $receiver;
+            $server->close;
+            my $thrown = 0;
+            for (1 .. 3) {
+                eval { $logger->send('into the void', $time) };
+                $thrown++ if $@;
+            }
+            $stats = $logger->get_stats;
+            is($stats->{failed}, $thrown, "$p: each failed send counted");
+            # the first send sees ECONNREFUSED, later ones ENOTCONN
+            ok($stats->{econnrefused} >= 1, "$p: failures classified by errno");
+        }
+    };
+    diag($@) if $@;
+}
+
+# lines dropped because the connection is down are counted
+SKIP: {
+    skip 'pure perl sends fail loudly instead of dropping', 1 if $CLASS =~ /PP/;
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    $logger->set_reconnect(60);
+    my $receiver = $server->accept;
+    undef $receiver;
+    $server->close;
+    $logger->send("gone $_") for 1 .. 20;
+    ok($logger->get_stats->{dropped} >= 1, 'tcp: lines dropped while down are counted');
+}
+
+1;
@@ -0,0 +1,72 @@
+use Test::More tests => 12;
+
+use lib 't/lib';
+use LSF;
+use Log::Syslog::Fast::SharedStats;
+use POSIX ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+my $path = test_dir() . '/shared.stats';
+unlink $path;
+
+my $server = make_server('udp');
+my $logger = $server->connect($CLASS => @params);
+
+eval { $logger->set_shared_stats($path, 4) };
+ok(!$@, '->set_shared_stats does not throw');
+is($logger->get_shared_stats, 4, '->get_shared_stats returns the slot count');
+
+eval { $logger->set_shared_stats($path, 0) };
+like($@, qr/at least one slot/, 'zero slots throws');
+
+SKIP: {
+    skip 'pure perl keeps no shared counters', 9 if $CLASS =~ /PP/;
+
+    $logger->set_shared_stats($path, 4);
+    $logger->send("parent $_") for 1 .. 3;
+
+    my $stats = Log::Syslog::Fast::SharedStats->read($path);
+    is($stats->{slots}, 4, 'reader sees the slot count');
+    is($stats->{total}{sent}, 3, 'totals count sends');
+    is_deeply([ map { $_->{pid} } @{ $stats->{workers} } ], [$$], 'one row for this process');
+
+    # preforked workers inherit the mapping and each get a row
+    my @kids;
+    for my $k (1 .. 2) {
+        my $pid = fork;
+        die "fork: $!" unless defined $pid;
+        unless ($pid) {
+            $logger->send("child $k $_") for 1 .. 5;
+            POSIX::_exit(0);
+        }
+        push @kids, $pid;
+    }
+    waitpid $_, 0 for @kids;
+
+    $stats = Log::Syslog::Fast::SharedStats->read($path);
+    is($stats->{total}{sent}, 13, 'totals include every worker');
+    my %rows = map { $_->{pid} => $_ } @{ $stats->{workers} };
+    is_deeply([ map { $rows{$_} ? $rows{$_}{sent} : undef } @kids ], [5, 5], 'each worker has its own row');
+    ok(!grep({ $rows{$_}{alive} } @kids), 'exited workers are reported as such');
+
+    my $latency = 0;
+    $latency += $_ for @{ $stats->{total}{latency} };
+    is($latency, 13, 'every send lands in a latency bucket');
+
+    # a file that exists keeps its slot count
+    my $other = $server->connect($CLASS => @params);
+    $other->set_shared_stats($path, 100);
+    is($other->get_shared_stats, 4, 'existing file keeps its slots');
+
+    open my $fh, '>', "$path.bogus" or die $!;
+    print $fh 'x' x 1000;
+    close $fh;
+    eval { $other->set_shared_stats("$path.bogus") };
+    like($@, qr/not a shared stats file/, 'foreign file is refused');
+    unlink "$path.bogus";
+}
+
+unlink $path;
+
+1;
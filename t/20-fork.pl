@@ -0,0 +1,112 @@
+use Test::More tests => 20;
+
+use lib 't/lib';
+use LSF;
+use IO::Select ();
+use POSIX ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+# read one datagram, or a stream up to the end of its first line
+sub read_line {
+    my $receiver = shift;
+    my $buf = '';
+    while (wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 4096);
+        last unless length $chunk;
+        $buf .= $chunk;
+        last if $buf =~ /\n/ || $receiver->socktype != SOCK_STREAM;
+    }
+    return $buf;
+}
+
+sub in_child (&) {
+    my $code = shift;
+    my $pid = fork;
+    die "fork: $!" unless defined $pid;
+    unless ($pid) {
+        $code->();
+        POSIX::_exit(0);
+    }
+    waitpid $pid, 0;
+    return $pid;
+}
+
+for my $p (qw( tcp unix_stream udp )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        my $stream = $p ne 'udp';
+        $logger->set_framing(LOG_FRAMING_LF);
+
+        $logger->send('parent before');
+        like(read_line($receiver), qr/test\[$$\]: parent before/, "$p: parent's line has its pid");
+
+        my $kid = in_child { $logger->send('child line') };
+
+        if ($stream) {
+            ok(IO::Select->new($server->{listener})->can_read(1), "$p: child opened its own connection");
+            my $private = $server->accept;
+            like(read_line($private), qr/test\[$kid\]: child line/, "$p: child's line has the child's pid");
+            ok(!IO::Select->new($receiver)->can_read(0.1), "$p: nothing from the child on the parent's connection");
+        }
+        else {
+            like(read_line($receiver), qr/test\[$kid\]: child line/, "$p: child's line has the child's pid");
+        }
+
+        $logger->send('parent after');
+        like(read_line($receiver), qr/test\[$$\]: parent after/, "$p: parent keeps its pid and connection");
+    };
+    diag($@) if $@;
+}
+
+# a pid set by hand is left alone
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_pid(4242);
+    in_child { $logger->send('fixed pid') };
+    like(read_line($receiver), qr/test\[4242\]: fixed pid/, "pid set with ->set_pid survives fork");
+}
+
+# an async logger gets a worker of its own in the child
+{
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_framing(LOG_FRAMING_LF);
+    $logger->set_async(65536);
+
+    my $kid = in_child { $logger->send('async child'); $logger->flush(1) };
+    ok(IO::Select->new($server->{listener})->can_read(1), 'async: child opened its own connection');
+    my $private = $server->accept;
+    like(read_line($private), qr/test\[$kid\]: async child/, "async: child's line is sent");
+
+    $logger->send('async parent');
+    like(read_line($receiver), qr/test\[$$\]: async parent/, 'async: parent still sends');
+}
+
+# a coalescing logger's timer is restarted in the child, whatever state the
+# parent's timer left the lock in
+{
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_framing(LOG_FRAMING_LF);
+    $logger->set_coalesce(4096, 0.01, 1);
+    $logger->send("coalesced parent $_") for 1 .. 50;
+
+    my $kid = in_child {
+        alarm 5;
+        $logger->send('coalesced child');
+        select undef, undef, undef, 0.2;
+    };
+    is($?, 0, "coalesce: child sends without hanging");
+    ok(IO::Select->new($server->{listener})->can_read(1), 'coalesce: child opened its own connection');
+    my $private = $server->accept;
+    like(read_line($private), qr/test\[$kid\]: coalesced child/, "coalesce: child's timer writes its line");
+}
+
+1;
@@ -0,0 +1,87 @@
+use Test::More tests => 16;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use IO::Select ();
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+# collect whatever arrives within a moment
+sub slurp {
+    my ($receiver, $dgram) = @_;
+    my $buf = '';
+    while (IO::Select->new($receiver)->can_read(0.3)) {
+        $receiver->recv(my $chunk, 65536);
+        last unless length $chunk;
+        $buf .= $dgram ? "$chunk\n" : $chunk;
+    }
+    return $buf;
+}
+
+my $main = make_server('udp');
+my $tcp = make_server('tcp');
+my $unix = make_server('unix_dgram');
+
+my $logger = $main->connect($CLASS => @params);
+my $main_rx = $main->accept;
+
+eval { $logger->add_receiver($tcp->proto, $tcp->address, LOG_FRAMING_LF) };
+ok(!$@, '->add_receiver with framing does not throw');
+my $tcp_rx = $tcp->accept;
+eval { $logger->add_receiver($unix->proto, $unix->address) };
+ok(!$@, '->add_receiver without framing does not throw');
+my $unix_rx = $unix->accept;
+
+eval { $logger->add_receiver($tcp->proto, $tcp->address, 42) };
+like($@, qr/invalid framing/, 'bad framing throws');
+$tcp->accept if IO::Select->new($tcp->{listener})->can_read(0.1);
+
+my $time = time;
+my @msgs = map { "fan $_" } 1 .. 5;
+my @expected = map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+$logger->send($_, $time) for @msgs[0 .. 2];
+$logger->send_many([ @msgs[3, 4] ], $time);
+
+is(slurp($main_rx, 1), join('', map { "$_\n" } @expected), 'main receiver gets every line');
+is(slurp($tcp_rx), join('', map { "$_\n" } @expected), 'stream receiver gets every line in its framing');
+is(slurp($unix_rx, 1), join('', map { "$_\n" } @expected), 'datagram receiver gets every line');
+
+my $receivers = $logger->get_receivers;
+is(scalar @$receivers, 2, '->get_receivers lists both');
+is_deeply([ map { $_->{sent} } @$receivers ], [5, 5], 'each receiver counts its lines');
+is($receivers->[0]{bytes}, length(join '', map { "$_\n" } @expected), 'bytes include framing');
+ok($receivers->[0]{up}, 'receiver is up');
+
+# a receiver that stops reading doesn't hold up the rest
+my $filler = 'x' x 4000;
+my $started = Time::HiRes::time;
+$logger->send("stall $_ $filler", $time) for 1 .. 2000;
+ok(Time::HiRes::time - $started < 5, 'a stalled receiver does not block sends');
+ok($logger->get_receivers->[0]{dropped} > 0, 'lines the stalled receiver could not take are dropped');
+slurp($tcp_rx);
+slurp($main_rx, 1);
+slurp($unix_rx, 1);
+
+# one that goes away doesn't stop the others
+undef $unix_rx;
+$unix->close;
+undef $unix;
+$logger->send("after $_", $time) for 1 .. 3;
+like(slurp($main_rx, 1), qr/after 3/, 'main receiver unaffected by a dead one');
+my $dead = $logger->get_receivers->[1];
+ok($dead->{failed} + $dead->{dropped} > 0, 'dead receiver counts its losses');
+
+# the async worker fans out too
+$logger->set_async(65536);
+$logger->send('queued', $time);
+$logger->flush(1);
+like(slurp($tcp_rx), qr/: queued\n/, 'async lines reach extra receivers');
+$logger->set_async(0);
+
+$logger->clear_receivers;
+is_deeply($logger->get_receivers, [], '->clear_receivers removes them');
+
+1;
@@ -0,0 +1,99 @@
+use Test::More tests => 20;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use IO::Select ();
+use IO::Socket::INET;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+# the datagrams that arrive within a moment
+sub slurp {
+    my $receiver = shift;
+    my @lines;
+    while (IO::Select->new($receiver)->can_read(0.2)) {
+        $receiver->recv(my $line, 65536);
+        push @lines, $line;
+    }
+    return @lines;
+}
+
+my $main = make_server('udp');
+my @servers = map { make_server('udp') } 1 .. 3;
+my @collectors = map { [ $_->address ] } @servers;
+
+my $logger = $main->connect($CLASS => @params);
+
+eval { $logger->set_pool(\@collectors) };
+ok(!$@, '->set_pool does not throw');
+
+my $time = time;
+$logger->send("rr $_", $time) for 1 .. 9;
+is_deeply([ map { scalar slurp($_->accept) } @servers ], [3, 3, 3], 'round robin spreads lines evenly');
+is(scalar slurp($main->accept), 0, 'the receiver gets nothing while a pool is set');
+
+my $pool = $logger->get_pool;
+is(scalar @$pool, 3, '->get_pool lists every collector');
+is_deeply([ map { $_->{sent} } @$pool ], [3, 3, 3], 'each collector counts its lines');
+is_deeply([ map { $_->{up} } @$pool ], [1, 1, 1], 'every collector is up');
+
+is($logger->send_many([ map { "many $_" } 1 .. 6 ], $time), 6, '->send_many sends the whole batch');
+is_deeply([ map { scalar slurp($_->accept) } @servers ], [2, 2, 2], 'a batch is shared out too');
+
+# lines with the same key stay together
+$logger->set_pool(\@collectors, LOG_POOL_HASH);
+my @keys = map { "user$_" } 1 .. 30;
+my %seen;
+for my $round (1 .. 2) {
+    $logger->send_key($_, "key $_", $time) for @keys;
+    for my $i (0 .. $#servers) {
+        for (slurp($servers[$i]->accept)) {
+            $seen{$1}{$i}++ if /key (\S+)$/;
+        }
+    }
+}
+is(scalar keys %seen, 30, 'every keyed line arrives');
+ok(!(grep { keys %{ $seen{$_} } != 1 } keys %seen), 'each key goes to a single collector');
+my %used = map { (keys %{ $seen{$_} })[0] => 1 } keys %seen;
+ok(keys %used > 1, 'keys are spread across collectors');
+
+$logger->send("unkeyed $_", $time) for 1 .. 3;
+is_deeply([ map { scalar slurp($_->accept) } @servers ], [1, 1, 1], 'lines without a key go round robin');
+
+# a collector that answers with ICMP port unreachable is ejected
+my $gone = IO::Socket::INET->new(Proto => 'udp', LocalHost => '127.0.0.1', LocalPort => 0)
+    or die $!;
+my $dead_port = $gone->sockport;
+undef $gone;
+
+$logger->set_pool([ $collectors[0], [ '127.0.0.1', $dead_port ] ], LOG_POOL_ROUND_ROBIN, 10);
+for (1 .. 10) {
+    $logger->send("eject $_", $time);
+    select undef, undef, undef, 0.02;
+}
+is(scalar slurp($servers[0]->accept), 9, 'lines for the dead collector go to the live one');
+$pool = $logger->get_pool;
+ok(!$pool->[1]{up} && $pool->[1]{ejections} >= 1, 'dead collector is ejected');
+ok($pool->[0]{up}, 'live collector stays up');
+ok($logger->get_stats->{econnrefused} >= 1, 'the refusal is counted');
+
+eval { $logger->set_reconnect(1) };
+like($@, qr/pool/, 'reconnects cannot be combined with a pool');
+
+# the async worker routes by key too
+$logger->set_pool(\@collectors, LOG_POOL_HASH);
+$logger->set_async(65536);
+$logger->send_key('user1', "async $_", $time) for 1 .. 3;
+$logger->flush(1);
+$logger->set_async(0);
+my ($home) = keys %{ $seen{user1} };
+is(scalar slurp($servers[$home]->accept), 3, 'queued keyed lines go to the key\'s collector');
+
+eval { $logger->set_pool(\@collectors, 42) };
+like($@, qr/invalid pool mode/, 'bad mode throws');
+
+$logger->set_pool([]);
+$logger->send('back home', $time);
+my @home = slurp($main->accept);
+ok(@home == 1 && $home[0] =~ /back home$/, 'an empty pool goes back to the receiver');
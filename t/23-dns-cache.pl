@@ -0,0 +1,48 @@
+use Test::More tests => 10;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+eval { $CLASS->set_dns_cache(60, 2) };
+ok(!$@, '->set_dns_cache as a class method does not throw');
+is($CLASS->get_dns_cache, 60, '->get_dns_cache returns the ttl');
+
+my $server = make_server('udp');
+my $logger = $server->connect($CLASS => @params);
+my $receiver = $server->accept;
+
+my $time = time;
+$logger->send('cached', $time);
+ok(wait_for_readable($receiver), 'a receiver resolved through the cache gets lines');
+$receiver->recv(my $buf, 256);
+is($buf, expected_payload(@params, $$, 'cached', $time), 'line is intact');
+
+# a second logger for the same receiver is answered from the cache
+my $started = Time::HiRes::time;
+my $again = $server->connect($CLASS => @params);
+ok(Time::HiRes::time - $started < 1, 'a cached receiver connects at once');
+
+# a child gets a helper of its own for names it hasn't seen
+my $other = make_server('udp');
+my $pid = fork;
+die "fork failed: $!" unless defined $pid;
+if (!$pid) {
+    my $child = eval { $other->connect($CLASS => @params) };
+    eval { $child->send('from child', $time) } if $child;
+    exit($child && !$@ ? 0 : 1);
+}
+waitpid($pid, 0);
+is($?, 0, 'a forked child resolves new receivers');
+ok(wait_for_readable($other->accept), 'and its lines arrive');
+
+$started = Time::HiRes::time;
+eval { $CLASS->new(LOG_UDP, 'nonexistent.invalid', 514, @params) };
+ok($@, 'an unresolvable receiver throws');
+ok(Time::HiRes::time - $started < 10, 'without waiting long on the resolver');
+
+$CLASS->set_dns_cache(0);
+is($CLASS->get_dns_cache, 0, 'a ttl of 0 turns the cache off');
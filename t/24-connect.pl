@@ -0,0 +1,39 @@
+use Test::More tests => 7;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use Time::HiRes ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+# the receiver's name, not its address, so every address it resolves to
+# is in the running
+my $server = make_server('tcp');
+my $port = ($server->address)[1];
+my $logger = eval { $CLASS->new(LOG_TCP, 'localhost', $port, @params) };
+ok($logger, 'a stream receiver connects by name') or diag($@);
+my $receiver = $server->accept;
+
+my $time = time;
+$logger->send('raced', $time);
+ok(wait_for_readable($receiver), 'the connected stream gets lines');
+$receiver->recv(my $buf, 256);
+is($buf, expected_payload(@params, $$, 'raced', $time), 'line is intact');
+
+# the winning connect is handed back blocking, like any other
+eval { $logger->send('x' x 1000, $time) for 1 .. 100 };
+ok(!$@, 'the stream takes a run of lines without EAGAIN');
+
+$server->close;
+my $started = Time::HiRes::time;
+eval { $CLASS->new(LOG_TCP, 'localhost', $port, @params) };
+ok($@, 'a refused connect throws');
+ok(Time::HiRes::time - $started < 2, 'without waiting out the stagger on every address');
+
+$CLASS->set_dns_cache(60, 2);
+$server = make_server('tcp');
+$logger = eval { $server->connect($CLASS => @params) };
+my $err = $@;
+$CLASS->set_dns_cache(0);
+ok($logger, 'a stream receiver connects through the dns cache') or diag($err);
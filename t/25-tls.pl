@@ -0,0 +1,91 @@
+use Test::More;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use IO::Socket::INET;
+use Time::HiRes ();
+
+# openssl s_server stands in for a TLS syslog receiver, writing what it
+# gets to a file; it serves one connection at a time
+my $dir = test_dir;
+system("openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj /CN=localhost "
+     . "-addext subjectAltName=DNS:localhost,IP:127.0.0.1 "
+     . "-keyout $dir/key.pem -out $dir/cert.pem >/dev/null 2>&1") == 0
+    or plan skip_all => 'no openssl command to make a certificate with';
+eval { $CLASS->set_tls("$dir/cert.pem"); 1 }
+    or plan skip_all => "no TLS support: $@";
+
+my $probe = IO::Socket::INET->new(LocalHost => '127.0.0.1', LocalPort => 0, Listen => 1)
+    or die $!;
+my $port = $probe->sockport;
+close $probe;
+
+my $server_pid = open(my $server_in, '|-', "exec openssl s_server -quiet -accept 127.0.0.1:$port "
+    . "-cert $dir/cert.pem -key $dir/key.pem > $dir/received 2>&1")
+    or plan skip_all => "can't run openssl s_server: $!";
+for (1 .. 50) {
+    last if IO::Socket::INET->new(PeerHost => '127.0.0.1', PeerPort => $port);
+    Time::HiRes::sleep(0.1);
+}
+
+plan tests => 13;
+
+sub received_ok {
+    my ($expected, $name) = @_;
+    my $got = '';
+    for (1 .. 50) {
+        open my $fh, '<', "$dir/received" or die $!;
+        $got = do { local $/; <$fh> };
+        last if index($got, $expected) >= 0;
+        Time::HiRes::sleep(0.1);
+    }
+    ok(index($got, $expected) >= 0, $name) or diag("got: $got");
+}
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+my $time = time;
+
+my $logger = eval { $CLASS->new(LOG_TLS, 'localhost', $port, @params) };
+ok($logger, 'a TLS receiver connects') or diag($@);
+is($logger->get_framing, LOG_FRAMING_OCTET, 'TLS lines are octet-counted');
+
+my $tls = $logger->get_tls;
+like($tls->{version}, qr/^TLS/, '->get_tls has the protocol version');
+is($tls->{handshakes}, 1, 'one handshake so far');
+ok(!$tls->{resumed}, 'the first connection is a full handshake');
+
+my $line = expected_payload(@params, $$, 'over tls', $time);
+$logger->send('over tls', $time);
+received_ok(length($line) . " $line", 'the line arrives framed');
+
+# TLS 1.3 hands out its ticket after the handshake; give it time to come
+Time::HiRes::sleep(0.2);
+$logger->send('picks up the ticket', $time);
+
+$logger->set_receiver(LOG_TLS, 'localhost', $port);
+$tls = $logger->get_tls;
+ok($tls->{resumed}, 'connecting to the same receiver again resumes the session');
+is($tls->{resumptions}, 1, 'the resumption is counted');
+
+$line = expected_payload(@params, $$, 'resumed', $time);
+$logger->send('resumed', $time);
+received_ok(length($line) . " $line", 'lines arrive over the resumed session');
+
+eval { $logger->set_framing(LOG_FRAMING_LF) };
+ok($@, 'TLS framing stays octet-counted');
+eval { $logger->set_nonblock(4096) };
+ok($@, 'TLS rules out non-blocking mode');
+eval { $logger->add_receiver(LOG_TLS, 'localhost', $port) };
+ok($@, 'extra receivers can\'t use TLS');
+
+# the server takes the next connection once this one is gone
+undef $logger;
+$CLASS->set_tls(undef);
+eval { $CLASS->new(LOG_TLS, 'localhost', $port, @params) };
+my $err = $@;
+
+kill 'TERM', $server_pid;
+close $server_in;
+
+ok($err, 'a certificate that doesn\'t verify is refused');
@@ -0,0 +1,111 @@
+use Test::More;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use POSIX ();
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    eval { $logger->set_uring(16); 1 }
+        or plan skip_all => "no io_uring here: $@";
+}
+
+plan tests => 36;
+
+sub read_lines {
+    my ($receiver, $want) = @_;
+    my $buf = '';
+    while (length $buf < $want && wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 65536);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+for my $p (qw( tcp udp unix_dgram unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+
+        eval { $logger->set_uring(16) };
+        ok(!$@, "$p: ->set_uring doesn't throw");
+        ok($logger->get_uring->{entries} >= 16, "$p: ring is at least as large as requested");
+
+        my $time = time;
+        my @msgs = map { "uring $_" } 1 .. 5;
+        my $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+        my $queued = 0;
+        $queued += $logger->send($_, $time) for @msgs;
+        is($queued, length $expected, "$p: ->send reports bytes queued");
+        ok($logger->flush(5), "$p: ->flush waits for every send to complete");
+        is($logger->get_stats->{sent}, 5, "$p: completed sends are counted");
+        is(read_lines($receiver, length $expected), $expected, "$p: queued messages arrive in order");
+
+        # more lines than the ring has entries, each wider than its share of
+        # the buffer, then one for a stream that doesn't fit in it at all
+        @msgs = map { "wide $_ " . ('x' x 3000) } 1 .. 20;
+        $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+        if ($server->isa('StreamServer')) {
+            push @msgs, 'y' x 35000, 'after';
+            $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+            $logger->send($_, $time) for @msgs;
+            ok($logger->flush(5), "$p: ->flush after a wrap around the buffer");
+            is(read_lines($receiver, length $expected), $expected,
+               "$p: lines stay whole and in order across the wrap");
+        }
+        else {
+            # one at a time, so the receiver's queue can't overflow
+            my ($ok, $got) = (1, '');
+            for my $msg (@msgs) {
+                $logger->send($msg, $time);
+                $ok &&= $logger->flush(5);
+                $got .= read_lines($receiver, 1);
+            }
+            ok($ok, "$p: ->flush after a wrap around the buffer");
+            is($got, $expected, "$p: lines stay whole and in order across the wrap");
+        }
+    };
+    diag($@) if $@;
+}
+
+# a child sets up a ring of its own
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_uring(16);
+
+    my $pid = fork;
+    die "fork: $!" unless defined $pid;
+    unless ($pid) {
+        $logger->send('from the child');
+        $logger->flush(1);
+        POSIX::_exit(0);
+    }
+    waitpid $pid, 0;
+    like(read_lines($receiver, 1), qr/test\[$pid\]: from the child/, "a child's line is sent");
+}
+
+# modes that do their own sending can't be stacked on top
+{
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    $logger->set_uring(16);
+
+    eval { $logger->set_nonblock(65536) };
+    like($@, qr/io_uring/, "non-blocking mode is refused");
+    eval { $logger->set_reconnect(1) };
+    like($@, qr/io_uring/, "reconnects are refused");
+
+    $logger->set_uring(0);
+    ok(!defined $logger->get_uring, "->set_uring(0) turns it off");
+}
+
+1;
@@ -0,0 +1,157 @@
+use Test::More tests => 43;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+# the pure perl implementation writes every line as it's sent
+my $pp = $CLASS =~ /PP/;
+
+sub read_lines {
+    my ($receiver, $want) = @_;
+    my $buf = '';
+    while (length $buf < $want && wait_for_readable($receiver)) {
+        $receiver->recv(my $chunk, 65536);
+        last unless length $chunk;
+        $buf .= $chunk;
+    }
+    return $buf;
+}
+
+for my $p (qw( tcp unix_stream )) {
+    eval {
+        my $server = make_server($p);
+        my $logger = $server->connect($CLASS => @params);
+        my $receiver = $server->accept;
+        my $time = time;
+
+        eval { $logger->set_coalesce(4096, 10) };
+        ok(!$@, "$p: ->set_coalesce doesn't throw");
+        is($logger->get_coalesce->{size}, 4096, "$p: ->get_coalesce reports the size");
+
+        my @msgs = map { "coalesced $_" } 1 .. 5;
+        my $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+        my $queued = 0;
+        $queued += $logger->send($_, $time) for @msgs;
+        is($queued, length $expected, "$p: ->send reports bytes buffered");
+
+        SKIP: {
+            skip 'pure perl writes each line', 3 if $pp;
+            is($logger->get_coalesce->{lines}, 5, "$p: lines wait in the buffer");
+            is($logger->get_stats->{sent}, 0, "$p: buffered lines aren't counted yet");
+            ok(!wait_for_readable($receiver, 0.2), "$p: nothing is written before ->flush");
+        }
+        ok($logger->flush, "$p: ->flush succeeds");
+        is(read_lines($receiver, length $expected), $expected, "$p: buffered lines arrive in order");
+        is($logger->get_stats->{sent}, 5, "$p: written lines are counted");
+
+        # a full buffer is written out without a flush
+        @msgs = map { "full $_ " . ('x' x 600) } 1 .. 10;
+        my @payloads = map { expected_payload(@params, $$, $_, $time) } @msgs;
+        $logger->send($_, $time) for @msgs;
+        my $first = join '', @payloads[0 .. 5];
+        my $got = read_lines($receiver, length $first);
+        ok(substr($got, 0, length $first) eq $first, "$p: a full buffer is written by ->send");
+        $logger->flush;
+        $expected = join '', @payloads;
+        $got .= read_lines($receiver, length($expected) - length $got);
+        ok($got eq $expected, "$p: the rest follows on ->flush");
+
+        # a line bigger than the buffer goes straight out behind it
+        $logger->set_coalesce(1024, 10);
+        @msgs = ('small', 'z' x 5000);
+        $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+        $logger->send($_, $time) for @msgs;
+        is(read_lines($receiver, length $expected), $expected, "$p: an oversized line is sent directly");
+
+        # an overdue line is written by the next send
+        $logger->set_coalesce(65536, 0.05);
+        @msgs = ('early', 'late');
+        $expected = join '', map { expected_payload(@params, $$, $_, $time) } @msgs;
+        $logger->send($msgs[0], $time);
+        select undef, undef, undef, 0.2;
+        $logger->send($msgs[1], $time);
+        is(read_lines($receiver, length $expected), $expected, "$p: ->send writes out lines that are due");
+
+        # or by the timer, without any send
+        $logger->set_coalesce(65536, 0.05, 1);
+        SKIP: {
+            skip 'pure perl has no timer', 1 if $pp;
+            ok($logger->get_coalesce->{timer}, "$p: the timer thread is running");
+        }
+        $expected = expected_payload(@params, $$, 'timed', $time);
+        $logger->send('timed', $time);
+        is(read_lines($receiver, length $expected), $expected, "$p: the timer writes out lines that are due");
+
+        # a new receiver gets nothing meant for the old one
+        my $server2 = make_server('tcp');
+        $logger->send('before', $time);
+        $logger->set_receiver($server2->proto, $server2->address);
+        my $receiver2 = $server2->accept;
+        $logger->send('after', $time);
+        $logger->flush;
+        $expected = expected_payload(@params, $$, 'before', $time);
+        is(read_lines($receiver, length $expected), $expected, "$p: buffered lines go to the old receiver");
+        $expected = expected_payload(@params, $$, 'after', $time);
+        is(read_lines($receiver2, length $expected), $expected, "$p: later lines go to the new one");
+
+        # the buffer is written out on destruction
+        $logger->set_coalesce(65536, 10);
+        $logger->send('last words', $time);
+        undef $logger;
+        $expected = expected_payload(@params, $$, 'last words', $time);
+        is(read_lines($receiver2, length $expected), $expected, "$p: destruction writes out the buffer");
+    };
+    diag($@) if $@;
+}
+
+# a failed write counts the buffered lines as failed and the new one as dropped
+SKIP: {
+    skip 'pure perl writes each line', 2 if $pp;
+    my $server = make_server('unix_stream');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    local $SIG{PIPE} = 'IGNORE';
+
+    $logger->set_coalesce(1024, 10);
+    $logger->send("buffered $_") for 1 .. 3;
+    undef $receiver;
+    $server->close;
+    eval { $logger->send('x' x 900) };
+    my $stats = $logger->get_stats;
+    is($stats->{failed}, 3, "a failed write counts the buffered lines as failed");
+    is($stats->{dropped}, 1, "and the line that didn't fit as dropped");
+}
+
+# datagrams are sent whole as before
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    my $time = time;
+
+    $logger->set_coalesce(65536, 10);
+    $logger->send('datagram', $time);
+    my $expected = expected_payload(@params, $$, 'datagram', $time);
+    is(read_lines($receiver, 1), $expected, "udp: lines aren't buffered");
+}
+
+# modes that gather lines themselves can't be stacked on top
+{
+    my $server = make_server('tcp');
+    my $logger = $server->connect($CLASS => @params);
+    $logger->set_coalesce(4096);
+
+    is($logger->get_coalesce->{max_delay}, 0.05, "max_delay defaults to 50ms");
+    eval { $logger->set_nonblock(65536) };
+    like($@, qr/coalescing/, "non-blocking mode is refused");
+    eval { $logger->set_async(65536) };
+    like($@, qr/coalescing/, "async mode is refused");
+
+    $logger->set_coalesce(0);
+    ok(!defined $logger->get_coalesce, "->set_coalesce(0) turns it off");
+}
+
+1;
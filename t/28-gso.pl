@@ -0,0 +1,82 @@
+use Test::More tests => 13;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+
+sub read_datagrams {
+    my ($receiver, $count) = @_;
+    my @got;
+    while (@got < $count && wait_for_readable($receiver)) {
+        $receiver->recv(my $buf, 65536);
+        push @got, $buf;
+    }
+    return \@got;
+}
+
+my $time = time;
+
+# runs of equal length, ended by shorter lines, and a longer one between
+my @msgs = ((map { "burst $_" } 1 .. 9), 'x', 'a longer line', (map { "run $_" } 1 .. 40));
+my @expected = map { expected_payload(@params, $$, $_, $time) } @msgs;
+
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    is($logger->get_gso, 0, "off by default");
+    $logger->set_gso(1);
+    my $seg = $logger->get_gso;
+    ok($seg == 0 || $seg >= length $expected[0], "->get_gso reports a usable segment size or 0");
+    diag('no UDP segmentation offload here; datagrams go one at a time')
+        unless $seg || $CLASS =~ /PP/;
+
+    is($logger->send_many(\@msgs, $time), scalar @msgs, "->send_many reports every line sent");
+    is_deeply(read_datagrams($receiver, scalar @msgs), \@expected,
+              "each line arrives as a datagram of its own, in order");
+    is($logger->get_stats->{sent}, scalar @msgs, "every line is counted");
+
+    $logger->send('single', $time);
+    is_deeply(read_datagrams($receiver, 1), [expected_payload(@params, $$, 'single', $time)],
+              "->send is unaffected");
+
+    $logger->set_gso(0);
+    is($logger->get_gso, 0, "->set_gso(0) turns it off");
+}
+
+# the background sender batches the same way
+SKIP: {
+    skip 'pure perl has no async mode', 4 if $CLASS =~ /PP/;
+
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+    $logger->set_gso(1);
+    $logger->set_async(65536);
+
+    $logger->send_many(\@msgs, $time);
+    ok($logger->flush(5), "async: ->flush succeeds");
+    is_deeply(read_datagrams($receiver, scalar @msgs), \@expected, "async: lines arrive whole and in order");
+
+    # the worker is parked while the setting changes
+    my $seg = $logger->get_gso;
+    $logger->set_gso(0);
+    $logger->set_gso(1);
+    is($logger->get_gso, $seg, "async: the receiver is probed again by ->set_gso");
+    $logger->send_many(\@msgs, $time);
+    $logger->flush(5);
+    is(scalar @{ read_datagrams($receiver, scalar @msgs) }, scalar @msgs, "async: and the worker carries on");
+}
+
+# streams have no datagrams to segment
+for my $p (qw( tcp unix_dgram )) {
+    my $server = make_server($p);
+    my $logger = $server->connect($CLASS => @params);
+    $logger->set_gso(1);
+    is($logger->get_gso, 0, "$p: nothing to segment");
+}
+
+1;
@@ -0,0 +1,79 @@
+use Test::More tests => 20;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+use File::Temp 'tempdir';
+
+my @params = (LOG_AUTH, LOG_DEBUG, 'localhost', 'test');
+
+# counts its stringifications
+package Counted;
+use overload '""' => sub { $Counted::strings++; 'counted' }, fallback => 1;
+package main;
+
+my $dir = tempdir(CLEANUP => 1);
+my $time = time;
+
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    is($logger->get_min_severity, LOG_DEBUG, "everything goes through by default");
+
+    $logger->set_min_severity(LOG_INFO);
+    is($logger->get_min_severity, LOG_INFO, "->get_min_severity reports the threshold");
+
+    $Counted::strings = 0;
+    my $msg = bless {}, 'Counted';
+    is($logger->send($msg, $time), 0, "->send of a filtered line returns 0");
+    is($Counted::strings, 0, "a filtered line isn't stringified");
+    is($logger->send_many([$msg, $msg], $time), 0, "->send_many of filtered lines returns 0");
+    is($logger->send_key('k', $msg, $time), 0, "->send_key of a filtered line returns 0");
+    is($logger->send_prio($msg, LOG_DEBUG, undef, $time), 0, "->send_prio at a filtered severity returns 0");
+    is($Counted::strings, 0, "nor are any of those");
+
+    ok($logger->send_prio('important', LOG_ERR, undef, $time), "->send_prio above the threshold sends");
+    is(scalar(wait_for_readable($receiver) && do { $receiver->recv(my $buf, 4096); $buf }),
+       expected_payload(LOG_AUTH, LOG_ERR, 'localhost', 'test', $$, 'important', $time),
+       "and the line arrives");
+
+    my $stats = $logger->get_stats;
+    is($stats->{filtered}, 5, "filtered lines are counted");
+    is($stats->{sent}, 1, "but not as sent");
+
+    $logger->set_min_severity(LOG_DEBUG);
+    ok($logger->send('debug', $time), "lowering the threshold lets lines through again");
+    ok(wait_for_readable($receiver), "and they arrive");
+}
+
+# a control file shared by loggers and changed from outside
+{
+    my $path = "$dir/severity";
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $other = $server->connect($CLASS => @params);
+
+    $logger->set_min_severity(LOG_WARNING);
+    $logger->set_min_severity_file($path);
+    is(-s $path, 4, "a new control file holds one word");
+    $other->set_min_severity_file($path);
+    is($other->get_min_severity, LOG_WARNING, "it starts at the first logger's threshold");
+
+    $other->set_min_severity(LOG_NOTICE);
+    is($logger->get_min_severity, LOG_NOTICE, "->set_min_severity changes it for every logger");
+
+    open my $fh, '+<', $path or die $!;
+    binmode $fh;
+    print $fh pack('i', LOG_DEBUG);
+    close $fh;
+    is($logger->get_min_severity, LOG_DEBUG, "another process can change it");
+    ok($logger->send('debug', $time), "and lines go through at once");
+
+    $logger->set_min_severity_file(undef);
+    $other->set_min_severity(LOG_ERR);
+    is($logger->get_min_severity, LOG_DEBUG, "after detaching the logger keeps the last value");
+}
+
+1;
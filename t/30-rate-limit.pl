@@ -0,0 +1,129 @@
+use Test::More tests => 26;
+use Time::HiRes qw(sleep);
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+my $time = time;
+
+sub recv_line {
+    my $receiver = shift;
+    return undef unless wait_for_readable($receiver);
+    $receiver->recv(my $buf, 4096);
+    return $buf;
+}
+
+# a limit on the whole logger, refilled as time passes
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    is_deeply($logger->get_rate_limit, { rate => 0, burst => 0, tokens => 0, sample => 1 },
+              "no limit by default");
+    is($logger->get_suppress_interval, 10, "suppressed lines are reported every 10 seconds by default");
+
+    $logger->set_rate_limit(undef, 20, 3);
+    is_deeply($logger->get_rate_limit, { rate => 20, burst => 3, tokens => 3, sample => 1 },
+              "->get_rate_limit reports the limit, starting with a full bucket");
+    $logger->set_suppress_interval(1);
+
+    my @ret = map { $logger->send("line $_", $time) } 1 .. 5;
+    is(scalar(grep { $_ } @ret), 3, "a burst of lines goes out");
+    is_deeply([ @ret[3, 4] ], [ 0, 0 ], "and those past it return 0");
+    my @got = map { recv_line($receiver) } 1 .. 3;
+    is($got[2], expected_payload(LOG_AUTH, LOG_INFO, 'localhost', 'test', $$, 'line 3', $time),
+       "the lines let through arrive");
+    is($logger->get_stats->{suppressed}, 2, "suppressed lines are counted");
+
+    sleep 0.12;
+    my $later = grep { $_ } map { $logger->send("later $_", $time) } 1 .. 10;
+    ok($later >= 2 && $later < 10, "the bucket refills at the rate, by fractions of a second")
+        or diag("$later of 10 sent");
+    recv_line($receiver) for 1 .. $later;
+
+    sleep 1;
+    ok($logger->send('after', $time), "a line goes out once the interval has passed");
+    is(recv_line($receiver),
+       expected_payload(LOG_AUTH, LOG_WARNING, 'localhost', 'test', $$,
+                        (12 - $later) . ' messages suppressed', $time),
+       "preceded by a report of the lines suppressed");
+    is(recv_line($receiver),
+       expected_payload(LOG_AUTH, LOG_INFO, 'localhost', 'test', $$, 'after', $time),
+       "and then the line itself");
+
+    is($logger->send_many([ map { "many $_" } 1 .. 5 ], $time), 2,
+       "->send_many sends the lines the bucket has tokens for");
+    recv_line($receiver) for 1 .. 2;
+    $logger->flush;
+    like(recv_line($receiver), qr/<36>.* 3 messages suppressed$/,
+         "->flush reports the tally without waiting for the interval");
+}
+
+# limits per severity
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+
+    $logger->set_rate_limit(LOG_INFO, 1);
+    is($logger->get_rate_limit(LOG_INFO)->{burst}, 1, "the burst defaults to a second's worth, at least 1");
+    is($logger->get_rate_limit->{rate}, 0, "a severity's limit leaves the logger's alone");
+
+    ok($logger->send_prio('info', LOG_INFO, undef, $time), "a line within its severity's limit goes out");
+    is($logger->send_prio('info', LOG_INFO, undef, $time), 0, "the next one doesn't");
+    ok($logger->send_prio('error', LOG_ERR, undef, $time)
+       && $logger->send_prio('error', LOG_ERR, undef, $time), "other severities aren't limited");
+}
+
+# sampling
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+
+    $logger->set_sample(undef, 0);
+    is($logger->send('never', $time), 0, "a sampling fraction of 0 drops every line");
+
+    $logger->set_sample(undef, 1);
+    $logger->set_sample(LOG_INFO, 0.5);
+    $logger->reset_stats;
+    $logger->send("sampled $_", $time) for 1 .. 2000;
+    my $suppressed = $logger->get_stats->{suppressed};
+    ok($suppressed > 800 && $suppressed < 1200, "about half the lines are kept")
+        or diag("$suppressed of 2000 suppressed");
+
+    my $sent = $logger->send_many([ map { "sampled $_" } 1 .. 2000 ], $time);
+    ok($sent > 800 && $sent < 1200, "->send_many samples each line on its own")
+        or diag("$sent of 2000 sent");
+}
+
+# the tally left when a logger goes away, and no reports at all
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    $logger->set_rate_limit(undef, 1, 1);
+    $logger->send("line $_", $time) for 1 .. 4;
+    recv_line($receiver);
+    undef $logger;
+    like(recv_line($receiver), qr/3 messages suppressed$/, "what's left is reported when the logger goes away");
+
+    $logger = $server->connect($CLASS => @params);
+    $logger->set_rate_limit(undef, 1, 1);
+    $logger->set_suppress_interval(0);
+    $logger->send("line $_", $time) for 1 .. 4;
+    recv_line($receiver);
+    undef $logger;
+    ok(!wait_for_readable($receiver), "an interval of 0 turns reports off");
+}
+
+eval { $CLASS->new(LOG_UDP, 'localhost', 514, @params)->set_rate_limit(8, 1) };
+like($@, qr/^Error in set_rate_limit: invalid severity/, "->set_rate_limit rejects a bad severity");
+eval { $CLASS->new(LOG_UDP, 'localhost', 514, @params)->set_rate_limit(undef, -1) };
+like($@, qr/^Error in set_rate_limit: invalid rate limit/, "and a negative rate");
+eval { $CLASS->new(LOG_UDP, 'localhost', 514, @params)->set_sample(undef, 1.5) };
+like($@, qr/^Error in set_sample: invalid sampling fraction/, "->set_sample rejects a fraction over 1");
+
+1;
@@ -0,0 +1,103 @@
+use Test::More tests => 23;
+
+use lib 't/lib';
+use LSF;
+use Test::LogSyslogFast;
+
+my @params = (LOG_AUTH, LOG_INFO, 'localhost', 'test');
+my $time = time;
+
+sub recv_line {
+    my $receiver = shift;
+    return undef unless wait_for_readable($receiver);
+    $receiver->recv(my $buf, 4096);
+    return $buf;
+}
+
+sub payload {
+    my ($msg, $t, $severity) = @_;
+    return expected_payload(LOG_AUTH, defined $severity ? $severity : LOG_INFO,
+                            'localhost', 'test', $$, $msg, $t);
+}
+
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    is($logger->get_dedup, 0, "duplicate suppression is off by default");
+    $logger->set_dedup(10);
+    is($logger->get_dedup, 10, "->get_dedup reports the window");
+
+    my @ret = map { $logger->send('same', $time) } 1 .. 5;
+    ok($ret[0], "the first occurrence of a line is sent");
+    is_deeply([ @ret[1 .. 4] ], [ 0, 0, 0, 0 ], "repeats within the window return 0");
+    is(recv_line($receiver), payload('same', $time), "and the first arrives at once");
+    is($logger->get_stats->{deduplicated}, 4, "repeats are counted");
+
+    ok($logger->send('other', $time + 1), "a different line is sent");
+    is_deeply([ map { recv_line($receiver) } 1 .. 2 ],
+              [ payload('message repeated 4 times: [same]', $time + 1), payload('other', $time + 1) ],
+              "after a summary of the repeats it ends");
+    ok($logger->send_prio('same', LOG_ERR, undef, $time + 1), "the same text at another severity is a different line");
+    recv_line($receiver);
+
+    is($logger->send_many([qw(new new other)], $time + 2), 1, "->send_many sends only the lines that aren't repeats");
+    is_deeply([ map { recv_line($receiver) } 1 .. 2 ],
+              [ payload('new', $time + 2), payload('message repeated 1 times: [new]', $time + 2) ],
+              "and summaries in order among them");
+    $logger->flush;
+    like(recv_line($receiver), qr/: message repeated 1 times: \[other\]$/, "->flush summarizes the repeats pending");
+
+    $logger->send('late', $time + 3) for 1 .. 3;
+    recv_line($receiver);
+    ok($logger->send('late', $time + 13), "once the window closes the line is sent again");
+    is(recv_line($receiver), payload('message repeated 2 times: [late]', $time + 13),
+       "after a summary of its repeats");
+    is(recv_line($receiver), payload('late', $time + 13), "and then the line itself");
+
+    $logger->send('late', $time + 13);
+    $logger->set_dedup(0);
+    is($logger->get_dedup, 0, "a window of 0 turns it off");
+    like(recv_line($receiver), qr/: message repeated 1 times: \[late\]$/, "summarizing the repeats still pending");
+}
+
+# a single slot summarizes as soon as a different line comes
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+    my $receiver = $server->accept;
+
+    $logger->set_dedup(60, 1);
+    $logger->send('a', $time) for 1 .. 3;
+    $logger->send('b', $time);
+    is_deeply([ map { recv_line($receiver) } 1 .. 3 ],
+              [ payload('a', $time), payload('message repeated 2 times: [a]', $time), payload('b', $time) ],
+              "the summary comes ahead of the different line");
+
+    my $long = 'x' x 200;
+    $logger->send($long, $time) for 1 .. 2;
+    recv_line($receiver);
+    undef $logger;
+    is(recv_line($receiver), payload('message repeated 1 times: [' . ('x' x 80) . '...]', time),
+       "a long line is quoted in part, and repeats are summarized when the logger goes away");
+}
+
+# repeats don't count against a rate limit
+{
+    my $server = make_server('udp');
+    my $logger = $server->connect($CLASS => @params);
+
+    $logger->set_dedup(10);
+    $logger->set_rate_limit(undef, 1, 1);
+    $logger->send('x', $time) for 1 .. 3;
+    is($logger->get_stats->{suppressed}, 0, "repeats are taken out before the rate limit");
+    is($logger->get_stats->{deduplicated}, 2, "and counted as such");
+}
+
+eval { $CLASS->new(LOG_UDP, 'localhost', 514, @params)->set_dedup(-1) };
+like($@, qr/^Error in set_dedup: invalid window/, "->set_dedup rejects a negative window");
+eval { $CLASS->new(LOG_UDP, 'localhost', 514, @params)->set_dedup(5, 0) };
+like($@, qr/^Error in set_dedup: invalid slot count/, "and a slot count of 0");
+
+1;